@@ -176,7 +176,7 @@ static void             cdc_outData     (USBD_CDC_IfHandleType *itf, USBD_EpHand
 static void             cdc_inData      (USBD_CDC_IfHandleType *itf, USBD_EpHandleType *ep);
 
 /* CDC interface class callbacks structure */
-static const USBD_ClassType cdc_cbks = {
+const USBD_ClassType USBD_CDC_Class = {
     .GetDescriptor  = (USBD_IfDescCbkType)  cdc_getDesc,
     .GetString      = (USBD_IfStrCbkType)   cdc_getString,
     .Deinit         = (USBD_IfCbkType)      cdc_deinit,
@@ -261,6 +261,341 @@ static const char* cdc_getString(USBD_CDC_IfHandleType *itf, uint8_t intNum)
     return itf->App->Name;
 }
 
+#if (USBD_CDC_STREAMING == 1)
+/* The ring indexes and endpoint ownership flags are shared between
+ * the application and the USB core. Sequential consistency is required,
+ * as each side rechecks the other's index after releasing the endpoint */
+#define CDC_LOAD(VAR)           __atomic_load_n(&(VAR), __ATOMIC_SEQ_CST)
+#define CDC_STORE(VAR, VALUE)   __atomic_store_n(&(VAR), (VALUE), __ATOMIC_SEQ_CST)
+#define CDC_CLAIM(FLAG)         (__atomic_exchange_n(&(FLAG), 1, __ATOMIC_SEQ_CST) == 0)
+
+#if (USBD_CDC_TX_HOLD_TIME > 0)
+#define CDC_TX_FLUSH(ITF)       CDC_LOAD((ITF)->Tx.Flush)
+#else
+#define CDC_TX_FLUSH(ITF)       0
+#endif
+
+/**
+ * @brief Determines the length of the next IN transfer from the transmit ring.
+ *        With a hold time, the partial packet at the end of the data is held back
+ *        until it's flushed, or until the hold time expires.
+ *        The caller must own the IN endpoint.
+ * @param itf: reference of the CDC interface
+ * @param head: the write index of the ring
+ * @param flush: the flush index of the ring (read before the write index)
+ * @return The length to send, 0 if there's nothing to send
+ */
+static uint16_t cdc_txLength(USBD_CDC_IfHandleType *itf, uint16_t head, uint16_t flush)
+{
+    uint16_t tail = itf->Tx.Tail;
+    uint16_t len = USBD_CDC_TX_BUFFER_SIZE - (tail & (USBD_CDC_TX_BUFFER_SIZE - 1));
+    uint16_t pending;
+
+    /* The end of the ring is skipped when a reserved region was wrapped */
+    if (CDC_LOAD(itf->Tx.Wraps) != itf->Tx.Wrapped)
+    {
+        if (tail != itf->Tx.Wrap)
+        {
+            len = itf->Tx.Wrap - tail;
+        }
+        else if (head != tail)
+        {
+            tail += len;
+            len = USBD_CDC_TX_BUFFER_SIZE;
+            itf->Tx.Wrapped++;
+            CDC_STORE(itf->Tx.Tail, tail);
+        }
+    }
+
+    /* The wrapped part is sent by the next transfer */
+    pending = head - tail;
+    if (len > pending)
+    {
+        len = pending;
+    }
+
+#if (USBD_CDC_TX_HOLD_TIME > 0)
+    /* Unless the tail is behind the flush index */
+    if ((pending > 0) && ((uint16_t)(flush - tail - 1) >= pending))
+    {
+        uint16_t mps = USBD_EpAddr2Ref(itf->Base.Device, itf->Config.InEpNum)->MaxPacketSize;
+        uint32_t now = USBD_CDC_TX_TIMESTAMP();
+
+        if (itf->Tx.Holding == 0)
+        {
+            itf->Tx.Holding = 1;
+            itf->Tx.HoldStart = now;
+        }
+        if (((now - itf->Tx.HoldStart) < USBD_CDC_TX_HOLD_TIME) && (len == pending))
+        {
+            /* Only the full packets are sent */
+            len -= len & (mps - 1);
+        }
+    }
+    if (len > 0)
+    {
+        itf->Tx.Holding = 0;
+    }
+#else
+    (void)flush;
+#endif
+    return len;
+}
+
+/**
+ * @brief Starts the next IN transfer from the transmit ring,
+ *        the caller must own the IN endpoint.
+ * @param itf: reference of the CDC interface
+ * @param len: length of the transfer
+ * @return BUSY if the endpoint can't be used, OK if successful
+ */
+static USBD_ReturnType cdc_txSend(USBD_CDC_IfHandleType *itf, uint16_t len)
+{
+    itf->Tx.Length = len;
+
+    return USBD_EpSend(itf->Base.Device, itf->Config.InEpNum,
+            &itf->Tx.Buffer[itf->Tx.Tail & (USBD_CDC_TX_BUFFER_SIZE - 1)], len);
+}
+
+/**
+ * @brief Transmits the pending data of the ring, unless a transfer is already ongoing.
+ * @param itf: reference of the CDC interface
+ */
+static void cdc_txKick(USBD_CDC_IfHandleType *itf)
+{
+    while (CDC_CLAIM(itf->Tx.Busy))
+    {
+        uint16_t flush = CDC_TX_FLUSH(itf);
+        uint16_t head = CDC_LOAD(itf->Tx.Head);
+        uint16_t len = cdc_txLength(itf, head, flush);
+
+        if (len > 0)
+        {
+            /* If the endpoint is closed, the data waits for the port to open */
+            if (cdc_txSend(itf, len) != USBD_E_OK)
+            {
+                CDC_STORE(itf->Tx.Busy, 0);
+            }
+            break;
+        }
+
+        /* The data written (or flushed) after the check is sent by this context */
+        CDC_STORE(itf->Tx.Busy, 0);
+        if ((CDC_TX_FLUSH(itf) == flush) && (CDC_LOAD(itf->Tx.Head) == head))
+        {
+            break;
+        }
+    }
+}
+
+#if (USBD_CDC_NOTEP_USED == 1)
+/**
+ * @brief Sends the SerialState notification with the OverRun bit set,
+ *        if the application reported an overrun since the last notification,
+ *        unless the notification is already in progress.
+ * @param itf: reference of the CDC interface
+ */
+static void cdc_notifyOverrun(USBD_CDC_IfHandleType *itf)
+{
+    while (CDC_CLAIM(itf->Tx.Notifying))
+    {
+        uint8_t dropped = CDC_LOAD(itf->Tx.Dropped);
+
+        if ((dropped != itf->Tx.Reported) &&
+            ((itf->Config.NotEpNum & 0xF) < USBD_MAX_EP_COUNT))
+        {
+            USBD_CDC_NotifyMessageType *notice = &itf->SerialState;
+
+            notice->Header.RequestType      = 0xA1;
+            notice->Header.NotificationType = CDC_NOT_SERIAL_STATE;
+            notice->Header.Value            = 0;
+            notice->Header.Index            =
+                    USBD_EpAddr2Ref(itf->Base.Device, itf->Config.NotEpNum)->IfNum;
+            notice->Header.Length           = sizeof(notice->SerialState);
+            notice->SerialState.w           = 0;
+            notice->SerialState.OverRun     = 1;
+
+            /* The flag is released by the completion,
+             * if the endpoint is busy, the completion retries it */
+            if (USBD_CDC_Notify(itf, notice) == USBD_E_OK)
+            {
+                itf->Tx.Reported = dropped;
+                break;
+            }
+        }
+
+        /* The overrun counted after the check is reported by this context */
+        CDC_STORE(itf->Tx.Notifying, 0);
+        if (CDC_LOAD(itf->Tx.Dropped) == dropped)
+        {
+            break;
+        }
+    }
+}
+
+/**
+ * @brief Completes a notification, and reports the pending overrun.
+ * @param itf: reference of the CDC interface
+ * @param ep: reference to the endpoint structure
+ */
+static void cdc_notifyComplete(USBD_CDC_IfHandleType *itf, USBD_EpHandleType *ep)
+{
+    if ((ep->Transfer.Data - ep->Transfer.Length) == (uint8_t*)&itf->SerialState)
+    {
+        CDC_STORE(itf->Tx.Notifying, 0);
+    }
+    cdc_notifyOverrun(itf);
+}
+#endif /* (USBD_CDC_NOTEP_USED == 1) */
+
+/**
+ * @brief Frees the transmitted data from the ring, and continues the transmission.
+ *        The transfer is terminated with a ZLP if the ring is empty
+ *        and the last packet was full.
+ * @param itf: reference of the CDC interface
+ * @param ep: reference to the endpoint structure
+ */
+static void cdc_txComplete(USBD_CDC_IfHandleType *itf, USBD_EpHandleType *ep)
+{
+    uint16_t len = itf->Tx.Length;
+    uint16_t tail = itf->Tx.Tail + len;
+    uint8_t *data = &itf->Tx.Buffer[itf->Tx.Tail & (USBD_CDC_TX_BUFFER_SIZE - 1)];
+
+    CDC_STORE(itf->Tx.Tail, tail);
+
+    if ((len == 0) || ((len & (ep->MaxPacketSize - 1)) != 0) ||
+        (CDC_LOAD(itf->Tx.Head) != tail) ||
+        (cdc_txSend(itf, 0) != USBD_E_OK))
+    {
+        CDC_STORE(itf->Tx.Busy, 0);
+        cdc_txKick(itf);
+    }
+
+    if (len > 0)
+    {
+        USBD_SAFE_CALLBACK(CDC_APP(itf)->Transmitted, itf, data, len);
+    }
+}
+
+/**
+ * @brief Arms the OUT endpoint on the free space of the receive ring,
+ *        unless it's already receiving, or the reception is paused.
+ *        The reception is paused when the unread data reaches the high watermark,
+ *        and it's resumed when the application reads it down to the low watermark.
+ * @param itf: reference of the CDC interface
+ */
+static void cdc_rxKick(USBD_CDC_IfHandleType *itf)
+{
+    while (CDC_CLAIM(itf->Rx.Armed))
+    {
+        uint16_t tail = CDC_LOAD(itf->Rx.Tail);
+        uint16_t head = itf->Rx.Head;
+        uint16_t level = head - tail;
+        uint16_t mps = USBD_EpAddr2Ref(itf->Base.Device, itf->Config.OutEpNum)->MaxPacketSize;
+        uint16_t len = 0;
+
+        if (level >= USBD_CDC_RX_HIGH_WATERMARK)
+        {
+            itf->Rx.Paused = 1;
+        }
+        else if (level <= USBD_CDC_RX_LOW_WATERMARK)
+        {
+            itf->Rx.Paused = 0;
+        }
+
+        if (itf->Rx.Paused == 0)
+        {
+            /* Full packets are received up to the high watermark,
+             * within the free space, and until the end of the ring */
+            uint16_t space = (USBD_CDC_RX_BUFFER_SIZE - level) & ~(mps - 1);
+            uint16_t end = (USBD_CDC_RX_BUFFER_SIZE - (head & (USBD_CDC_RX_BUFFER_SIZE - 1))
+                    + mps - 1) & ~(mps - 1);
+
+            len = (USBD_CDC_RX_HIGH_WATERMARK - level + mps - 1) & ~(mps - 1);
+            if (len > space)
+            {
+                len = space;
+            }
+            if (len > end)
+            {
+                len = end;
+            }
+        }
+
+        if (len > 0)
+        {
+            if (USBD_EpReceive(itf->Base.Device, itf->Config.OutEpNum,
+                    &itf->Rx.Buffer[head & (USBD_CDC_RX_BUFFER_SIZE - 1)], len) != USBD_E_OK)
+            {
+                CDC_STORE(itf->Rx.Armed, 0);
+            }
+            break;
+        }
+
+        /* The data read after the check is handled by this context */
+        CDC_STORE(itf->Rx.Armed, 0);
+        if (CDC_LOAD(itf->Rx.Tail) == tail)
+        {
+            break;
+        }
+    }
+}
+
+/**
+ * @brief Adds the received data to the ring, and continues the reception.
+ * @param itf: reference of the CDC interface
+ * @param ep: reference to the endpoint structure
+ */
+static void cdc_rxComplete(USBD_CDC_IfHandleType *itf, USBD_EpHandleType *ep)
+{
+    uint16_t head = itf->Rx.Head;
+    uint16_t pos = head & (USBD_CDC_RX_BUFFER_SIZE - 1);
+    uint16_t len = ep->Transfer.Length;
+
+    /* The ring's start is free, as the transfer only used free space */
+    if ((pos + len) > USBD_CDC_RX_BUFFER_SIZE)
+    {
+        memcpy(&itf->Rx.Buffer[0], &itf->Rx.Buffer[USBD_CDC_RX_BUFFER_SIZE],
+                pos + len - USBD_CDC_RX_BUFFER_SIZE);
+    }
+    CDC_STORE(itf->Rx.Head, head + len);
+    CDC_STORE(itf->Rx.Armed, 0);
+    cdc_rxKick(itf);
+
+    if (len > 0)
+    {
+        USBD_SAFE_CALLBACK(CDC_APP(itf)->Received, itf, &itf->Rx.Buffer[pos], len);
+    }
+}
+
+/**
+ * @brief Empties the buffers when the port is opened, and starts receiving.
+ * @param itf: reference of the CDC interface
+ */
+static void cdc_streamInit(USBD_CDC_IfHandleType *itf)
+{
+    /* The data written before the port was opened is discarded */
+    CDC_STORE(itf->Tx.Tail, CDC_LOAD(itf->Tx.Head));
+    itf->Tx.Wrapped = CDC_LOAD(itf->Tx.Wraps);
+#if (USBD_CDC_TX_HOLD_TIME > 0)
+    CDC_STORE(itf->Tx.Flush, itf->Tx.Tail);
+    itf->Tx.Holding = 0;
+#endif
+    itf->Tx.Busy = 0;
+
+#if (USBD_CDC_NOTEP_USED == 1)
+    itf->Tx.Reported = CDC_LOAD(itf->Tx.Dropped);
+    CDC_STORE(itf->Tx.Notifying, 0);
+#endif
+
+    /* The data received before the port was opened is discarded */
+    CDC_STORE(itf->Rx.Head, CDC_LOAD(itf->Rx.Tail));
+    itf->Rx.Paused = 0;
+    CDC_STORE(itf->Rx.Armed, 0);
+    cdc_rxKick(itf);
+}
+#endif /* (USBD_CDC_STREAMING == 1) */
+
 /**
  * @brief Initializes the interface by opening its endpoints
  *        and initializing the attached application.
@@ -292,6 +627,10 @@ static void cdc_init(USBD_CDC_IfHandleType *itf)
     }
 #endif
 
+#if (USBD_CDC_STREAMING == 1)
+    cdc_streamInit(itf);
+#endif
+
     /* Initialize application */
     USBD_SAFE_CALLBACK(CDC_APP(itf)->Open, itf, &itf->LineCoding);
 }
@@ -317,6 +656,12 @@ static void cdc_deinit(USBD_CDC_IfHandleType *itf)
         }
 #endif
 
+#if (USBD_CDC_STREAMING == 1)
+        /* The buffers can't use the closed endpoints until the port is reopened */
+        CDC_STORE(itf->Tx.Busy, 1);
+        CDC_STORE(itf->Rx.Armed, 1);
+#endif
+
         /* Deinitialize application */
         USBD_SAFE_CALLBACK(CDC_APP(itf)->Close, itf);
 
@@ -425,8 +770,12 @@ static void cdc_dataStage(USBD_CDC_IfHandleType *itf)
  */
 static void cdc_outData(USBD_CDC_IfHandleType *itf, USBD_EpHandleType *ep)
 {
+#if (USBD_CDC_STREAMING == 1)
+    cdc_rxComplete(itf, ep);
+#else
     USBD_SAFE_CALLBACK(CDC_APP(itf)->Received, itf,
             ep->Transfer.Data - ep->Transfer.Length, ep->Transfer.Length);
+#endif
 }
 
 /**
@@ -439,7 +788,21 @@ static void cdc_inData(USBD_CDC_IfHandleType *itf, USBD_EpHandleType *ep)
 #if (USBD_CDC_NOTEP_USED == 1)
     if (ep == USBD_EpAddr2Ref(itf->Base.Device, itf->Config.InEpNum))
 #endif
+#if (USBD_CDC_STREAMING == 1)
+    {
+        cdc_txComplete(itf, ep);
+    }
+#if (USBD_CDC_NOTEP_USED == 1)
+    else
     {
+        cdc_notifyComplete(itf, ep);
+    }
+#endif
+#else
+    {
+        /* the endpoint is already released, so the transfer context
+         * can be overwritten by a concurrently submitted transfer */
+        uint8_t *data = ep->Transfer.Data;
         uint16_t len = ep->Transfer.Length;
 
         if (len == 0)
@@ -450,17 +813,22 @@ static void cdc_inData(USBD_CDC_IfHandleType *itf, USBD_EpHandleType *ep)
         }
         else if ((len & (ep->MaxPacketSize - 1)) == 0)
         {
-            /* if length mod MPS == 0, split the transfer by sending ZLP */
+            /* if length mod MPS == 0, split the transfer by sending ZLP,
+             * unless a new transfer is already started, which ends it instead */
             itf->TransmitLength = len;
-            USBD_CDC_Transmit(itf, ep->Transfer.Data, 0);
+            if (USBD_CDC_Transmit(itf, data, 0) != USBD_E_OK)
+            {
+                itf->TransmitLength = 0;
+            }
         }
 
         /* callback when the endpoint isn't busy sending ZLP */
-        if (ep->State != USB_EP_STATE_DATA)
+        if (itf->TransmitLength == 0)
         {
-            USBD_SAFE_CALLBACK(CDC_APP(itf)->Transmitted, itf, ep->Transfer.Data - len, len);
+            USBD_SAFE_CALLBACK(CDC_APP(itf)->Transmitted, itf, data - len, len);
         }
     }
+#endif /* (USBD_CDC_STREAMING == 1) */
 }
 
 /** @} */
@@ -477,17 +845,20 @@ static void cdc_inData(USBD_CDC_IfHandleType *itf, USBD_EpHandleType *ep)
  * @param dev: reference of the USB Device
  * @return OK if the mounting was successful,
  *         ERROR if it failed due to insufficient device interface slots
+ *         (or descriptor buffer with USBD_CTRL_STREAMING),
+ *         INVALID if it isn't listed at the next position of USBD_STATIC_IF_LIST
  */
 USBD_ReturnType USBD_CDC_MountInterface(USBD_CDC_IfHandleType *itf, USBD_HandleType *dev)
 {
-    USBD_ReturnType retval = USBD_E_ERROR;
-
     /* Note: CDC uses 2 interfaces */
-    if (dev->IfCount < (USBD_MAX_IF_COUNT - 1))
+    USBD_ReturnType retval = USBD_IfMountCheck(dev, (USBD_IfHandleType*)itf, 2,
+            sizeof(cdc_desc) + 2 * sizeof(USB_EndpointDescType));
+
+    if (retval == USBD_E_OK)
     {
         /* Binding interfaces */
         itf->Base.Device = dev;
-        itf->Base.Class  = &cdc_cbks;
+        itf->Base.Class  = &USBD_CDC_Class;
         itf->Base.AltCount = 1;
         itf->Base.AltSelector = 0;
         itf->TransmitLength = 0;
@@ -516,13 +887,10 @@ USBD_ReturnType USBD_CDC_MountInterface(USBD_CDC_IfHandleType *itf, USBD_HandleT
             ep->IfNum           = dev->IfCount;
         }
 
-        dev->IF[dev->IfCount] = (USBD_IfHandleType*)itf;
-        dev->IfCount++;
-
-        dev->IF[dev->IfCount] = (USBD_IfHandleType*)itf;
-        dev->IfCount++;
+        USBD_IfAttach(dev, (USBD_IfHandleType*)itf);
 
-        retval = USBD_E_OK;
+        USBD_IfAttach(dev, (USBD_IfHandleType*)itf);
+        USBD_DescInvalidate(dev);
     }
 
     return retval;
@@ -534,6 +902,7 @@ USBD_ReturnType USBD_CDC_MountInterface(USBD_CDC_IfHandleType *itf, USBD_HandleT
  * @param data: pointer to the data to send
  * @param length: length of the data
  * @return BUSY if the previous transfer is still ongoing, OK if successful
+ * @note  The data belongs to the USB core until @ref USBD_CDC_AppType::Transmitted is called.
  */
 USBD_ReturnType USBD_CDC_Transmit(USBD_CDC_IfHandleType *itf, uint8_t *data, uint16_t length)
 {
@@ -546,12 +915,217 @@ USBD_ReturnType USBD_CDC_Transmit(USBD_CDC_IfHandleType *itf, uint8_t *data, uin
  * @param data: pointer to the data to receive
  * @param length: length of the data
  * @return BUSY if the previous transfer is still ongoing, OK if successful
+ * @note  The buffer belongs to the USB core until @ref USBD_CDC_AppType::Received is called.
  */
 USBD_ReturnType USBD_CDC_Receive(USBD_CDC_IfHandleType *itf, uint8_t *data, uint16_t length)
 {
     return USBD_EpReceive(itf->Base.Device, itf->Config.OutEpNum, data, length);
 }
 
+#if (USBD_CDC_STREAMING == 1)
+/**
+ * @brief Writes data to the transmit ring of a streaming CDC interface,
+ *        which is sent as soon as the IN endpoint is available.
+ *        The function can be called from a single application context
+ *        concurrently to the USB core's event handling.
+ * @param itf: reference of the CDC interface
+ * @param data: pointer to the data to send
+ * @param length: length of the data
+ * @return The number of bytes written, which is less than the length
+ *         if the ring is full, or 0 if the port isn't open
+ * @note  If the application discards the data that doesn't fit,
+ *        it can report it to the host with @ref USBD_CDC_ReportOverrun.
+ */
+uint16_t USBD_CDC_Write(USBD_CDC_IfHandleType *itf, const uint8_t *data, uint16_t length)
+{
+    uint16_t head = itf->Tx.Head;
+    uint16_t pos = head & (USBD_CDC_TX_BUFFER_SIZE - 1);
+    uint16_t space = USBD_CDC_TX_BUFFER_SIZE - (uint16_t)(head - CDC_LOAD(itf->Tx.Tail));
+    uint16_t len1;
+
+    if (itf->LineCoding.DataBits == 0)
+    {
+        length = 0;
+    }
+    else if (length > space)
+    {
+        length = space;
+    }
+
+    /* The data is copied in two chunks when it wraps around */
+    len1 = USBD_CDC_TX_BUFFER_SIZE - pos;
+    if (len1 > length)
+    {
+        len1 = length;
+    }
+    memcpy(&itf->Tx.Buffer[pos], data, len1);
+    memcpy(&itf->Tx.Buffer[0], data + len1, length - len1);
+
+    if (length > 0)
+    {
+        CDC_STORE(itf->Tx.Head, head + length);
+        cdc_txKick(itf);
+    }
+    return length;
+}
+
+#if (USBD_CDC_NOTEP_USED == 1)
+/**
+ * @brief Reports to the host that the application discarded data
+ *        of a streaming CDC interface (e.g. its UART receiver overflowed),
+ *        with the OverRun bit of a SerialState notification.
+ *        The reports made while a notification is in progress are combined.
+ *        The function shall be called from the same context as @ref USBD_CDC_Write.
+ * @param itf: reference of the CDC interface
+ */
+void USBD_CDC_ReportOverrun(USBD_CDC_IfHandleType *itf)
+{
+    CDC_STORE(itf->Tx.Dropped, itf->Tx.Dropped + 1);
+    cdc_notifyOverrun(itf);
+}
+#endif /* (USBD_CDC_NOTEP_USED == 1) */
+
+/**
+ * @brief Reserves a contiguous region in the transmit ring of a streaming CDC interface,
+ *        so the data can be placed directly into it. When the region is filled,
+ *        the @ref USBD_CDC_TxCommit function must be called to send the data.
+ *        The function can be called from the same context as @ref USBD_CDC_Write,
+ *        which mustn't be used until the reservation is committed.
+ * @param itf: reference of the CDC interface
+ * @param length: size of the region
+ * @return pointer to the region if available, NULL if the ring doesn't have
+ *         enough contiguous space, or if the port isn't open
+ */
+uint8_t* USBD_CDC_TxReserve(USBD_CDC_IfHandleType *itf, uint16_t length)
+{
+    uint8_t *data = NULL;
+    uint16_t head = itf->Tx.Head;
+    uint16_t pos = head & (USBD_CDC_TX_BUFFER_SIZE - 1);
+    uint16_t used = head - CDC_LOAD(itf->Tx.Tail);
+
+    if ((itf->LineCoding.DataBits != 0) && (length > 0))
+    {
+        if ((pos + length) <= USBD_CDC_TX_BUFFER_SIZE)
+        {
+            if ((used + length) <= USBD_CDC_TX_BUFFER_SIZE)
+            {
+                data = &itf->Tx.Buffer[pos];
+            }
+        }
+        /* The region is placed at the start of the ring,
+         * the end of the ring is skipped */
+        else if ((used + (USBD_CDC_TX_BUFFER_SIZE - pos) + length) <= USBD_CDC_TX_BUFFER_SIZE)
+        {
+            data = &itf->Tx.Buffer[0];
+        }
+    }
+
+    itf->Tx.Reserved = (data != NULL) ? length : 0;
+    return data;
+}
+
+/**
+ * @brief Called after @ref USBD_CDC_TxReserve and after the data is placed
+ *        in the reserved region. Completes the write and attempts an IN transfer.
+ * @param itf: reference of the CDC interface
+ * @param length: length of the placed data, at most the reserved size
+ * @return OK if called in the right sequence, INVALID otherwise
+ */
+USBD_ReturnType USBD_CDC_TxCommit(USBD_CDC_IfHandleType *itf, uint16_t length)
+{
+    USBD_ReturnType retval = USBD_E_INVALID;
+    uint16_t reserved = itf->Tx.Reserved;
+
+    if ((reserved > 0) && (length <= reserved))
+    {
+        uint16_t head = itf->Tx.Head;
+        uint16_t pos = head & (USBD_CDC_TX_BUFFER_SIZE - 1);
+
+        itf->Tx.Reserved = 0;
+
+        if (length > 0)
+        {
+            /* The skip is published before the data */
+            if ((pos + reserved) > USBD_CDC_TX_BUFFER_SIZE)
+            {
+                itf->Tx.Wrap = head;
+                CDC_STORE(itf->Tx.Wraps, itf->Tx.Wraps + 1);
+                head += USBD_CDC_TX_BUFFER_SIZE - pos;
+            }
+
+            CDC_STORE(itf->Tx.Head, head + length);
+            cdc_txKick(itf);
+        }
+        retval = USBD_E_OK;
+    }
+    return retval;
+}
+
+#if (USBD_CDC_TX_HOLD_TIME > 0)
+/**
+ * @brief Sends the data held back in the transmit ring of a streaming CDC interface
+ *        without waiting for the hold time. It shall be called from the same context
+ *        as @ref USBD_CDC_Write.
+ * @param itf: reference of the CDC interface
+ */
+void USBD_CDC_Flush(USBD_CDC_IfHandleType *itf)
+{
+    CDC_STORE(itf->Tx.Flush, itf->Tx.Head);
+    cdc_txKick(itf);
+}
+
+/**
+ * @brief Sends the data held back in the transmit ring of a streaming CDC interface
+ *        if its hold time has expired. It should be called periodically,
+ *        e.g. from the SOF interrupt or a timer.
+ * @param itf: reference of the CDC interface
+ */
+void USBD_CDC_Poll(USBD_CDC_IfHandleType *itf)
+{
+    cdc_txKick(itf);
+}
+#endif /* (USBD_CDC_TX_HOLD_TIME > 0) */
+
+/**
+ * @brief Reads the received data of a streaming CDC interface.
+ *        The reception is continued as the receive ring is emptied.
+ *        The function can be called from a single application context
+ *        concurrently to the USB core's event handling.
+ * @param itf: reference of the CDC interface
+ * @param data: the destination buffer
+ * @param length: maximum length to read
+ * @return The number of bytes read
+ */
+uint16_t USBD_CDC_Read(USBD_CDC_IfHandleType *itf, uint8_t *data, uint16_t length)
+{
+    uint16_t tail = itf->Rx.Tail;
+    uint16_t pos = tail & (USBD_CDC_RX_BUFFER_SIZE - 1);
+    uint16_t avail = CDC_LOAD(itf->Rx.Head) - tail;
+    uint16_t len1;
+
+    if (length > avail)
+    {
+        length = avail;
+    }
+
+    /* The data is copied in two chunks when it wraps around */
+    len1 = USBD_CDC_RX_BUFFER_SIZE - pos;
+    if (len1 > length)
+    {
+        len1 = length;
+    }
+    memcpy(data, &itf->Rx.Buffer[pos], len1);
+    memcpy(data + len1, &itf->Rx.Buffer[0], length - len1);
+
+    if (length > 0)
+    {
+        CDC_STORE(itf->Rx.Tail, tail + length);
+        cdc_rxKick(itf);
+    }
+    return length;
+}
+#endif /* (USBD_CDC_STREAMING == 1) */
+
 #if (USBD_CDC_NOTEP_USED == 1)
 /**
  * @brief Sends a device notification to the host.
@@ -563,7 +1137,7 @@ USBD_ReturnType USBD_CDC_Notify(USBD_CDC_IfHandleType *itf, USBD_CDC_NotifyMessa
 {
     USBD_ReturnType retval = USBD_E_ERROR;
 
-    if (itf->Config.NotEpNum < USBD_MAX_EP_COUNT)
+    if ((itf->Config.NotEpNum & 0xF) < USBD_MAX_EP_COUNT)
     {
         uint16_t length = sizeof(notice->Header) + notice->Header.Length;
         retval = USBD_EpSend(itf->Base.Device, itf->Config.NotEpNum, notice, length);
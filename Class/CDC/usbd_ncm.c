@@ -22,7 +22,6 @@
   */
 #include <private/usbd_internal.h>
 #include <usbd_ncm.h>
-#include <usbd_utils.h>
 
 #if (USBD_MAX_IF_COUNT < 2)
 #error "A single NCM interface takes up 2 device interface slots!"
@@ -284,7 +283,7 @@ static void             ncm_inData      (USBD_NCM_IfHandleType *itf, USBD_EpHand
 static void             ncm_sendNTB     (USBD_NCM_IfHandleType *itf, uint8_t page);
 
 /* NCM interface class callbacks structure */
-static const USBD_ClassType ncm_cbks = {
+const USBD_ClassType USBD_NCM_Class = {
     .GetDescriptor  = (USBD_IfDescCbkType)  ncm_getDesc,
     .GetString      = (USBD_IfStrCbkType)   ncm_getString,
     .Init           = (USBD_IfCbkType)      ncm_init,
@@ -368,10 +367,18 @@ static const char* ncm_getString(USBD_NCM_IfHandleType *itf, uint8_t intNum)
     else
     {
         /* Allocate string after the end of the string descriptor */
-        str = (void*)itf->Base.Device->CtrlData + 2 +
+        const uint8_t *addr = *NCM_APP(itf)->NetAddress;
+        char *hex = (void*)itf->Base.Device->CtrlData + 2 +
                 sizeof(*NCM_APP(itf)->NetAddress) * 4;
-        Uint2Unicode((void*)NCM_APP(itf)->NetAddress, (void*)str,
-                2 * sizeof(*NCM_APP(itf)->NetAddress));
+        uint8_t i;
+
+        for (i = 0; i < sizeof(*NCM_APP(itf)->NetAddress); i++)
+        {
+            hex[2 * i]     = "0123456789ABCDEF"[addr[i] >> 4];
+            hex[2 * i + 1] = "0123456789ABCDEF"[addr[i] & 0xF];
+        }
+        hex[2 * i] = 0;
+        str = hex;
     }
     return str;
 }
@@ -718,17 +725,20 @@ static void ncm_inData(USBD_NCM_IfHandleType *itf, USBD_EpHandleType *ep)
  * @param dev: reference of the USB Device
  * @return OK if the mounting was successful,
  *         ERROR if it failed due to insufficient device interface slots
+ *         (or descriptor buffer with USBD_CTRL_STREAMING),
+ *         INVALID if it isn't listed at the next position of USBD_STATIC_IF_LIST
  */
 USBD_ReturnType USBD_NCM_MountInterface(USBD_NCM_IfHandleType *itf, USBD_HandleType *dev)
 {
-    USBD_ReturnType retval = USBD_E_ERROR;
-
     /* Note: NCM uses 2 interfaces */
-    if (dev->IfCount < (USBD_MAX_IF_COUNT - 1))
+    USBD_ReturnType retval = USBD_IfMountCheck(dev, (USBD_IfHandleType*)itf, 2,
+            sizeof(ncm_desc) + 2 * sizeof(USB_EndpointDescType));
+
+    if (retval == USBD_E_OK)
     {
         /* Binding interfaces */
         itf->Base.Device = dev;
-        itf->Base.Class  = &ncm_cbks;
+        itf->Base.Class  = &USBD_NCM_Class;
         itf->Base.AltCount = 2;
         itf->Base.AltSelector = 0;
 
@@ -763,13 +773,10 @@ USBD_ReturnType USBD_NCM_MountInterface(USBD_NCM_IfHandleType *itf, USBD_HandleT
             ep->IfNum           = dev->IfCount;
         }
 
-        dev->IF[dev->IfCount] = (USBD_IfHandleType*)itf;
-        dev->IfCount++;
-
-        dev->IF[dev->IfCount] = (USBD_IfHandleType*)itf;
-        dev->IfCount++;
+        USBD_IfAttach(dev, (USBD_IfHandleType*)itf);
 
-        retval = USBD_E_OK;
+        USBD_IfAttach(dev, (USBD_IfHandleType*)itf);
+        USBD_DescInvalidate(dev);
     }
 
     return retval;
@@ -228,6 +228,21 @@ static uint16_t rodfu_getDesc(USBD_DFU_IfHandleType *itf, uint8_t ifNum, uint8_t
     return len;
 }
 
+/**
+ * @brief Calculates the length of the interface descriptor.
+ * @param itf: reference of the DFU interface
+ * @return Length of the interface descriptor
+ */
+static uint16_t dfu_descLength(USBD_DFU_IfHandleType *itf)
+{
+#if (USBD_DFU_ALTSETTINGS != 0)
+    return (itf->Base.AltCount * sizeof(dfu_desc.DFU)) + sizeof(dfu_desc.DFUFD);
+#else
+    (void)itf;
+    return sizeof(dfu_desc);
+#endif
+}
+
 #if (USBD_DFU_ALTSETTINGS != 0)
 /**
  * @brief Copies the interface descriptor to the destination buffer.
@@ -973,12 +988,15 @@ void USBD_DFU_AppInit(USBD_DFU_IfHandleType *itf, uint16_t detachTimeout_ms)
  * @param dev: reference of the USB Device
  * @return OK if the mounting was successful,
  *         ERROR if it failed due to insufficient device interface slots
+ *         (or descriptor buffer with USBD_CTRL_STREAMING),
+ *         INVALID if it isn't listed at the next position of USBD_STATIC_IF_LIST
  */
 USBD_ReturnType USBD_DFU_MountRebootOnly(USBD_DFU_IfHandleType *itf, USBD_HandleType *dev)
 {
-    USBD_ReturnType retval = USBD_E_ERROR;
+    USBD_ReturnType retval = USBD_IfMountCheck(dev, (USBD_IfHandleType*)itf, 1,
+            sizeof(dfu_desc));
 
-    if (dev->IfCount < USBD_MAX_IF_COUNT)
+    if (retval == USBD_E_OK)
     {
         /* Binding interfaces */
         itf->Base.Device = dev;
@@ -993,10 +1011,8 @@ USBD_ReturnType USBD_DFU_MountRebootOnly(USBD_DFU_IfHandleType *itf, USBD_Handle
         itf->DevStatus.iString     = 0;
         itf->DevStatus.PollTimeout = 0;
 
-        dev->IF[dev->IfCount] = (USBD_IfHandleType*)itf;
-        dev->IfCount++;
-
-        retval = USBD_E_OK;
+        USBD_IfAttach(dev, (USBD_IfHandleType*)itf);
+        USBD_DescInvalidate(dev);
     }
 
     return retval;
@@ -1015,20 +1031,20 @@ USBD_ReturnType USBD_DFU_MountRebootOnly(USBD_DFU_IfHandleType *itf, USBD_Handle
  * @param dev: reference of the USB Device
  * @return OK if the mounting was successful,
  *         ERROR if it failed due to insufficient device interface slots
+ *         (or descriptor buffer with USBD_CTRL_STREAMING),
+ *         INVALID if it isn't listed at the next position of USBD_STATIC_IF_LIST
  */
 USBD_ReturnType USBD_DFU_MountInterface(USBD_DFU_IfHandleType *itf, USBD_HandleType *dev)
 {
-    USBD_ReturnType retval = USBD_E_ERROR;
+    USBD_ReturnType retval = USBD_IfMountCheck(dev, (USBD_IfHandleType*)itf, 1, dfu_descLength(itf));
 
-    if (dev->IfCount < USBD_MAX_IF_COUNT)
+    if (retval == USBD_E_OK)
     {
         /* Binding interfaces */
         itf->Base.Device = dev;
 
-        dev->IF[dev->IfCount] = (USBD_IfHandleType*)itf;
-        dev->IfCount++;
-
-        retval = USBD_E_OK;
+        USBD_IfAttach(dev, (USBD_IfHandleType*)itf);
+        USBD_DescInvalidate(dev);
     }
 
     return retval;
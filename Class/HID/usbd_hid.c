@@ -106,7 +106,7 @@ static void             hid_outData     (USBD_HID_IfHandleType *itf, USBD_EpHand
 
 
 /* HID interface class callbacks structure */
-static const USBD_ClassType hid_cbks = {
+const USBD_ClassType USBD_HID_Class = {
 #if (USBD_HID_ALTSETTINGS != 0)
     .GetDescriptor  = (USBD_IfDescCbkType)  hid_getAltsDesc,
 #else
@@ -520,16 +520,19 @@ static void hid_outData(USBD_HID_IfHandleType *itf, USBD_EpHandleType *ep)
  * @param dev: reference of the USB Device
  * @return OK if the mounting was successful,
  *         ERROR if it failed due to insufficient device interface slots
+ *         (or descriptor buffer with USBD_CTRL_STREAMING),
+ *         INVALID if it isn't listed at the next position of USBD_STATIC_IF_LIST
  */
 USBD_ReturnType USBD_HID_MountInterface(USBD_HID_IfHandleType *itf, USBD_HandleType *dev)
 {
-    USBD_ReturnType retval = USBD_E_ERROR;
+    USBD_ReturnType retval = USBD_IfMountCheck(dev, (USBD_IfHandleType*)itf, 1,
+            sizeof(hid_desc) + 2 * sizeof(USB_EndpointDescType));
 
-    if (dev->IfCount < USBD_MAX_IF_COUNT)
+    if (retval == USBD_E_OK)
     {
         /* Binding interfaces */
         itf->Base.Device = dev;
-        itf->Base.Class  = &hid_cbks;
+        itf->Base.Class  = &USBD_HID_Class;
         itf->Base.AltCount = 1;
         itf->Base.AltSelector = 0;
 
@@ -561,10 +564,8 @@ USBD_ReturnType USBD_HID_MountInterface(USBD_HID_IfHandleType *itf, USBD_HandleT
 #endif /* (USBD_HID_OUT_SUPPORT == 1) */
         }
 
-        dev->IF[dev->IfCount] = (USBD_IfHandleType*)itf;
-        dev->IfCount++;
-
-        retval = USBD_E_OK;
+        USBD_IfAttach(dev, (USBD_IfHandleType*)itf);
+        USBD_DescInvalidate(dev);
     }
 
     return retval;
@@ -79,7 +79,7 @@ static void             msc_outData     (USBD_MSC_IfHandleType *itf, USBD_EpHand
 static void             msc_inData      (USBD_MSC_IfHandleType *itf, USBD_EpHandleType *ep);
 
 /* MSC interface class callbacks structure */
-static const USBD_ClassType msc_cbks = {
+const USBD_ClassType USBD_MSC_Class = {
     .GetDescriptor  = (USBD_IfDescCbkType)  msc_getDesc,
     .GetString      = (USBD_IfStrCbkType)   msc_getString,
     .Init           = (USBD_IfCbkType)      msc_init,
@@ -194,13 +194,13 @@ static void msc_init(USBD_MSC_IfHandleType *itf)
     itf->Status = MSC_STATUS_NORMAL;
     itf->CSW.dSignature = csw_sign.dw;
 
-    msc_receiveCBW(itf);
-
     for (lun = 0; lun <= itf->Config.MaxLUN; lun++)
     {
         USBD_SAFE_CALLBACK(MSC_GetLU(itf, lun)->Init, lun);
     }
 
+    /* The OUT endpoint NAKs the commands until the media are initialized */
+    msc_receiveCBW(itf);
 }
 
 /**
@@ -432,16 +432,19 @@ const USBD_MSC_LUType* MSC_GetLU(USBD_MSC_IfHandleType *itf, uint8_t lun)
  * @param dev: reference of the USB Device
  * @return OK if the mounting was successful,
  *         ERROR if it failed due to insufficient device interface slots
+ *         (or descriptor buffer with USBD_CTRL_STREAMING),
+ *         INVALID if it isn't listed at the next position of USBD_STATIC_IF_LIST
  */
 USBD_ReturnType USBD_MSC_MountInterface(USBD_MSC_IfHandleType *itf, USBD_HandleType *dev)
 {
-    USBD_ReturnType retval = USBD_E_ERROR;
+    USBD_ReturnType retval = USBD_IfMountCheck(dev, (USBD_IfHandleType*)itf, 1,
+            sizeof(msc_desc) + 2 * sizeof(USB_EndpointDescType));
 
-    if (dev->IfCount < USBD_MAX_IF_COUNT)
+    if (retval == USBD_E_OK)
     {
         /* Binding interfaces */
         itf->Base.Device = dev;
-        itf->Base.Class  = &msc_cbks;
+        itf->Base.Class  = &USBD_MSC_Class;
         itf->Base.AltCount = 1;
         itf->Base.AltSelector = 0;
 
@@ -459,10 +462,8 @@ USBD_ReturnType USBD_MSC_MountInterface(USBD_MSC_IfHandleType *itf, USBD_HandleT
             ep->IfNum           = dev->IfCount;
         }
 
-        dev->IF[dev->IfCount] = (USBD_IfHandleType*)itf;
-        dev->IfCount++;
-
-        retval = USBD_E_OK;
+        USBD_IfAttach(dev, (USBD_IfHandleType*)itf);
+        USBD_DescInvalidate(dev);
     }
 
     return retval;
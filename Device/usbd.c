@@ -38,6 +38,14 @@ void USBD_Init(USBD_HandleType *dev, const USBD_DescriptionType *desc)
 {
     /* Assign USBD Descriptors */
     dev->Desc = desc;
+    USBD_DescInvalidate(dev);
+
+#if (USBD_TRACE_SIZE > 0)
+    /* The trace is self-describing for the decoder */
+    dev->Trace.Count      = 0;
+    dev->Trace.EntryCount = USBD_TRACE_SIZE;
+    dev->Trace.DataSize   = USBD_TRACE_DATA_SIZE;
+#endif
 
     /* Set Device initial State */
     dev->ConfigSelector = 0;
@@ -50,6 +58,32 @@ void USBD_Init(USBD_HandleType *dev, const USBD_DescriptionType *desc)
     dev->EP.IN [0].MaxPacketSize = USB_EP0_FS_MAX_PACKET_SIZE;
     dev->EP.OUT[0].MaxPacketSize = USB_EP0_FS_MAX_PACKET_SIZE;
 
+#if (USBD_EP_HANDLERS == 1)
+    {
+        uint8_t i;
+
+        /* The endpoints are dispatched to their interface class by default */
+        for (i = 0; i < USBD_MAX_EP_COUNT; i++)
+        {
+            dev->EP.IN [i].Handler.Complete = NULL;
+            dev->EP.OUT[i].Handler.Complete = NULL;
+        }
+    }
+#endif
+
+#if (USBD_EP_SCHEDULER == 1)
+    {
+        uint8_t i;
+
+        /* The IN endpoints are scheduled by their type by default */
+        for (i = 0; i < USBD_MAX_EP_COUNT; i++)
+        {
+            memset(&dev->EP.IN[i].Sched, 0, sizeof(dev->EP.IN[i].Sched));
+        }
+        memset(&dev->Sched, 0, sizeof(dev->Sched));
+    }
+#endif
+
     /* Initialize low level driver with device configuration */
     USBD_PD_Init(dev, &dev->Desc->Config);
 }
@@ -77,6 +111,7 @@ void USBD_UnmountInterfaces(USBD_HandleType *dev)
     USBD_IfConfig(dev, 0);
 
     dev->IfCount = 0;
+    USBD_DescInvalidate(dev);
 
     for (i = 1; i < USBD_MAX_EP_COUNT; i++)
     {
@@ -95,6 +130,7 @@ void USBD_Connect(USBD_HandleType *dev)
 {
     /* Start the low level driver */
     USBD_PD_Start(dev);
+    USBD_TRACE_LINK_STATE(dev);
 }
 
 /**
@@ -107,6 +143,7 @@ void USBD_Disconnect(USBD_HandleType *dev)
 
     /* Stop the low level driver */
     USBD_PD_Stop(dev);
+    USBD_TRACE_LINK_STATE(dev);
 }
 
 /**
@@ -149,6 +186,309 @@ USBD_ReturnType USBD_ClearRemoteWakeup(USBD_HandleType *dev)
     return retval;
 }
 
+#if (USBD_TRACE_SIZE > 0)
+/**
+ * @brief This function records the current link state in the device trace.
+ *        The Peripheral Drivers which don't report the suspend and resume
+ *        to the device have it called from the application's callbacks.
+ * @param dev: USB Device handle reference
+ */
+void USBD_TraceLinkState(USBD_HandleType *dev)
+{
+    USBD_TraceEvent(dev, USBD_TRACE_LINK, dev->LinkState, NULL, 0);
+}
+#endif /* (USBD_TRACE_SIZE > 0) */
+
+#if (USBD_EVENT_RECORDING == 1)
+/**
+ * @brief This function is called with each device event as it is handled,
+ *        so the application can store the event stream for a later replay.
+ *        The SETUP and EP_OUT records are followed by their data.
+ * @param dev: USB Device handle reference
+ * @param rec: the event record
+ * @param data: the data of the event, NULL if it isn't available
+ */
+__weak void USBD_RecordCallback(USBD_HandleType *dev, const USBD_RecordType *rec,
+        const uint8_t *data)
+{
+    (void)dev;
+    (void)rec;
+    (void)data;
+}
+
+/**
+ * @brief Passes a handled event to the recorder.
+ *        The setup request is serialized in its bus format.
+ * @param dev: USB Device handle reference
+ * @param id: the event type
+ * @param param: the new device speed or the endpoint address
+ * @param data: the OUT transfer data
+ * @param len: the transfer length
+ */
+void USBD_RecordEvent(USBD_HandleType *dev, USBD_EventIdType id, uint8_t param,
+        const uint8_t *data, USBD_LengthType len)
+{
+    USBD_RecordType rec;
+    uint8_t setup[8];
+
+    if (id == USBD_EVENT_SETUP)
+    {
+        setup[0] = dev->Setup.RequestType.b;
+        setup[1] = dev->Setup.Request;
+        setup[2] = (uint8_t)dev->Setup.Value;
+        setup[3] = (uint8_t)(dev->Setup.Value >> 8);
+        setup[4] = (uint8_t)dev->Setup.Index;
+        setup[5] = (uint8_t)(dev->Setup.Index >> 8);
+        setup[6] = (uint8_t)dev->Setup.Length;
+        setup[7] = (uint8_t)(dev->Setup.Length >> 8);
+        data = setup;
+        len  = sizeof(setup);
+    }
+
+    rec.Id     = id;
+    rec.Param  = param;
+    rec.Length = (len < 0xFFFF) ? len : 0xFFFF;
+    USBD_RecordCallback(dev, &rec, data);
+}
+#endif /* (USBD_EVENT_RECORDING == 1) */
+
+#if (USBD_DEFERRED_EVENTS == 1)
+/* The queue indexes are exchanged between the Peripheral Driver and
+ * USBD_Process with acquire / release semantics, so the event records
+ * are visible before the index is */
+#define EVT_LOAD(INDEX)             __atomic_load_n(&(INDEX), __ATOMIC_ACQUIRE)
+#define EVT_STORE(INDEX, VALUE)     __atomic_store_n(&(INDEX), (VALUE), __ATOMIC_RELEASE)
+#define EVT_TAKE(INDEX)             __atomic_exchange_n(&(INDEX), 0, __ATOMIC_ACQ_REL)
+#define EVT_RELEASE(INDEX, VALUE)   __atomic_compare_exchange_n(&(INDEX), &(VALUE), 0, \
+                                        0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)
+
+/* The queue slots kept free for the endpoint completions,
+ * the bus resets and setup requests overflow beyond this limit */
+#define USBD_EVENT_EP_RESERVE       (2 * USBD_MAX_EP_COUNT)
+
+/**
+ * @brief This function dispatches the queued events to their handlers.
+ *        It shall be called from a single thread context, after
+ *        @ref USBD_EventCallback indicates that events are pending.
+ * @param dev: USB Device handle reference
+ * @return The number of processed events
+ */
+uint16_t USBD_Process(USBD_HandleType *dev)
+{
+    uint16_t count = 0;
+    uint8_t tail = dev->Events.Tail;
+
+    for (;;)
+    {
+        /* The flush is checked last, so it can't be missed
+         * when the events following it are already visible */
+        uint8_t head   = EVT_LOAD(dev->Events.Head);
+        uint16_t setup = EVT_LOAD(dev->Events.Setup);
+        uint8_t flush  = EVT_TAKE(dev->Events.Flush);
+        USBD_EventType ev;
+
+        if (flush != 0)
+        {
+            /* An overflowed bus reset makes the preceding events obsolete */
+            tail = flush - 1;
+            EVT_STORE(dev->Events.Tail, tail);
+
+            ev.Id    = USBD_EVENT_RESET;
+            ev.Speed = dev->Events.Speed;
+        }
+        else if ((setup != 0) && (((setup & 0xFF) - 1) == tail))
+        {
+            /* The overflowed setup request is next in order,
+             * it is only valid if it wasn't replaced during the copy */
+            ev.Id    = USBD_EVENT_SETUP;
+            ev.Setup = dev->Events.Request;
+
+            if (!EVT_RELEASE(dev->Events.Setup, setup))
+            {
+                continue;
+            }
+        }
+        else if (tail != head)
+        {
+            ev = dev->Events.Queue[tail];
+
+            /* The slot is released before the handler is executed,
+             * since the handler might lead to new events */
+            tail = (tail + 1 < USBD_EVENT_QUEUE_SIZE) ? tail + 1 : 0;
+            EVT_STORE(dev->Events.Tail, tail);
+
+            /* The overflowed setup request replaces the queued ones */
+            if ((ev.Id == USBD_EVENT_SETUP) && (setup != 0))
+            {
+                continue;
+            }
+        }
+        else
+        {
+            break;
+        }
+
+        switch (ev.Id)
+        {
+            case USBD_EVENT_RESET:
+                USBD_ResetHandler(dev, ev.Speed);
+                break;
+
+            case USBD_EVENT_SETUP:
+                dev->Setup = ev.Setup;
+                USBD_SetupHandler(dev);
+                break;
+
+            case USBD_EVENT_EP_IN:
+                USBD_EpInHandler(dev, USBD_EpAddr2Ref(dev, ev.EpAddr));
+                break;
+
+            case USBD_EVENT_EP_OUT:
+                USBD_EpOutHandler(dev, USBD_EpAddr2Ref(dev, ev.EpAddr));
+                break;
+
+            default:
+                break;
+        }
+        count++;
+    }
+    return count;
+}
+
+/**
+ * @brief This function is called when a new event is queued for @ref USBD_Process.
+ *        It is called from the Peripheral Driver's (interrupt) context,
+ *        the application can use it to wake up the processing thread.
+ * @param dev: USB Device handle reference
+ */
+__weak void USBD_EventCallback(USBD_HandleType *dev)
+{
+    (void)dev;
+}
+
+/** @} */
+
+/** @ingroup USBD
+ * @defgroup USBD_Private_Functions_Event USB Device Event Deferral
+ * @brief The Peripheral Driver callbacks only queue the events in deferred mode
+ * @{ */
+
+/**
+ * @brief Queues an event for @ref USBD_Process.
+ * @param dev: USB Device handle reference
+ * @param ev: the event record
+ * @param reserve: the number of slots which have to remain free after queueing
+ * @return BUSY if the queue is full, OK if the event is queued
+ */
+static USBD_ReturnType USBD_EventPush(USBD_HandleType *dev, const USBD_EventType *ev, uint8_t reserve)
+{
+    uint8_t head = dev->Events.Head;
+    uint8_t tail = EVT_LOAD(dev->Events.Tail);
+    uint8_t next = (head + 1 < USBD_EVENT_QUEUE_SIZE) ? head + 1 : 0;
+    uint8_t used = (head >= tail) ? (head - tail) : (head + USBD_EVENT_QUEUE_SIZE - tail);
+
+    /* The queue is sized to fit a pending completion of each endpoint */
+    if ((used + reserve + 1) < USBD_EVENT_QUEUE_SIZE)
+    {
+        dev->Events.Queue[head] = *ev;
+        EVT_STORE(dev->Events.Head, next);
+
+        USBD_EventCallback(dev);
+        return USBD_E_OK;
+    }
+    else
+    {
+        return USBD_E_BUSY;
+    }
+}
+
+/**
+ * @brief Queues the bus reset event.
+ *        When the queue is full, the reset flushes the pending events instead.
+ * @param dev: USB Device handle reference
+ * @param speed: The new device speed
+ */
+void USBD_ResetCallback(USBD_HandleType *dev, USB_SpeedType speed)
+{
+    USBD_EventType ev;
+
+    ev.Id    = USBD_EVENT_RESET;
+    ev.Speed = speed;
+
+    if (USBD_EventPush(dev, &ev, USBD_EVENT_EP_RESERVE) != USBD_E_OK)
+    {
+        /* Any overflowed setup request is also obsolete */
+        (void)EVT_TAKE(dev->Events.Setup);
+
+        dev->Events.Speed = speed;
+        EVT_STORE(dev->Events.Flush, dev->Events.Head + 1);
+
+        USBD_EventCallback(dev);
+    }
+}
+
+/**
+ * @brief Queues the setup request event.
+ *        The request is copied, as the next one can be received before processing.
+ *        When the queue is full, the request replaces the pending ones instead.
+ * @param dev: USB Device handle reference
+ */
+void USBD_SetupCallback(USBD_HandleType *dev)
+{
+    USBD_EventType ev;
+
+    ev.Id    = USBD_EVENT_SETUP;
+    ev.Setup = dev->Setup;
+
+    if (USBD_EventPush(dev, &ev, USBD_EVENT_EP_RESERVE) != USBD_E_OK)
+    {
+        /* Invalidate the previous request before overwriting it,
+         * the sequence number tells USBD_Process if it was replaced */
+        (void)EVT_TAKE(dev->Events.Setup);
+
+        dev->Events.Request = dev->Setup;
+        dev->Events.SetupSeq++;
+        EVT_STORE(dev->Events.Setup,
+                  ((uint16_t)dev->Events.SetupSeq << 8) | (dev->Events.Head + 1));
+
+        USBD_EventCallback(dev);
+    }
+}
+
+/**
+ * @brief Queues the IN endpoint transfer completion event.
+ * @param dev: USB Device handle reference
+ * @param ep: USB IN endpoint handle reference
+ */
+void USBD_EpInCallback(USBD_HandleType *dev, USBD_EpHandleType *ep)
+{
+    USBD_EventType ev;
+
+    ev.Id     = USBD_EVENT_EP_IN;
+    ev.EpAddr = USBD_EpRef2Addr(dev, ep);
+    (void)USBD_EventPush(dev, &ev, 0);
+}
+
+/**
+ * @brief Queues the OUT endpoint transfer completion event.
+ * @param dev: USB Device handle reference
+ * @param ep: USB OUT endpoint handle reference
+ */
+void USBD_EpOutCallback(USBD_HandleType *dev, USBD_EpHandleType *ep)
+{
+    USBD_EventType ev;
+
+    ev.Id     = USBD_EVENT_EP_OUT;
+    ev.EpAddr = USBD_EpRef2Addr(dev, ep);
+    (void)USBD_EventPush(dev, &ev, 0);
+}
+
+/** @} */
+
+/** @addtogroup USBD_Exported_Functions
+ * @{ */
+#endif /* (USBD_DEFERRED_EVENTS == 1) */
+
 /**
  * @brief This function performs the necessary actions upon receiving Reset signal:
  *         - Opens the control endpoint 0
@@ -156,8 +496,16 @@ USBD_ReturnType USBD_ClearRemoteWakeup(USBD_HandleType *dev)
  * @param dev: USB Device handle reference
  * @param speed: The new device speed
  */
-void USBD_ResetCallback(USBD_HandleType *dev, USB_SpeedType speed)
+void USBD_ResetHandler(USBD_HandleType *dev, USB_SpeedType speed)
 {
+    USBD_TraceEvent(dev, USBD_TRACE_RESET, speed, NULL, 0);
+    USBD_RecordEvent(dev, USBD_EVENT_RESET, speed, NULL, 0);
+
+    /* The endpoint packet sizes depend on the speed */
+    if (dev->Speed != speed)
+    {
+        USBD_DescInvalidate(dev);
+    }
     dev->Speed = speed;
 
     /* Reset any previous configuration */
@@ -241,8 +589,11 @@ static USBD_ReturnType USBD_SetConfig(USBD_HandleType *dev)
 
     if (cfgNum <= USBD_MAX_CONFIGURATION_COUNT)
     {
+#if (USBD_ASYNC_CONFIG != 1)
         USBD_IfConfig(dev, cfgNum);
-
+#endif
+        /* Otherwise the interfaces are configured
+         * after the status stage is complete */
         retval = USBD_E_OK;
     }
     return retval;
@@ -35,8 +35,11 @@ static void USBD_CtrlSendError(USBD_HandleType *dev)
 {
     USBD_PD_EpSetStall(dev, 0x80);
     dev->EP.IN [0].State = USB_EP_STATE_STALL;
+    USBD_EP_STATS_INC(&dev->EP.IN [0], Stalls);
     USBD_PD_EpSetStall(dev, 0x00);
     dev->EP.OUT[0].State = USB_EP_STATE_STALL;
+    USBD_EP_STATS_INC(&dev->EP.OUT[0], Stalls);
+    USBD_TraceEvent(dev, USBD_TRACE_STALL, 0x00, NULL, 0);
 }
 
 /**
@@ -46,6 +49,7 @@ static void USBD_CtrlSendError(USBD_HandleType *dev)
 static void USBD_CtrlSendStatus(USBD_HandleType *dev)
 {
     dev->EP.IN[0].State = USB_EP_STATE_STATUS;
+    USBD_TraceSubmit(dev, 0x80, NULL, 0);
     USBD_PD_EpSend(dev, 0x80, NULL, 0);
 }
 
@@ -56,9 +60,35 @@ static void USBD_CtrlSendStatus(USBD_HandleType *dev)
 static void USBD_CtrlReceiveStatus(USBD_HandleType *dev)
 {
     dev->EP.OUT[0].State = USB_EP_STATE_STATUS;
+    USBD_TraceSubmit(dev, 0x00, NULL, 0);
     USBD_PD_EpReceive(dev, 0x00, NULL, 0);
 }
 
+#if (USBD_CTRL_STREAMING == 1)
+/**
+ * @brief This function generates and sends the next chunk of a streamed data stage.
+ *        Each chunk but the last one is a multiple of the EP0 max packet size,
+ *        so the host doesn't detect the end of the transfer prematurely.
+ * @param dev: USB Device handle reference
+ */
+static void USBD_CtrlStreamChunk(USBD_HandleType *dev)
+{
+    uint16_t mps = dev->EP.IN[0].MaxPacketSize;
+    uint16_t len = dev->CtrlStream.Length - dev->CtrlStream.Offset;
+
+    if (len > (USBD_EP0_BUFFER_SIZE - (USBD_EP0_BUFFER_SIZE % mps)))
+    {
+        len = USBD_EP0_BUFFER_SIZE - (USBD_EP0_BUFFER_SIZE % mps);
+    }
+
+    dev->CtrlStream.Generate(dev, dev->CtrlStream.Offset, dev->CtrlData, len);
+    dev->CtrlStream.Offset += len;
+
+    USBD_TraceSubmit(dev, 0x80, dev->CtrlData, len);
+    USBD_PD_EpSend(dev, 0x80, dev->CtrlData, len);
+}
+#endif /* (USBD_CTRL_STREAMING == 1) */
+
 /**
  * @brief This function manages the end of a control IN endpoint transfer:
  *         - Send Zero Length Packet if the end of the transfer is ambiguous
@@ -68,11 +98,30 @@ static void USBD_CtrlReceiveStatus(USBD_HandleType *dev)
  */
 void USBD_CtrlInCallback(USBD_HandleType *dev)
 {
+    uint16_t len = dev->EP.IN[0].Transfer.Length;
+
+#if (USBD_CTRL_STREAMING == 1)
+    if (dev->CtrlStream.Generate != NULL)
+    {
+        /* Continue the data stage with the next chunk */
+        if (dev->CtrlStream.Offset < dev->CtrlStream.Length)
+        {
+            USBD_CtrlStreamChunk(dev);
+            return;
+        }
+
+        /* The ZLP decision is based on the length of the entire data stage */
+        len = dev->CtrlStream.Length;
+        dev->CtrlStream.Generate = NULL;
+    }
+#endif /* (USBD_CTRL_STREAMING == 1) */
+
     /* Last packet is MPS multiple, so send ZLP packet */
-    if (( dev->EP.IN[0].Transfer.Length <  dev->Setup.Length) &&
-        ( dev->EP.IN[0].Transfer.Length >= dev->EP.IN[0].MaxPacketSize) &&
-        ((dev->EP.IN[0].Transfer.Length & (dev->EP.IN[0].MaxPacketSize - 1)) == 0))
+    if (( len <  dev->Setup.Length) &&
+        ( len >= dev->EP.IN[0].MaxPacketSize) &&
+        ((len & (dev->EP.IN[0].MaxPacketSize - 1)) == 0))
     {
+        USBD_TraceSubmit(dev, 0x80, NULL, 0);
         USBD_PD_EpSend(dev, 0x80, NULL, 0);
     }
     else
@@ -87,7 +136,7 @@ void USBD_CtrlInCallback(USBD_HandleType *dev)
                 (dev->Setup.RequestType.Recipient == USB_REQ_RECIPIENT_INTERFACE))
             {
                 /* If callback for transmitted EP0 data */
-                USBD_IfClass_DataStage(dev->IF[(uint8_t)dev->Setup.Index]);
+                USBD_IfClass_DataStage(USBD_IfRef(dev, (uint8_t)dev->Setup.Index));
             }
 
             /* Proceed to Status stage */
@@ -100,6 +149,14 @@ void USBD_CtrlInCallback(USBD_HandleType *dev)
         {
             USBD_PD_SetAddress(dev, dev->Setup.Value & 0x7F);
         }
+#endif
+#if (USBD_ASYNC_CONFIG == 1)
+        /* If the configuration was set by the last request, apply it now */
+        else if ((dev->Setup.RequestType.b == 0x00) &&
+                 (dev->Setup.Request == USB_REQ_SET_CONFIGURATION))
+        {
+            USBD_IfConfig(dev, (uint8_t)dev->Setup.Value);
+        }
 #endif
     }
 }
@@ -119,7 +176,7 @@ void USBD_CtrlOutCallback(USBD_HandleType *dev)
         if (dev->ConfigSelector != 0)
         {
             /* If callback for received EP0 data */
-            USBD_IfClass_DataStage(dev->IF[(uint8_t)dev->Setup.Index]);
+            USBD_IfClass_DataStage(USBD_IfRef(dev, (uint8_t)dev->Setup.Index));
         }
 
         /* Proceed to Status stage */
@@ -154,6 +211,7 @@ USBD_ReturnType USBD_CtrlSendData(USBD_HandleType *dev, void *data, uint16_t len
         }
 
         dev->EP.IN[0].State = USB_EP_STATE_DATA;
+        USBD_TraceSubmit(dev, 0x80, data, len);
         USBD_PD_EpSend(dev, 0x80, (const uint8_t*)data, len);
 
         retval = USBD_E_OK;
@@ -161,6 +219,44 @@ USBD_ReturnType USBD_CtrlSendData(USBD_HandleType *dev, void *data, uint16_t len
     return retval;
 }
 
+#if (USBD_CTRL_STREAMING == 1)
+/**
+ * @brief This function sends data through the control endpoint in response to a setup request,
+ *        while the data is generated in @ref USBD_EP0_BUFFER_SIZE long chunks
+ *        as the transfer progresses.
+ * @param dev: USB Device handle reference
+ * @param generate: the function which provides the requested parts of the data
+ * @param len: length of the entire data
+ * @return OK if called from the right context, ERROR otherwise
+ */
+USBD_ReturnType USBD_CtrlSendStream(USBD_HandleType *dev, USBD_CtrlStreamCbkType generate,
+        uint16_t len)
+{
+    USBD_ReturnType retval = USBD_E_ERROR;
+
+    /* Sanity check */
+    if ((dev->Setup.RequestType.Direction == USB_DIRECTION_IN) &&
+        (dev->EP.OUT[0].State == USB_EP_STATE_SETUP))
+    {
+        /* Don't send more bytes than requested */
+        if (dev->Setup.Length < len)
+        {
+            len = dev->Setup.Length;
+        }
+
+        dev->CtrlStream.Generate = generate;
+        dev->CtrlStream.Offset   = 0;
+        dev->CtrlStream.Length   = len;
+
+        dev->EP.IN[0].State = USB_EP_STATE_DATA;
+        USBD_CtrlStreamChunk(dev);
+
+        retval = USBD_E_OK;
+    }
+    return retval;
+}
+#endif /* (USBD_CTRL_STREAMING == 1) */
+
 /**
  * @brief This function receives control data according to the setup request.
  * @param dev: USB Device handle reference
@@ -183,6 +279,7 @@ USBD_ReturnType USBD_CtrlReceiveData(USBD_HandleType *dev, void *data, uint16_t
         }
 
         dev->EP.OUT[0].State = USB_EP_STATE_DATA;
+        USBD_TraceSubmit(dev, 0x00, data, len);
         USBD_PD_EpReceive(dev, 0x00, (uint8_t*)data, len);
 
         retval = USBD_E_OK;
@@ -201,11 +298,17 @@ USBD_ReturnType USBD_CtrlReceiveData(USBD_HandleType *dev, void *data, uint16_t
  *        or the request wasn't accepted.
  * @param dev: USB Device handle reference
  */
-void USBD_SetupCallback(USBD_HandleType *dev)
+void USBD_SetupHandler(USBD_HandleType *dev)
 {
     USBD_ReturnType retval = USBD_E_INVALID;
 
     dev->EP.OUT[0].State = USB_EP_STATE_SETUP;
+    USBD_TraceEvent(dev, USBD_TRACE_SETUP, 0, &dev->Setup, sizeof(dev->Setup));
+    USBD_RecordEvent(dev, USBD_EVENT_SETUP, 0, NULL, 0);
+#if (USBD_CTRL_STREAMING == 1)
+    /* A new request aborts the unfinished data stage */
+    dev->CtrlStream.Generate = NULL;
+#endif
 
     /* Route the request to the recipient */
     switch (dev->Setup.RequestType.Recipient)
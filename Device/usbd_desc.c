@@ -147,6 +147,7 @@ static uint16_t USBD_DeviceDesc(USBD_HandleType *dev, uint8_t *data)
     return sizeof(USB_DeviceDescType);
 }
 
+#if (USBD_CTRL_STREAMING != 1)
 /**
  * @brief This function assembles the USB configuration descriptor
  *        using the interface descriptors.
@@ -165,9 +166,9 @@ static uint16_t USBD_ConfigDesc(USBD_HandleType *dev, uint8_t *data)
     for (ifNum = 0; ifNum < dev->IfCount; ifNum++)
     {
         /* Associated interfaces return the entire descriptor */
-        if (dev->IF[ifNum] == itf) { continue; }
+        if (USBD_IfRef(dev, ifNum) == itf) { continue; }
 
-        itf = dev->IF[ifNum];
+        itf = USBD_IfRef(dev, ifNum);
         wTotalLength += USBD_IfClass_GetDesc(itf, ifNum, &data[wTotalLength]);
     }
 
@@ -183,39 +184,501 @@ static uint16_t USBD_ConfigDesc(USBD_HandleType *dev, uint8_t *data)
 
     return wTotalLength;
 }
+#endif /* (USBD_CTRL_STREAMING != 1) */
 
+#if (USBD_CTRL_STREAMING == 1)
 /**
- * @brief This function converts an ASCII string into a string descriptor.
- * @param str: the input ASCII string
+ * @brief This function generates a part of the USB configuration descriptor.
+ *        The interface descriptors are assembled one function at a time
+ *        in a temporary buffer, and only their parts within the window are kept.
+ *        The mounted functions are checked to fit the buffer by @ref USBD_IfMountCheck.
+ * @param dev: USB Device handle reference
+ * @param offset: offset of the requested part within the descriptor
+ * @param data: the target container for the requested part, NULL if only the length is queried
+ * @param len: length of the requested part
+ * @return The length of the entire descriptor
+ */
+static uint16_t USBD_ConfigDescStream(USBD_HandleType *dev, uint16_t offset,
+        uint8_t *data, uint16_t len)
+{
+    USBD_DescWindowType win = {
+        .Data     = data,
+        .Offset   = offset,
+        .Length   = len,
+        .Position = sizeof(USB_ConfigDescType),
+    };
+    USB_ConfigDescType desc;
+    uint8_t ifDesc[USBD_MAX_IF_DESC_SIZE] __align(USBD_DATA_ALIGNMENT);
+    uint8_t ifNum;
+    USBD_IfHandleType *itf = NULL;
+
+    /* Get the individual interface descriptors */
+    for (ifNum = 0; ifNum < dev->IfCount; ifNum++)
+    {
+        /* Associated interfaces return the entire descriptor */
+        if (USBD_IfRef(dev, ifNum) == itf) { continue; }
+
+        itf = USBD_IfRef(dev, ifNum);
+        USBD_DescWindowPut(&win, ifDesc, USBD_IfClass_GetDesc(itf, ifNum, ifDesc));
+    }
+
+    /* Get the configuration descriptor */
+    desc.bLength                = sizeof(USB_ConfigDescType);
+    desc.bDescriptorType        = USB_DESC_TYPE_CONFIGURATION;
+    desc.wTotalLength           = win.Position;
+    desc.bNumInterfaces         = dev->IfCount;
+    desc.bConfigurationValue    = 1;
+    desc.iConfiguration         = USBD_ISTR_CONFIG;
+    desc.bmAttributes           = 0x80 | dev->Desc->Config.b;
+    desc.bMaxPower              = dev->Desc->Config.MaxCurrent_mA / 2;
+
+    win.Position = 0;
+    USBD_DescWindowPut(&win, &desc, sizeof(desc));
+
+    return desc.wTotalLength;
+}
+
+#if (USBD_HS_SUPPORT == 1)
+/**
+ * @brief This function generates a part of the USB other speed configuration descriptor.
+ * @param dev: USB Device handle reference
+ * @param offset: offset of the requested part within the descriptor
+ * @param data: the target container for the requested part, NULL if only the length is queried
+ * @param len: length of the requested part
+ * @return The length of the entire descriptor
+ */
+static uint16_t USBD_OtherSpeedConfigDescStream(USBD_HandleType *dev, uint16_t offset,
+        uint8_t *data, uint16_t len)
+{
+    /* Workaround: temporarily set speed to full,
+     * so the configuration is assembled for full speed case */
+    dev->Speed = USB_SPEED_FULL;
+    len = USBD_ConfigDescStream(dev, offset, data, len);
+    dev->Speed = USB_SPEED_HIGH;
+
+    return len;
+}
+#endif /* (USBD_HS_SUPPORT == 1) */
+#endif /* (USBD_CTRL_STREAMING == 1) */
+
+#if (USBD_STATIC_INTERFACES == 1)
+/**
+ * @brief This function provides the prepared configuration descriptor
+ *        of the selected speed, if the application has one.
+ * @param dev: USB Device handle reference
+ * @param speed: the speed which the descriptor is prepared for
+ * @param data: set to the prepared descriptor if available
+ * @return The length of the descriptor, 0 if not available
+ */
+static uint16_t USBD_ConstConfigDesc(USBD_HandleType *dev, USB_SpeedType speed,
+        uint8_t **data)
+{
+    const uint8_t *desc = dev->Desc->ConfigDesc[speed];
+    uint16_t len = 0;
+
+    if (desc != NULL)
+    {
+        /* wTotalLength */
+        len = desc[2] | (desc[3] << 8);
+        *data = (uint8_t*)desc;
+    }
+    return len;
+}
+#endif /* (USBD_STATIC_INTERFACES == 1) */
+
+#if (USBD_CONFIG_DESC_CACHE_SIZE > 0)
+/**
+ * @brief This function provides the configuration descriptor of the selected speed
+ *        from the cache. If it isn't cached yet, the descriptor is assembled
+ *        in the provided container, and stored in the cache if it fits.
+ * @param dev: USB Device handle reference
+ * @param speed: the speed which the descriptor is assembled for
+ * @param data: the target container, set to the cached descriptor if available,
+ *        or to NULL if the descriptor has to be streamed
+ * @return The length of the descriptor
+ */
+static uint16_t USBD_CachedConfigDesc(USBD_HandleType *dev, USB_SpeedType speed,
+        uint8_t **data)
+{
+    uint16_t len = dev->ConfigDesc.Length[speed];
+
+    if (len == 0)
+    {
+        USB_SpeedType devSpeed = dev->Speed;
+
+        /* The interfaces assemble their descriptors for the current speed */
+        dev->Speed = speed;
+#if (USBD_CTRL_STREAMING == 1)
+        len = USBD_ConfigDescStream(dev, 0, NULL, 0);
+
+        if (len <= USBD_CONFIG_DESC_CACHE_SIZE)
+        {
+            USBD_ConfigDescStream(dev, 0, dev->ConfigDesc.Data[speed], len);
+            dev->ConfigDesc.Length[speed] = len;
+            *data = dev->ConfigDesc.Data[speed];
+        }
+        else
+        {
+            /* Too long for the cache, has to be streamed */
+            *data = NULL;
+        }
+#else
+        len = USBD_ConfigDesc(dev, *data);
+
+        if (len <= USBD_CONFIG_DESC_CACHE_SIZE)
+        {
+            memcpy(dev->ConfigDesc.Data[speed], *data, len);
+            dev->ConfigDesc.Length[speed] = len;
+        }
+#endif /* (USBD_CTRL_STREAMING == 1) */
+        dev->Speed = devSpeed;
+    }
+    else
+    {
+        *data = dev->ConfigDesc.Data[speed];
+    }
+    return len;
+}
+#endif /* (USBD_CONFIG_DESC_CACHE_SIZE > 0) */
+
+/**
+ * @brief This function decodes the next character of a UTF-8 string
+ *        into UTF-16 code units.
+ * @param str: reference of the string position, advanced past the character
+ * @param utf16: the target container for the (up to 2) code units
+ * @return The number of code units, 0 at the end of the string
+ */
+static uint8_t USBD_Utf8Decode(const uint8_t **str, uint16_t *utf16)
+{
+    const uint8_t *src = *str;
+    uint32_t code = *src++;
+    uint8_t count = 1, ext = 0;
+
+    if (code == 0)
+    {
+        return 0;
+    }
+    else if (code >= 0xF0)
+    {
+        code &= 0x07;
+        ext = 3;
+    }
+    else if (code >= 0xE0)
+    {
+        code &= 0x0F;
+        ext = 2;
+    }
+    else if (code >= 0xC0)
+    {
+        code &= 0x1F;
+        ext = 1;
+    }
+    else if (code >= 0x80)
+    {
+        /* Stray continuation byte */
+        code = 0xFFFD;
+    }
+
+    for (; ext > 0; ext--)
+    {
+        /* Truncated sequence */
+        if ((*src & 0xC0) != 0x80)
+        {
+            code = 0xFFFD;
+            break;
+        }
+        code = (code << 6) | (*src++ & 0x3F);
+    }
+
+    if (code > 0x10FFFF)
+    {
+        code = 0xFFFD;
+    }
+    else if (code >= 0x10000)
+    {
+        /* Encode as surrogate pair */
+        code -= 0x10000;
+        utf16[1] = 0xDC00 | (code & 0x3FF);
+        code = 0xD800 | (code >> 10);
+        count = 2;
+    }
+    utf16[0] = (uint16_t)code;
+
+    *str = src;
+    return count;
+}
+
+#if (USBD_CTRL_STREAMING != 1)
+/**
+ * @brief This function converts a UTF-8 string into a string descriptor.
+ * @param str: the input UTF-8 string
  * @param data: the target container for the string descriptor
  * @return The length of the descriptor
  */
 static uint16_t USBD_GetStringDesc(const char *str, uint8_t *data)
 {
-    uint16_t *dst = (uint16_t*)&data[2];
+    const uint8_t *src = (const uint8_t*)str;
+    uint16_t utf16[2];
+    uint8_t count;
+
     data[0] = 2;
     data[1] = USB_DESC_TYPE_STRING;
 
-    /* If ASCII, convert to Unicode */
-    if (str[1] != 0)
+    /* Convert to Unicode, the descriptor length is limited to 8 bits */
+    while (((count = USBD_Utf8Decode(&src, utf16)) > 0) &&
+           ((data[0] + count * sizeof(uint16_t)) <= 0xFF))
     {
-        uint8_t  *src = (uint8_t*)str;
-        while (*src != 0)
+        memcpy(&data[data[0]], utf16, count * sizeof(uint16_t));
+        data[0] += count * sizeof(uint16_t);
+    }
+    return data[0];
+}
+#endif /* (USBD_CTRL_STREAMING != 1) */
+
+/**
+ * @brief This function looks up the string of the requested string descriptor index.
+ * @param dev: USB Device handle reference
+ * @return Reference of the UTF-8 string, NULL if not available
+ */
+static const char* USBD_StringDescSource(USBD_HandleType *dev)
+{
+    const char *str;
+
+    /* Low byte is the descriptor iIndex,
+     * Setup.Index == LangID of requested string */
+    switch (dev->Setup.Value & 0xFF)
+    {
+        case USBD_ISTR_VENDOR:
+            str = dev->Desc->Vendor.Name;
+            break;
+
+        case USBD_ISTR_PRODUCT:
+            str = dev->Desc->Product.Name;
+            break;
+
+        case USBD_ISTR_CONFIG:
+            str = dev->Desc->Config.Name;
+            break;
+
+#if (USBD_MS_OS_DESC_VERSION == 1)
+        case USBD_ISTR_MS_OS_1p0_DESC:
+            str = usbd_msos1p0;
+            break;
+#endif /* (USBD_MS_OS_DESC_VERSION == 1) */
+
+        default:
+            str = USBD_IfString(dev);
+            break;
+    }
+    return str;
+}
+
+#if (USBD_CTRL_STREAMING == 1)
+/**
+ * @brief This function generates a part of the requested string descriptor.
+ * @param dev: USB Device handle reference
+ * @param offset: offset of the requested part within the descriptor
+ * @param data: the target container for the requested part, NULL if only the length is queried
+ * @param len: length of the requested part
+ * @return The length of the entire descriptor
+ */
+static uint16_t USBD_StringDescStream(USBD_HandleType *dev, uint16_t offset,
+        uint8_t *data, uint16_t len)
+{
+    USBD_DescWindowType win = {
+        .Data     = data,
+        .Offset   = offset,
+        .Length   = len,
+        .Position = 2,
+    };
+    const uint8_t *src = (const uint8_t*)USBD_StringDescSource(dev);
+    uint16_t utf16[2];
+    uint8_t header[2], count;
+
+    /* Convert to Unicode, the descriptor length is limited to 8 bits */
+    while (((count = USBD_Utf8Decode(&src, utf16)) > 0) &&
+           ((win.Position + count * sizeof(uint16_t)) <= 0xFF))
+    {
+        USBD_DescWindowPut(&win, utf16, count * sizeof(uint16_t));
+    }
+
+    header[0] = win.Position;
+    header[1] = USB_DESC_TYPE_STRING;
+
+    win.Position = 0;
+    USBD_DescWindowPut(&win, header, sizeof(header));
+
+    return header[0];
+}
+#endif /* (USBD_CTRL_STREAMING == 1) */
+
+#if (USBD_CONST_STRING_TABLE == 1)
+/**
+ * @brief This function looks up a string descriptor in the device's constant string table.
+ * @param dev: USB Device handle reference
+ * @param index: the string descriptor index
+ * @return Reference of the string descriptor, NULL if not found
+ */
+static const uint8_t* USBD_ConstStringFind(USBD_HandleType *dev, uint8_t index)
+{
+    const USBD_StringTableEntryType *entry = dev->Desc->StringTable;
+
+    if (entry != NULL)
+    {
+        for (; entry->Desc != NULL; entry++)
         {
-            *dst++ = (uint16_t)*src++;
-            data[0] += sizeof(uint16_t);
+            if (entry->Index == index)
+            {
+                return entry->Desc;
+            }
         }
     }
-    else /* If Unicode already, just copy */
+    return NULL;
+}
+#endif /* (USBD_CONST_STRING_TABLE == 1) */
+
+#if (USBD_STRING_TABLE_SIZE > 0)
+/** @brief Each string descriptor in the table starts at aligned position */
+#define USBD_STRING_TABLE_ALIGN(POS)    \
+    (((POS) + USBD_DATA_ALIGNMENT - 1) & ~(USBD_DATA_ALIGNMENT - 1))
+
+/**
+ * @brief This function looks up a converted string descriptor in the string table.
+ * @param dev: USB Device handle reference
+ * @param index: the string descriptor index
+ * @return Reference of the string descriptor, NULL if not found
+ */
+static uint8_t* USBD_StringTableFind(USBD_HandleType *dev, uint8_t index)
+{
+    uint16_t pos = 0;
+
+    while (pos < dev->Strings.Length)
     {
-        uint16_t *src = (uint16_t*)str;
-        while (*src != 0)
+        uint8_t *desc = &dev->Strings.Data[pos];
+
+        /* The index is stored after the descriptor */
+        if (desc[desc[0]] == index)
         {
-            *dst++ = *src++;
-            data[0] += sizeof(uint16_t);
+            return desc;
         }
+        pos = USBD_STRING_TABLE_ALIGN(pos + desc[0] + 1);
     }
-    return data[0];
+    return NULL;
+}
+
+/**
+ * @brief This function allocates space for a string descriptor in the string table.
+ * @param dev: USB Device handle reference
+ * @param index: the string descriptor index
+ * @param len: the length of the string descriptor
+ * @return Reference of the allocated descriptor space, NULL if the table is full
+ */
+static uint8_t* USBD_StringTableAdd(USBD_HandleType *dev, uint8_t index, uint16_t len)
+{
+    uint8_t *desc = NULL;
+
+    if ((dev->Strings.Length + len + 1) <= USBD_STRING_TABLE_SIZE)
+    {
+        desc = &dev->Strings.Data[dev->Strings.Length];
+        desc[len] = index;
+        dev->Strings.Length = USBD_STRING_TABLE_ALIGN(dev->Strings.Length + len + 1);
+    }
+    return desc;
+}
+#endif /* (USBD_STRING_TABLE_SIZE > 0) */
+
+/**
+ * @brief This function provides the requested string descriptor.
+ *        Prepared descriptors are served from the string tables,
+ *        otherwise the string is converted, and stored in the table if it fits.
+ * @param dev: USB Device handle reference
+ * @param data: the target container, set to the prepared descriptor if available,
+ *        or to NULL if the descriptor has to be streamed
+ * @return The length of the descriptor
+ */
+static uint16_t USBD_StringDesc(USBD_HandleType *dev, uint8_t **data)
+{
+    uint16_t len = 0;
+    uint8_t index = dev->Setup.Value & 0xFF;
+#if (USBD_CONST_STRING_TABLE == 1) || (USBD_STRING_TABLE_SIZE > 0)
+    const uint8_t *desc = NULL;
+
+#if (USBD_CONST_STRING_TABLE == 1)
+    desc = USBD_ConstStringFind(dev, index);
+#endif
+#if (USBD_STRING_TABLE_SIZE > 0)
+    if (desc == NULL)
+    {
+        desc = USBD_StringTableFind(dev, index);
+    }
+#endif
+    if (desc != NULL)
+    {
+        /* Prepared descriptor, no conversion needed */
+        *data = (uint8_t*)desc;
+        return desc[0];
+    }
+#endif /* (USBD_CONST_STRING_TABLE == 1) || (USBD_STRING_TABLE_SIZE > 0) */
+
+    /* Low byte is the descriptor iIndex */
+    switch (index)
+    {
+        /* Zero index returns the list of supported Unicode
+         * language identifiers */
+        case USBD_ISTR_LANGID:
+            *data = (uint8_t*)&usbd_langIdDesc;
+            return sizeof(usbd_langIdDesc);
+
+#if (USBD_SERIAL_BCD_SIZE > 0)
+        case USBD_ISTR_SERIAL:
+            (*data)[0] = len = 2 + USBD_SERIAL_BCD_SIZE * 2;
+            (*data)[1] = USB_DESC_TYPE_STRING;
+            Uint2Unicode((const uint8_t*)dev->Desc->SerialNumber,
+                    &(*data)[2], USBD_SERIAL_BCD_SIZE);
+            break;
+#endif /* (USBD_SERIAL_BCD_SIZE > 0) */
+
+        default:
+        {
+            const char* str = USBD_StringDescSource(dev);
+
+            if (str != NULL)
+            {
+#if (USBD_CTRL_STREAMING == 1)
+                *data = NULL;
+                len = USBD_StringDescStream(dev, 0, NULL, 0);
+#else
+                len = USBD_GetStringDesc(str, *data);
+#endif
+            }
+            break;
+        }
+    }
+
+#if (USBD_STRING_TABLE_SIZE > 0)
+    /* Store the converted descriptor, so it is only converted once */
+    if (len > 0)
+    {
+        uint8_t *entry = USBD_StringTableAdd(dev, index, len);
+
+        if (entry != NULL)
+        {
+#if (USBD_CTRL_STREAMING == 1)
+            if (*data == NULL)
+            {
+                USBD_StringDescStream(dev, 0, entry, len);
+            }
+            else
+#endif
+            {
+                memcpy(entry, *data, len);
+            }
+            *data = entry;
+        }
+    }
+#endif /* (USBD_STRING_TABLE_SIZE > 0) */
+
+    return len;
 }
 
 /**
@@ -229,6 +692,9 @@ USBD_ReturnType USBD_GetDescriptor(USBD_HandleType *dev)
 
     uint16_t len = 0;
     uint8_t *data = dev->CtrlData;
+#if (USBD_CTRL_STREAMING == 1)
+    USBD_CtrlStreamCbkType stream = NULL;
+#endif
 
     /* High byte identifies descriptor type */
     switch (dev->Setup.Value >> 8)
@@ -241,62 +707,33 @@ USBD_ReturnType USBD_GetDescriptor(USBD_HandleType *dev)
 
         case USB_DESC_TYPE_CONFIGURATION:
         {
+#if (USBD_STATIC_INTERFACES == 1)
+            len = USBD_ConstConfigDesc(dev, dev->Speed, &data);
+            if (len > 0)
+            {
+                break;
+            }
+#endif
+#if (USBD_CONFIG_DESC_CACHE_SIZE > 0)
+            len = USBD_CachedConfigDesc(dev, dev->Speed, &data);
+#elif (USBD_CTRL_STREAMING == 1)
+            data = NULL;
+            len = USBD_ConfigDescStream(dev, 0, NULL, 0);
+#else
             len = USBD_ConfigDesc(dev, data);
+#endif
+#if (USBD_CTRL_STREAMING == 1)
+            stream = USBD_ConfigDescStream;
+#endif
             break;
         }
 
         case USB_DESC_TYPE_STRING:
         {
-            /* Low byte is the descriptor iIndex */
-            switch (dev->Setup.Value & 0xFF)
-            {
-                /* Zero index returns the list of supported Unicode
-                 * language identifiers */
-                case USBD_ISTR_LANGID:
-                    data = (uint8_t*)&usbd_langIdDesc;
-                    len  = sizeof(usbd_langIdDesc);
-                    break;
-
-                /* Otherwise Setup.Index == LangID of requested string */
-
-                case USBD_ISTR_VENDOR:
-                    len = USBD_GetStringDesc(dev->Desc->Vendor.Name, data);
-                    break;
-
-                case USBD_ISTR_PRODUCT:
-                    len = USBD_GetStringDesc(dev->Desc->Product.Name, data);
-                    break;
-
-                case USBD_ISTR_CONFIG:
-                    len = USBD_GetStringDesc(dev->Desc->Config.Name, data);
-                    break;
-
-#if (USBD_SERIAL_BCD_SIZE > 0)
-                case USBD_ISTR_SERIAL:
-                    data[0] = len = 2 + USBD_SERIAL_BCD_SIZE * 2;
-                    data[1] = USB_DESC_TYPE_STRING;
-                    Uint2Unicode((const uint8_t*)dev->Desc->SerialNumber,
-                            &data[2], USBD_SERIAL_BCD_SIZE);
-                    break;
-#endif /* (USBD_SERIAL_BCD_SIZE > 0) */
-
-#if (USBD_MS_OS_DESC_VERSION == 1)
-                case USBD_ISTR_MS_OS_1p0_DESC:
-                    len = USBD_GetStringDesc(usbd_msos1p0, data);
-                    break;
-#endif /* (USBD_MS_OS_DESC_VERSION == 1) */
-
-                default:
-                {
-                    const char* str = USBD_IfString(dev);
-
-                    if (str != NULL)
-                    {
-                        len = USBD_GetStringDesc(str, data);
-                    }
-                    break;
-                }
-            }
+            len = USBD_StringDesc(dev, &data);
+#if (USBD_CTRL_STREAMING == 1)
+            stream = USBD_StringDescStream;
+#endif
             break;
         }
 
@@ -315,11 +752,28 @@ USBD_ReturnType USBD_GetDescriptor(USBD_HandleType *dev)
         {
             if (dev->Speed == USB_SPEED_HIGH)
             {
+#if (USBD_STATIC_INTERFACES == 1)
+                len = USBD_ConstConfigDesc(dev, USB_SPEED_FULL, &data);
+                if (len > 0)
+                {
+                    break;
+                }
+#endif
+#if (USBD_CONFIG_DESC_CACHE_SIZE > 0)
+                len = USBD_CachedConfigDesc(dev, USB_SPEED_FULL, &data);
+#elif (USBD_CTRL_STREAMING == 1)
+                data = NULL;
+                len = USBD_OtherSpeedConfigDescStream(dev, 0, NULL, 0);
+#else
                 /* Workaround: temporarily set speed to full,
                  * so the configuration is assembled for full speed case */
                 dev->Speed = USB_SPEED_FULL;
                 len = USBD_ConfigDesc(dev, data);
                 dev->Speed = USB_SPEED_HIGH;
+#endif
+#if (USBD_CTRL_STREAMING == 1)
+                stream = USBD_OtherSpeedConfigDescStream;
+#endif
             }
             break;
         }
@@ -332,7 +786,11 @@ USBD_ReturnType USBD_GetDescriptor(USBD_HandleType *dev)
 
 #if (USBD_MS_OS_DESC_VERSION == 2)
             /* first find out the length of the OS descriptor */
+#if (USBD_CTRL_STREAMING == 1)
+            len = USBD_MsOs2p0DescStream(dev, 0, NULL, 0);
+#else
             len = USBD_MsOs2p0Desc(dev, data);
+#endif
 
             /* copy the default BOS */
             memcpy(bos, &usbd_bosDesc, sizeof(usbd_bosDesc));
@@ -365,7 +823,17 @@ USBD_ReturnType USBD_GetDescriptor(USBD_HandleType *dev)
     /* Transfer the non-null descriptor */
     if (len > 0)
     {
-        retval = USBD_CtrlSendData(dev, data, len);
+#if (USBD_CTRL_STREAMING == 1)
+        /* The descriptor is generated as the transfer progresses */
+        if (data == NULL)
+        {
+            retval = USBD_CtrlSendStream(dev, stream, len);
+        }
+        else
+#endif
+        {
+            retval = USBD_CtrlSendData(dev, data, len);
+        }
     }
 
     return retval;
@@ -376,6 +844,38 @@ USBD_ReturnType USBD_GetDescriptor(USBD_HandleType *dev)
 /** @addtogroup USBD_Internal_Functions
  * @{ */
 
+#if (USBD_CTRL_STREAMING == 1)
+/**
+ * @brief This function emits the next element of a descriptor,
+ *        copying only its part that falls into the generated window.
+ * @param win: the generated descriptor window
+ * @param src: the descriptor element
+ * @param len: length of the descriptor element
+ */
+void USBD_DescWindowPut(USBD_DescWindowType *win, const void *src, uint16_t len)
+{
+    uint32_t start = win->Position;
+    uint32_t end   = (uint32_t)win->Position + len;
+
+    /* Clip the element to the window */
+    if (start < win->Offset)
+    {
+        start = win->Offset;
+    }
+    if (end > ((uint32_t)win->Offset + win->Length))
+    {
+        end = (uint32_t)win->Offset + win->Length;
+    }
+
+    if ((win->Data != NULL) && (start < end))
+    {
+        memcpy(&win->Data[start - win->Offset],
+               (const uint8_t*)src + (start - win->Position), end - start);
+    }
+    win->Position += len;
+}
+#endif /* (USBD_CTRL_STREAMING == 1) */
+
 /**
  * @brief This function returns the input endpoint's descriptor and length.
  * @param dev: USB Device handle reference
@@ -23,6 +23,477 @@
   */
 #include <private/usbd_private.h>
 
+/**
+ * @brief Calculates the total length of a segmented transfer.
+ * @param segs: the transfer segments
+ * @param count: number of segments
+ * @return The sum of the segment lengths
+ */
+static uint32_t USBD_EpSgLength(const USBD_EpSegmentType *segs, uint8_t count)
+{
+    uint32_t len = 0;
+
+    while (count-- > 0)
+    {
+        len += segs[count].Length;
+    }
+    return len;
+}
+
+#if (USBD_EP_ATOMIC_CLAIM == 1) && defined(USBD_CRITICAL_ENTER)
+#define USBD_EP_CRITICAL_ENTER()    USBD_CRITICAL_ENTER()
+#define USBD_EP_CRITICAL_EXIT()     USBD_CRITICAL_EXIT()
+#else
+#define USBD_EP_CRITICAL_ENTER()
+#define USBD_EP_CRITICAL_EXIT()
+#endif
+
+/**
+ * @brief Claims the endpoint for a new transfer if it's idle,
+ *        isochronous endpoints are always claimed.
+ * @param ep: USB endpoint handle reference
+ * @return 1 if the endpoint is claimed, 0 if it's busy
+ */
+static inline uint8_t USBD_EpClaim(USBD_EpHandleType *ep)
+{
+    uint8_t claimed = 1;
+
+    if (ep->Type == USB_EP_TYPE_ISOCHRONOUS)
+    {
+        ep->State = USB_EP_STATE_DATA;
+    }
+    else
+    {
+#if (USBD_EP_ATOMIC_CLAIM == 1) && !defined(USBD_CRITICAL_ENTER)
+        USB_EndPointStateType idle = USB_EP_STATE_IDLE;
+
+        claimed = __atomic_compare_exchange_n(&ep->State, &idle, USB_EP_STATE_DATA,
+                0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+#else
+        USBD_EP_CRITICAL_ENTER();
+        if (ep->State == USB_EP_STATE_IDLE)
+        {
+            ep->State = USB_EP_STATE_DATA;
+        }
+        else
+        {
+            claimed = 0;
+        }
+        USBD_EP_CRITICAL_EXIT();
+#endif
+        if (claimed == 0)
+        {
+            USBD_EP_STATS_INC(ep, Busy);
+        }
+    }
+    return claimed;
+}
+
+/**
+ * @brief Releases the endpoint after its transfer is over.
+ * @param ep: USB endpoint handle reference
+ */
+static inline void USBD_EpRelease(USBD_EpHandleType *ep)
+{
+#if (USBD_EP_ATOMIC_CLAIM == 1) && !defined(USBD_CRITICAL_ENTER)
+    __atomic_store_n(&ep->State, USB_EP_STATE_IDLE, __ATOMIC_RELEASE);
+#else
+    ep->State = USB_EP_STATE_IDLE;
+#endif
+}
+
+/**
+ * @brief Records the start of a transfer in the endpoint statistics.
+ * @param ep: USB endpoint handle reference
+ */
+static inline void USBD_EpStatsStart(USBD_EpHandleType *ep)
+{
+#if (USBD_EP_STATS == 1) && defined(USBD_EP_STATS_TIMESTAMP)
+    ep->StartTime = USBD_EP_STATS_TIMESTAMP();
+#endif
+    (void)ep;
+}
+
+/**
+ * @brief Records the completion of a transfer in the endpoint statistics.
+ * @param ep: USB endpoint handle reference
+ */
+static inline void USBD_EpStatsComplete(USBD_EpHandleType *ep)
+{
+#if (USBD_EP_STATS == 1)
+#ifdef USBD_EP_STATS_TIMESTAMP
+    uint32_t elapsed = USBD_EP_STATS_TIMESTAMP() - ep->StartTime;
+    uint8_t bin = 0;
+
+    /* Bin n counts the [2^(n-1), 2^n) range, the last one everything above */
+    while ((elapsed > 0) && (bin < (USBD_EP_STATS_BINS - 1)))
+    {
+        elapsed >>= 1;
+        bin++;
+    }
+    ep->Stats.Latency[bin]++;
+#endif
+    ep->Stats.Transfers++;
+    ep->Stats.Bytes += ep->Transfer.Length;
+    if (ep->Transfer.Length == 0)
+    {
+        ep->Stats.ZeroLength++;
+    }
+#endif
+    (void)ep;
+}
+
+#if (USBD_EP_SCHEDULER == 1)
+/* Scheduling states of the IN endpoints */
+#define EP_SCHED_IDLE           0
+#define EP_SCHED_PENDING        1
+#define EP_SCHED_STARTED        2
+
+#ifdef USBD_EP_SCHED_TIMESTAMP
+#define EP_SCHED_NOW(DEV)       USBD_EP_SCHED_TIMESTAMP()
+#else
+/* Without a time source the time advances with each submission */
+#define EP_SCHED_NOW(DEV)       ((DEV)->Sched.Clock)
+#endif
+
+/**
+ * @brief Determines the effective priority class of the IN endpoint.
+ * @param ep: USB endpoint handle reference
+ * @return The priority class, higher value is served first
+ */
+static inline uint8_t USBD_EpSchedPriority(USBD_EpHandleType *ep)
+{
+    uint8_t prio = ep->Sched.Priority;
+
+    if (prio == USBD_EP_PRIO_DEFAULT)
+    {
+        prio = (ep->Type == USB_EP_TYPE_INTERRUPT) ? USBD_EP_PRIO_HIGH : USBD_EP_PRIO_NORMAL;
+    }
+    return prio;
+}
+
+/**
+ * @brief Determines the position of the endpoint in the bulk round-robin.
+ *        The turn holder comes first until its budget is used up, then it's last.
+ * @param dev: USB Device handle reference
+ * @param epNum: endpoint number
+ * @return The rank of the endpoint, lower is served first
+ */
+static inline uint8_t USBD_EpSchedRank(USBD_HandleType *dev, uint8_t epNum)
+{
+    uint8_t rank = (epNum + USBD_MAX_EP_COUNT - dev->Sched.Turn) % USBD_MAX_EP_COUNT;
+
+    if ((rank == 0) && (dev->Sched.Used >= USBD_EP_SCHED_BUDGET))
+    {
+        rank = USBD_MAX_EP_COUNT;
+    }
+    return rank;
+}
+
+/**
+ * @brief Selects the pending IN endpoint which is started next:
+ *        the highest priority class wins, within it the endpoints with deadline hints
+ *        are served by earliest deadline first, before the rest,
+ *        which share the bandwidth in byte budgeted turns.
+ * @param dev: USB Device handle reference
+ * @return The endpoint number to start, 0 if none is pending
+ */
+static uint8_t USBD_EpSchedSelect(USBD_HandleType *dev)
+{
+    uint8_t i, best = 0;
+
+    for (i = 1; i < USBD_MAX_EP_COUNT; i++)
+    {
+        USBD_EpHandleType *ep = &dev->EP.IN[i], *sel = &dev->EP.IN[best];
+
+        if (ep->Sched.State != EP_SCHED_PENDING)
+        {
+        }
+        else if ((best == 0) ||
+                 (USBD_EpSchedPriority(ep) > USBD_EpSchedPriority(sel)))
+        {
+            best = i;
+        }
+        else if (USBD_EpSchedPriority(ep) < USBD_EpSchedPriority(sel))
+        {
+        }
+        else if ((ep->Sched.Deadline > 0) && (sel->Sched.Deadline > 0))
+        {
+            /* Earliest deadline first, wraparound safe */
+            if ((int32_t)((ep->Sched.Submitted + ep->Sched.Deadline) -
+                          (sel->Sched.Submitted + sel->Sched.Deadline)) < 0)
+            {
+                best = i;
+            }
+        }
+        else if (ep->Sched.Deadline > 0)
+        {
+            best = i;
+        }
+        else if ((sel->Sched.Deadline == 0) &&
+                 (USBD_EpSchedRank(dev, i) < USBD_EpSchedRank(dev, best)))
+        {
+            best = i;
+        }
+    }
+    return best;
+}
+
+/**
+ * @brief Starts the selected pending IN transfers while there are free slots.
+ *        Must be called inside the endpoint critical section.
+ * @param dev: USB Device handle reference
+ */
+static void USBD_EpSchedRun(USBD_HandleType *dev)
+{
+    uint8_t epNum;
+
+    while ((dev->Sched.Active < USBD_EP_SCHED_SLOTS) &&
+           ((epNum = USBD_EpSchedSelect(dev)) != 0))
+    {
+        USBD_EpHandleType *ep = &dev->EP.IN[epNum];
+        uint32_t wait = EP_SCHED_NOW(dev) - ep->Sched.Submitted;
+
+        ep->Sched.Wait.Count++;
+        ep->Sched.Wait.Total += wait;
+        if (wait > ep->Sched.Wait.Max)
+        {
+            ep->Sched.Wait.Max = wait;
+        }
+
+        /* The bulk turn passes when another endpoint is selected,
+         * or the budget is exceeded */
+        if ((ep->Type == USB_EP_TYPE_BULK) && (ep->Sched.Deadline == 0))
+        {
+            if ((epNum != dev->Sched.Turn) || (dev->Sched.Used >= USBD_EP_SCHED_BUDGET))
+            {
+                dev->Sched.Turn = epNum;
+                dev->Sched.Used = 0;
+            }
+            dev->Sched.Used += ep->Transfer.Length;
+        }
+
+        ep->Sched.State = EP_SCHED_STARTED;
+        dev->Sched.Active++;
+        USBD_PD_EpSend(dev, 0x80 | epNum, ep->Transfer.Data, ep->Transfer.Length);
+    }
+}
+
+/**
+ * @brief Passes the IN transfer to the scheduler, isochronous transfers
+ *        are started immediately. Must be called inside the endpoint critical section.
+ * @param dev: USB Device handle reference
+ * @param ep: USB IN endpoint handle reference
+ * @param data: pointer to the data to send
+ * @param len: length of the data
+ */
+static void USBD_EpSchedSubmit(USBD_HandleType *dev, USBD_EpHandleType *ep,
+        const uint8_t *data, USBD_LengthType len)
+{
+    if (ep->Type == USB_EP_TYPE_ISOCHRONOUS)
+    {
+        USBD_PD_EpSend(dev, USBD_EpRef2Addr(dev, ep), data, len);
+    }
+    else
+    {
+        ep->Transfer.Data   = (uint8_t*)data;
+        ep->Transfer.Length = len;
+#ifndef USBD_EP_SCHED_TIMESTAMP
+        dev->Sched.Clock++;
+#endif
+        ep->Sched.Submitted = EP_SCHED_NOW(dev);
+        ep->Sched.State     = EP_SCHED_PENDING;
+        USBD_EpSchedRun(dev);
+    }
+}
+
+/**
+ * @brief Removes the endpoint's transfer from the scheduler, and releases its slot
+ *        if it's already started. Must be called inside the endpoint critical section.
+ * @param dev: USB Device handle reference
+ * @param ep: USB IN endpoint handle reference
+ */
+static void USBD_EpSchedAbort(USBD_HandleType *dev, USBD_EpHandleType *ep)
+{
+    if (ep->Sched.State == EP_SCHED_STARTED)
+    {
+        dev->Sched.Active--;
+    }
+    ep->Sched.State = EP_SCHED_IDLE;
+    USBD_EpSchedRun(dev);
+}
+
+/**
+ * @brief Registers the completion of the endpoint's scheduled transfer,
+ *        and starts the next pending transfers in its slot.
+ * @param dev: USB Device handle reference
+ * @param ep: USB IN endpoint handle reference
+ */
+static void USBD_EpSchedComplete(USBD_HandleType *dev, USBD_EpHandleType *ep)
+{
+    USBD_EP_CRITICAL_ENTER();
+    if (ep->Sched.State == EP_SCHED_STARTED)
+    {
+        ep->Sched.State = EP_SCHED_IDLE;
+        dev->Sched.Active--;
+#if (USBD_EP_QUEUE_SUPPORT == 1)
+        /* The next queued request is submitted first, so it competes for the slot */
+        if ((ep->Queue.Head == NULL) || (ep->Queue.Head->Next == NULL))
+#endif
+        {
+            USBD_EpSchedRun(dev);
+        }
+    }
+    USBD_EP_CRITICAL_EXIT();
+}
+#endif /* (USBD_EP_SCHEDULER == 1) */
+
+/**
+ * @brief Starts the IN transfer in the peripheral, or passes it to the scheduler.
+ * @param dev: USB Device handle reference
+ * @param ep: USB IN endpoint handle reference
+ * @param data: pointer to the data to send
+ * @param len: length of the data
+ */
+static inline void USBD_EpStartSend(USBD_HandleType *dev, USBD_EpHandleType *ep,
+        const uint8_t *data, USBD_LengthType len)
+{
+#if (USBD_EP_SCHEDULER == 1)
+    USBD_EP_CRITICAL_ENTER();
+    USBD_EpSchedSubmit(dev, ep, data, len);
+    USBD_EP_CRITICAL_EXIT();
+#else
+    USBD_PD_EpSend(dev, USBD_EpRef2Addr(dev, ep), data, len);
+#endif
+}
+
+#if (USBD_EP_SG_SUPPORT != 1) && (USBD_EP_SG_BUFFER_SIZE > 0)
+/**
+ * @brief Releases the linearization buffer when the endpoint's segmented
+ *        transfer is completed, and scatters the received data to the segments.
+ * @param dev: USB Device handle reference
+ * @param ep: USB endpoint handle reference
+ */
+static void USBD_EpSgRelease(USBD_HandleType *dev, USBD_EpHandleType *ep)
+{
+    uint8_t epAddr = USBD_EpRef2Addr(dev, ep);
+
+    if (dev->SgBuffer.EpAddr == epAddr)
+    {
+        if (epAddr < 0x80)
+        {
+            const uint8_t *data = dev->SgBuffer.Buffer;
+            USBD_LengthType len = ep->Transfer.Length;
+            uint8_t i;
+
+            for (i = 0; (i < dev->SgBuffer.Count) && (len > 0); i++)
+            {
+                USBD_LengthType n = dev->SgBuffer.Segments[i].Length;
+
+                if (n > len)
+                {
+                    n = len;
+                }
+                memcpy(dev->SgBuffer.Segments[i].Data, data, n);
+                data += n;
+                len  -= n;
+            }
+        }
+        dev->SgBuffer.EpAddr = 0;
+    }
+}
+#endif /* (USBD_EP_SG_SUPPORT != 1) && (USBD_EP_SG_BUFFER_SIZE > 0) */
+
+#if (USBD_EP_SG_SUPPORT != 1) && (USBD_EP_SG_BUFFER_SIZE > 0)
+/**
+ * @brief Claims the shared linearization buffer for the endpoint's segmented transfer.
+ * @param dev: USB Device handle reference
+ * @param epAddr: endpoint address
+ * @return 1 if the buffer is claimed, 0 if it's used by another endpoint
+ */
+static inline uint8_t USBD_EpSgClaim(USBD_HandleType *dev, uint8_t epAddr)
+{
+#if (USBD_EP_ATOMIC_CLAIM == 1) && !defined(USBD_CRITICAL_ENTER)
+    uint8_t unused = 0;
+
+    return __atomic_compare_exchange_n(&dev->SgBuffer.EpAddr, &unused, epAddr,
+            0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+#else
+    uint8_t claimed = 0;
+
+    USBD_EP_CRITICAL_ENTER();
+    if (dev->SgBuffer.EpAddr == 0)
+    {
+        dev->SgBuffer.EpAddr = epAddr;
+        claimed = 1;
+    }
+    USBD_EP_CRITICAL_EXIT();
+    return claimed;
+#endif
+}
+#endif /* (USBD_EP_SG_SUPPORT != 1) && (USBD_EP_SG_BUFFER_SIZE > 0) */
+
+#if (USBD_EP_QUEUE_SUPPORT == 1)
+/**
+ * @brief Starts the transfer of the first queued request on the endpoint.
+ * @param dev: USB Device handle reference
+ * @param ep: USB endpoint handle reference
+ */
+static void USBD_EpQueueStart(USBD_HandleType *dev, USBD_EpHandleType *ep)
+{
+    USBD_EpRequestType *req = ep->Queue.Head;
+    uint8_t epAddr = USBD_EpRef2Addr(dev, ep);
+
+    ep->State = USB_EP_STATE_DATA;
+    USBD_EpStatsStart(ep);
+    USBD_TraceSubmit(dev, epAddr, req->Data, req->Length);
+
+    if (epAddr > 0x7F)
+    {
+#if (USBD_EP_SCHEDULER == 1)
+        USBD_EpSchedSubmit(dev, ep, (const uint8_t*)req->Data, req->Length);
+#else
+        USBD_PD_EpSend(dev, epAddr, (const uint8_t*)req->Data, req->Length);
+#endif
+    }
+    else
+    {
+        USBD_PD_EpReceive(dev, epAddr, req->Data, req->Length);
+    }
+}
+
+/**
+ * @brief Completes the active request of the endpoint,
+ *        and starts the next queued one.
+ * @param dev: USB Device handle reference
+ * @param ep: USB endpoint handle reference
+ */
+static void USBD_EpQueueComplete(USBD_HandleType *dev, USBD_EpHandleType *ep)
+{
+    USBD_EpRequestType *req = ep->Queue.Head;
+
+    USBD_EP_CRITICAL_ENTER();
+    ep->State = USB_EP_STATE_IDLE;
+    req->Actual = ep->Transfer.Length;
+    ep->Queue.Head = req->Next;
+    req->Next = NULL;
+
+    /* The next transfer is started before the completion is notified,
+     * so the endpoint can proceed while the callback is executed */
+    if (ep->Queue.Head != NULL)
+    {
+        USBD_EpQueueStart(dev, ep);
+    }
+    else
+    {
+        ep->Queue.Tail = NULL;
+    }
+    USBD_EP_CRITICAL_EXIT();
+
+    USBD_SAFE_CALLBACK(req->Complete, req);
+}
+#endif /* (USBD_EP_QUEUE_SUPPORT == 1) */
+
 /** @ingroup USBD
  * @defgroup USBD_Internal_Functions USB Device Internal Functions
  * @brief This group is used by the Device and the Classes.
@@ -37,17 +508,17 @@
  * @return BUSY if the endpoint isn't idle, OK if successful
  */
 USBD_ReturnType USBD_EpSend(USBD_HandleType *dev, uint8_t epAddr,
-        void *data, uint16_t len)
+        void *data, USBD_LengthType len)
 {
     USBD_ReturnType retval = USBD_E_BUSY;
     USBD_EpHandleType *ep = &dev->EP.IN[epAddr & 0xF];
 
-    if ((ep->State == USB_EP_STATE_IDLE) ||
-        (ep->Type  == USB_EP_TYPE_ISOCHRONOUS))
+    if (USBD_EpClaim(ep))
     {
         /* Set EP transfer data */
-        ep->State = USB_EP_STATE_DATA;
-        USBD_PD_EpSend(dev, epAddr, (const uint8_t*)data, len);
+        USBD_EpStatsStart(ep);
+        USBD_TraceSubmit(dev, epAddr, data, len);
+        USBD_EpStartSend(dev, ep, (const uint8_t*)data, len);
 
         retval = USBD_E_OK;
     }
@@ -64,16 +535,16 @@ USBD_ReturnType USBD_EpSend(USBD_HandleType *dev, uint8_t epAddr,
  * @return BUSY if the endpoint isn't idle, OK if successful
  */
 USBD_ReturnType USBD_EpReceive(USBD_HandleType *dev, uint8_t epAddr,
-        void *data, uint16_t len)
+        void *data, USBD_LengthType len)
 {
     USBD_ReturnType retval = USBD_E_BUSY;
     USBD_EpHandleType *ep = &dev->EP.OUT[epAddr];
 
-    if ((ep->State == USB_EP_STATE_IDLE) ||
-        (ep->Type  == USB_EP_TYPE_ISOCHRONOUS))
+    if (USBD_EpClaim(ep))
     {
         /* Set EP transfer data */
-        ep->State = USB_EP_STATE_DATA;
+        USBD_EpStatsStart(ep);
+        USBD_TraceSubmit(dev, epAddr, data, len);
         USBD_PD_EpReceive(dev, epAddr, (uint8_t*)data, len);
 
         retval = USBD_E_OK;
@@ -82,6 +553,350 @@ USBD_ReturnType USBD_EpReceive(USBD_HandleType *dev, uint8_t epAddr,
     return retval;
 }
 
+/**
+ * @brief This function sends the data segments through the selected IN endpoint
+ *        as a single transfer. The segment boundaries don't need to be
+ *        aligned to the packet size.
+ * @param dev: USB Device handle reference
+ * @param epAddr: endpoint address
+ * @param segs: the data segments, which must remain valid until the transfer completes
+ * @param count: number of segments
+ * @return BUSY if the endpoint isn't idle,
+ *         INVALID if the transfer is too long, OK if successful
+ */
+USBD_ReturnType USBD_EpSendv(USBD_HandleType *dev, uint8_t epAddr,
+        const USBD_EpSegmentType *segs, uint8_t count)
+{
+    USBD_ReturnType retval = USBD_E_BUSY;
+    uint32_t len = USBD_EpSgLength(segs, count);
+
+    if (len > USBD_MAX_TRANSFER_LENGTH)
+    {
+        retval = USBD_E_INVALID;
+    }
+    else if (count < 2)
+    {
+        /* A single segment doesn't need special treatment */
+        retval = USBD_EpSend(dev, epAddr, (count > 0) ? segs->Data : NULL, len);
+    }
+#if (USBD_EP_SG_SUPPORT == 1)
+    else
+    {
+        USBD_EpHandleType *ep = &dev->EP.IN[epAddr & 0xF];
+
+        if (USBD_EpClaim(ep))
+        {
+            USBD_EpStatsStart(ep);
+            USBD_TraceSubmit(dev, epAddr, NULL, len);
+            USBD_PD_EpSendv(dev, epAddr, segs, count);
+
+            retval = USBD_E_OK;
+        }
+    }
+#elif (USBD_EP_SG_BUFFER_SIZE > 0)
+    else if (len > USBD_EP_SG_BUFFER_SIZE)
+    {
+        retval = USBD_E_INVALID;
+    }
+    else
+    {
+        USBD_EpHandleType *ep = &dev->EP.IN[epAddr & 0xF];
+
+        if (USBD_EpClaim(ep))
+        {
+            if (USBD_EpSgClaim(dev, epAddr))
+            {
+                uint8_t *data = dev->SgBuffer.Buffer;
+                uint8_t i;
+
+                /* Gather the segments into the linear buffer */
+                for (i = 0; i < count; i++)
+                {
+                    memcpy(data, segs[i].Data, segs[i].Length);
+                    data += segs[i].Length;
+                }
+                dev->SgBuffer.Segments = segs;
+                dev->SgBuffer.Count    = count;
+
+                USBD_EpStatsStart(ep);
+                USBD_TraceSubmit(dev, epAddr, dev->SgBuffer.Buffer, len);
+                USBD_EpStartSend(dev, ep, dev->SgBuffer.Buffer, len);
+
+                retval = USBD_E_OK;
+            }
+            else
+            {
+                /* The buffer is used by another endpoint */
+                USBD_EpRelease(ep);
+            }
+        }
+    }
+#else
+    else
+    {
+        retval = USBD_E_INVALID;
+    }
+#endif
+
+    return retval;
+}
+
+/**
+ * @brief This function prepares the reception of a single transfer
+ *        through the selected OUT endpoint into the data segments.
+ *        The segment boundaries don't need to be aligned to the packet size.
+ * @param dev: USB Device handle reference
+ * @param epAddr: endpoint address
+ * @param segs: the target segments, which must remain valid until the transfer completes
+ * @param count: number of segments
+ * @return BUSY if the endpoint isn't idle,
+ *         INVALID if the transfer is too long, OK if successful
+ */
+USBD_ReturnType USBD_EpReceivev(USBD_HandleType *dev, uint8_t epAddr,
+        const USBD_EpSegmentType *segs, uint8_t count)
+{
+    USBD_ReturnType retval = USBD_E_BUSY;
+    uint32_t len = USBD_EpSgLength(segs, count);
+
+    if (len > USBD_MAX_TRANSFER_LENGTH)
+    {
+        retval = USBD_E_INVALID;
+    }
+    else if (count < 2)
+    {
+        /* A single segment doesn't need special treatment */
+        retval = USBD_EpReceive(dev, epAddr, (count > 0) ? segs->Data : NULL, len);
+    }
+#if (USBD_EP_SG_SUPPORT == 1)
+    else
+    {
+        USBD_EpHandleType *ep = &dev->EP.OUT[epAddr];
+
+        if (USBD_EpClaim(ep))
+        {
+            USBD_EpStatsStart(ep);
+            USBD_TraceSubmit(dev, epAddr, NULL, len);
+            USBD_PD_EpReceivev(dev, epAddr, segs, count);
+
+            retval = USBD_E_OK;
+        }
+    }
+#elif (USBD_EP_SG_BUFFER_SIZE > 0)
+    else if (len > USBD_EP_SG_BUFFER_SIZE)
+    {
+        retval = USBD_E_INVALID;
+    }
+    else
+    {
+        USBD_EpHandleType *ep = &dev->EP.OUT[epAddr];
+
+        if (USBD_EpClaim(ep))
+        {
+            if (USBD_EpSgClaim(dev, epAddr))
+            {
+                /* The received data is scattered to the segments at completion */
+                dev->SgBuffer.Segments = segs;
+                dev->SgBuffer.Count    = count;
+
+                USBD_EpStatsStart(ep);
+                USBD_TraceSubmit(dev, epAddr, dev->SgBuffer.Buffer, len);
+                USBD_PD_EpReceive(dev, epAddr, dev->SgBuffer.Buffer, len);
+
+                retval = USBD_E_OK;
+            }
+            else
+            {
+                /* The buffer is used by another endpoint */
+                USBD_EpRelease(ep);
+            }
+        }
+    }
+#else
+    else
+    {
+        retval = USBD_E_INVALID;
+    }
+#endif
+
+    return retval;
+}
+
+#if (USBD_EP_QUEUE_SUPPORT == 1)
+/**
+ * @brief This function queues a transfer request on the selected endpoint.
+ *        The request is started immediately if the endpoint is idle,
+ *        otherwise when the previously queued requests are completed.
+ * @param dev: USB Device handle reference
+ * @param epAddr: endpoint address
+ * @param req: the transfer request, which must remain valid until its completion
+ * @return BUSY if the endpoint is used by a non-queued transfer,
+ *         ERROR if the endpoint is closed, OK if successful
+ */
+USBD_ReturnType USBD_EpSubmit(USBD_HandleType *dev, uint8_t epAddr,
+        USBD_EpRequestType *req)
+{
+    USBD_ReturnType retval = USBD_E_ERROR;
+    USBD_EpHandleType *ep = USBD_EpAddr2Ref(dev, epAddr);
+
+    USBD_EP_CRITICAL_ENTER();
+    if (ep->State == USB_EP_STATE_CLOSED)
+    {
+    }
+    else if ((ep->Queue.Head == NULL) && (ep->State == USB_EP_STATE_DATA))
+    {
+        USBD_EP_STATS_INC(ep, Busy);
+        retval = USBD_E_BUSY;
+    }
+    else
+    {
+        req->Next   = NULL;
+        req->Actual = 0;
+
+        if (ep->Queue.Head == NULL)
+        {
+            ep->Queue.Head = req;
+        }
+        else
+        {
+            ep->Queue.Tail->Next = req;
+        }
+        ep->Queue.Tail = req;
+
+        /* Stalled endpoints start the transfer when the halt is cleared */
+        if (ep->State == USB_EP_STATE_IDLE)
+        {
+            USBD_EpQueueStart(dev, ep);
+        }
+        retval = USBD_E_OK;
+    }
+    USBD_EP_CRITICAL_EXIT();
+
+    return retval;
+}
+
+/**
+ * @brief This function removes a transfer request from the endpoint's queue.
+ *        If the request is in progress, the endpoint is flushed,
+ *        and the next request is started. The request isn't completed.
+ * @param dev: USB Device handle reference
+ * @param epAddr: endpoint address
+ * @param req: the transfer request to cancel
+ * @return INVALID if the request isn't queued on the endpoint, OK if successful
+ */
+USBD_ReturnType USBD_EpCancel(USBD_HandleType *dev, uint8_t epAddr,
+        USBD_EpRequestType *req)
+{
+    USBD_ReturnType retval = USBD_E_INVALID;
+    USBD_EpHandleType *ep = USBD_EpAddr2Ref(dev, epAddr);
+    USBD_EpRequestType **pos, *prev = NULL;
+
+    USBD_EP_CRITICAL_ENTER();
+    for (pos = &ep->Queue.Head; *pos != NULL; pos = &prev->Next)
+    {
+        if (*pos == req)
+        {
+            uint8_t active = (pos == &ep->Queue.Head) &&
+                             (ep->State == USB_EP_STATE_DATA);
+
+            *pos = req->Next;
+            if (ep->Queue.Tail == req)
+            {
+                ep->Queue.Tail = prev;
+            }
+            req->Next = NULL;
+
+            if (active)
+            {
+                USBD_PD_EpFlush(dev, epAddr);
+                ep->State = USB_EP_STATE_IDLE;
+#if (USBD_EP_SCHEDULER == 1)
+                if (epAddr > 0x7F)
+                {
+                    USBD_EpSchedAbort(dev, ep);
+                }
+#endif
+
+                if (ep->Queue.Head != NULL)
+                {
+                    USBD_EpQueueStart(dev, ep);
+                }
+            }
+            retval = USBD_E_OK;
+            break;
+        }
+        prev = *pos;
+    }
+    USBD_EP_CRITICAL_EXIT();
+
+    return retval;
+}
+
+/**
+ * @brief This function completes all queued requests of the endpoint
+ *        without any transferred data, when the endpoint is flushed or closed.
+ *        The requests are removed before the completions are notified,
+ *        so the callbacks can submit new requests.
+ * @param dev: USB Device handle reference
+ * @param epAddr: endpoint address
+ */
+void USBD_EpQueueFlush(USBD_HandleType *dev, uint8_t epAddr)
+{
+    USBD_EpHandleType *ep = USBD_EpAddr2Ref(dev, epAddr);
+    USBD_EpRequestType *req;
+
+    USBD_EP_CRITICAL_ENTER();
+    req = ep->Queue.Head;
+    ep->Queue.Head = ep->Queue.Tail = NULL;
+    USBD_EP_CRITICAL_EXIT();
+
+    while (req != NULL)
+    {
+        USBD_EpRequestType *next = req->Next;
+
+        req->Next   = NULL;
+        req->Actual = 0;
+        USBD_SAFE_CALLBACK(req->Complete, req);
+        req = next;
+    }
+}
+
+/**
+ * @brief This function restarts the first queued request of the endpoint,
+ *        when its halt is cleared.
+ * @param dev: USB Device handle reference
+ * @param epAddr: endpoint address
+ */
+void USBD_EpQueueResume(USBD_HandleType *dev, uint8_t epAddr)
+{
+    USBD_EpHandleType *ep = USBD_EpAddr2Ref(dev, epAddr);
+
+    USBD_EP_CRITICAL_ENTER();
+    if ((ep->Queue.Head != NULL) && (ep->State == USB_EP_STATE_IDLE))
+    {
+        USBD_EpQueueStart(dev, ep);
+    }
+    USBD_EP_CRITICAL_EXIT();
+}
+#endif /* (USBD_EP_QUEUE_SUPPORT == 1) */
+
+#if (USBD_EP_SCHEDULER == 1)
+/**
+ * @brief This function removes the IN endpoint's pending or started transfer
+ *        from the transmit scheduler, when the endpoint is closed, flushed or halted.
+ * @param dev: USB Device handle reference
+ * @param epAddr: endpoint address
+ */
+void USBD_EpSchedCancel(USBD_HandleType *dev, uint8_t epAddr)
+{
+    if ((epAddr > 0x80) && ((epAddr & 0xF) < USBD_MAX_EP_COUNT))
+    {
+        USBD_EP_CRITICAL_ENTER();
+        USBD_EpSchedAbort(dev, &dev->EP.IN[epAddr & 0xF]);
+        USBD_EP_CRITICAL_EXIT();
+    }
+}
+#endif /* (USBD_EP_SCHEDULER == 1) */
+
 /** @} */
 
 /** @addtogroup USBD_Exported_Functions
@@ -93,16 +908,45 @@ USBD_ReturnType USBD_EpReceive(USBD_HandleType *dev, uint8_t epAddr,
  * @param dev: USB Device handle reference
  * @param ep: USB IN endpoint handle reference
  */
-void USBD_EpInCallback(USBD_HandleType *dev, USBD_EpHandleType *ep)
+void USBD_EpInHandler(USBD_HandleType *dev, USBD_EpHandleType *ep)
 {
+    USBD_TraceComplete(dev, ep);
+    USBD_RecordEvent(dev, USBD_EVENT_EP_IN, USBD_EpRef2Addr(dev, ep),
+            NULL, ep->Transfer.Length);
+
     if (ep == &dev->EP.IN[0])
     {
         USBD_CtrlInCallback(dev);
     }
     else
     {
-        ep->State = USB_EP_STATE_IDLE;
-        USBD_IfClass_InData(dev->IF[ep->IfNum], ep);
+        USBD_EpStatsComplete(ep);
+#if (USBD_EP_SCHEDULER == 1)
+        USBD_EpSchedComplete(dev, ep);
+#endif
+#if (USBD_EP_SG_SUPPORT != 1) && (USBD_EP_SG_BUFFER_SIZE > 0)
+        USBD_EpSgRelease(dev, ep);
+#endif
+#if (USBD_EP_QUEUE_SUPPORT == 1)
+        if (ep->Queue.Head != NULL)
+        {
+            USBD_EpQueueComplete(dev, ep);
+        }
+        else
+#endif
+        {
+            USBD_EpRelease(ep);
+#if (USBD_EP_HANDLERS == 1)
+            if (ep->Handler.Complete != NULL)
+            {
+                ep->Handler.Complete(ep->Handler.Context, ep);
+            }
+            else
+#endif
+            {
+                USBD_IfClass_InData(USBD_IfRef(dev, ep->IfNum), ep);
+            }
+        }
     }
 }
 
@@ -112,20 +956,162 @@ void USBD_EpInCallback(USBD_HandleType *dev, USBD_EpHandleType *ep)
  * @param dev: USB Device handle reference
  * @param ep: USB OUT endpoint handle reference
  */
-void USBD_EpOutCallback(USBD_HandleType *dev, USBD_EpHandleType *ep)
+void USBD_EpOutHandler(USBD_HandleType *dev, USBD_EpHandleType *ep)
 {
-    ep->State = USB_EP_STATE_IDLE;
+    USBD_TraceComplete(dev, ep);
+    USBD_RecordEvent(dev, USBD_EVENT_EP_OUT, USBD_EpRef2Addr(dev, ep),
+            ep->RxBuffer, ep->Transfer.Length);
 
     if (ep == &dev->EP.OUT[0])
     {
+        ep->State = USB_EP_STATE_IDLE;
         USBD_CtrlOutCallback(dev);
     }
     else
     {
-        USBD_IfClass_OutData(dev->IF[ep->IfNum], ep);
+        USBD_EpStatsComplete(ep);
+#if (USBD_EP_SG_SUPPORT != 1) && (USBD_EP_SG_BUFFER_SIZE > 0)
+        USBD_EpSgRelease(dev, ep);
+#endif
+#if (USBD_EP_QUEUE_SUPPORT == 1)
+        if (ep->Queue.Head != NULL)
+        {
+            USBD_EpQueueComplete(dev, ep);
+        }
+        else
+#endif
+        {
+            USBD_EpRelease(ep);
+#if (USBD_EP_HANDLERS == 1)
+            if (ep->Handler.Complete != NULL)
+            {
+                ep->Handler.Complete(ep->Handler.Context, ep);
+            }
+            else
+#endif
+            {
+                USBD_IfClass_OutData(USBD_IfRef(dev, ep->IfNum), ep);
+            }
+        }
     }
 }
 
+#if (USBD_EP_STATS == 1)
+/**
+ * @brief This function provides the collected statistics of an endpoint.
+ *        The transfer counters of the control endpoint aren't maintained.
+ * @param dev: USB Device handle reference
+ * @param epAddr: endpoint address
+ * @param stats: the statistics output
+ * @return INVALID if the endpoint address is invalid, OK if successful
+ */
+USBD_ReturnType USBD_GetEpStats(USBD_HandleType *dev, uint8_t epAddr,
+        USBD_EpStatsType *stats)
+{
+    USBD_ReturnType retval = USBD_E_INVALID;
+
+    if ((epAddr & 0x7F) < USBD_MAX_EP_COUNT)
+    {
+        *stats = USBD_EpAddr2Ref(dev, epAddr)->Stats;
+        retval = USBD_E_OK;
+    }
+
+    return retval;
+}
+
+/**
+ * @brief This function resets the collected statistics of an endpoint.
+ * @param dev: USB Device handle reference
+ * @param epAddr: endpoint address
+ * @return INVALID if the endpoint address is invalid, OK if successful
+ */
+USBD_ReturnType USBD_ClearEpStats(USBD_HandleType *dev, uint8_t epAddr)
+{
+    USBD_ReturnType retval = USBD_E_INVALID;
+
+    if ((epAddr & 0x7F) < USBD_MAX_EP_COUNT)
+    {
+        memset(&USBD_EpAddr2Ref(dev, epAddr)->Stats, 0, sizeof(USBD_EpStatsType));
+        retval = USBD_E_OK;
+    }
+
+    return retval;
+}
+#endif /* (USBD_EP_STATS == 1) */
+
+#if (USBD_EP_SCHEDULER == 1)
+/**
+ * @brief This function sets the transmit scheduling parameters of an IN endpoint.
+ *        The setting is kept when the endpoint is reopened.
+ * @param dev: USB Device handle reference
+ * @param epAddr: IN endpoint address
+ * @param priority: the priority class of the endpoint
+ * @param deadline: the maximal desired waiting time of the endpoint's transfers
+ *        (in USBD_EP_SCHED_TIMESTAMP ticks, or number of submissions without it),
+ *        0 to share the bandwidth with the other endpoints of the priority class
+ * @return INVALID if the endpoint address is invalid, OK if successful
+ */
+USBD_ReturnType USBD_SetEpPriority(USBD_HandleType *dev, uint8_t epAddr,
+        USBD_EpPriorityType priority, uint32_t deadline)
+{
+    USBD_ReturnType retval = USBD_E_INVALID;
+
+    if ((epAddr > 0x80) && ((epAddr & 0xF) < USBD_MAX_EP_COUNT))
+    {
+        USBD_EpHandleType *ep = &dev->EP.IN[epAddr & 0xF];
+
+        USBD_EP_CRITICAL_ENTER();
+        ep->Sched.Priority = priority;
+        ep->Sched.Deadline = deadline;
+        USBD_EP_CRITICAL_EXIT();
+        retval = USBD_E_OK;
+    }
+
+    return retval;
+}
+
+/**
+ * @brief This function provides the scheduler waiting times of an IN endpoint,
+ *        measured from the submission to the start of the transfers.
+ * @param dev: USB Device handle reference
+ * @param epAddr: IN endpoint address
+ * @param stats: the waiting time statistics output
+ * @return INVALID if the endpoint address is invalid, OK if successful
+ */
+USBD_ReturnType USBD_GetEpWaitStats(USBD_HandleType *dev, uint8_t epAddr,
+        USBD_EpWaitStatsType *stats)
+{
+    USBD_ReturnType retval = USBD_E_INVALID;
+
+    if ((epAddr > 0x80) && ((epAddr & 0xF) < USBD_MAX_EP_COUNT))
+    {
+        *stats = dev->EP.IN[epAddr & 0xF].Sched.Wait;
+        retval = USBD_E_OK;
+    }
+
+    return retval;
+}
+
+/**
+ * @brief This function resets the scheduler waiting times of an IN endpoint.
+ * @param dev: USB Device handle reference
+ * @param epAddr: IN endpoint address
+ * @return INVALID if the endpoint address is invalid, OK if successful
+ */
+USBD_ReturnType USBD_ClearEpWaitStats(USBD_HandleType *dev, uint8_t epAddr)
+{
+    USBD_ReturnType retval = USBD_E_INVALID;
+
+    if ((epAddr > 0x80) && ((epAddr & 0xF) < USBD_MAX_EP_COUNT))
+    {
+        memset(&dev->EP.IN[epAddr & 0xF].Sched.Wait, 0, sizeof(USBD_EpWaitStatsType));
+        retval = USBD_E_OK;
+    }
+
+    return retval;
+}
+#endif /* (USBD_EP_SCHEDULER == 1) */
+
 /** @} */
 
 /** @addtogroup USBD_Private_Functions_Ctrl
@@ -163,6 +1149,11 @@ USBD_ReturnType USBD_EpRequest(USBD_HandleType *dev)
                     {
                         USBD_PD_EpSetStall(dev, epAddr);
                         ep->State = USB_EP_STATE_STALL;
+#if (USBD_EP_SCHEDULER == 1)
+                        USBD_EpSchedCancel(dev, epAddr);
+#endif
+                        USBD_EP_STATS_INC(ep, Stalls);
+                        USBD_TraceEvent(dev, USBD_TRACE_STALL, epAddr, NULL, 0);
                     }
                 }
                 break;
@@ -179,16 +1170,31 @@ USBD_ReturnType USBD_EpRequest(USBD_HandleType *dev)
                         USBD_PD_EpClearStall(dev, epAddr);
                         ep->State = USB_EP_STATE_IDLE;
 
+#if (USBD_EP_QUEUE_SUPPORT == 1)
+                        /* Restart the interrupted queued transfer */
+                        if (ep->Queue.Head != NULL)
+                        {
+                            USBD_EpQueueStart(dev, ep);
+                            break;
+                        }
+#endif
                         ep->Transfer.Length = 0;
                         /* Workaround: notify interface of ready endpoint
                          * by completion callback with 0 length */
+#if (USBD_EP_HANDLERS == 1)
+                        if (ep->Handler.Complete != NULL)
+                        {
+                            ep->Handler.Complete(ep->Handler.Context, ep);
+                        }
+                        else
+#endif
                         if (epAddr != epNum)
                         {
-                            USBD_IfClass_InData(dev->IF[ep->IfNum], ep);
+                            USBD_IfClass_InData(USBD_IfRef(dev, ep->IfNum), ep);
                         }
                         else
                         {
-                            USBD_IfClass_OutData(dev->IF[ep->IfNum], ep);
+                            USBD_IfClass_OutData(USBD_IfRef(dev, ep->IfNum), ep);
                         }
                     }
                 }
@@ -23,6 +23,20 @@
   */
 #include <private/usbd_private.h>
 
+#if (USBD_STATIC_INTERFACES == 1)
+#define USBD_IF_ENTRY(IFNUM, CLASS, ITF)    [IFNUM] = (USBD_IfHandleType*)&(ITF),
+#define USBD_IF_COUNT(IFNUM, CLASS, ITF)    + 1
+
+#if ((0 USBD_STATIC_IF_LIST(USBD_IF_COUNT)) > USBD_MAX_IF_COUNT)
+#error "USBD_STATIC_IF_LIST has more interfaces than USBD_MAX_IF_COUNT!"
+#endif
+
+/** @brief The interfaces of USBD_STATIC_IF_LIST indexed by their interface numbers */
+USBD_IfHandleType *const USBD_StaticIfs[USBD_MAX_IF_COUNT] = {
+    USBD_STATIC_IF_LIST(USBD_IF_ENTRY)
+};
+#endif /* (USBD_STATIC_INTERFACES == 1) */
+
 /** @ingroup USBD_Private
  * @defgroup USBD_Private_Functions_If USBD Interface Management
  * @{ */
@@ -43,8 +57,10 @@ void USBD_IfConfig(USBD_HandleType *dev, uint8_t cfgNum)
         {
             for (ifNum = 0; ifNum < dev->IfCount; ifNum++)
             {
-                USBD_IfClass_Deinit(dev->IF[ifNum]);
-                dev->IF[ifNum]->AltSelector = 0;
+                USBD_IfHandleType *itf = USBD_IfRef(dev, ifNum);
+
+                USBD_IfClass_Deinit(itf);
+                itf->AltSelector = 0;
             }
         }
 
@@ -56,7 +72,7 @@ void USBD_IfConfig(USBD_HandleType *dev, uint8_t cfgNum)
         {
             for (ifNum = 0; ifNum < dev->IfCount; ifNum++)
             {
-                USBD_IfClass_Init(dev->IF[ifNum]);
+                USBD_IfClass_Init(USBD_IfRef(dev, ifNum));
             }
         }
     }
@@ -77,7 +93,7 @@ const char* USBD_IfString(USBD_HandleType *dev)
 {
     uint8_t ifNum  = ((uint8_t)dev->Setup.Value & 0xF) - USBD_ISTR_INTERFACES;
     uint8_t intNum = ((uint8_t)dev->Setup.Value >> 4);
-    USBD_IfHandleType *itf = dev->IF[ifNum];
+    USBD_IfHandleType *itf = USBD_IfRef(dev, ifNum);
     const char* str = NULL;
 
     if (ifNum < dev->IfCount)
@@ -102,7 +118,7 @@ USBD_ReturnType USBD_IfRequest(USBD_HandleType *dev)
 {
     USBD_ReturnType retval = USBD_E_INVALID;
     uint8_t ifNum = (uint8_t)dev->Setup.Index;
-    USBD_IfHandleType *itf = dev->IF[ifNum];
+    USBD_IfHandleType *itf = USBD_IfRef(dev, ifNum);
 
     if ((dev->ConfigSelector == 0) || (ifNum >= dev->IfCount))
     {
@@ -0,0 +1,145 @@
+/**
+  ******************************************************************************
+  * @file    usbd_mailbox.c
+  * @author  Benedek Kupper
+  * @version 0.1
+  * @date    2019-01-29
+  * @brief   Universal Serial Bus Device Driver
+  *          Inter-core message passing
+  *
+  * Copyright (c) 2019 Benedek Kupper
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+#include <usbd_mailbox.h>
+
+/** @ingroup USBD_Mailbox
+ * @defgroup USBD_Mailbox_Private_Functions Mailbox Private Functions
+ * @{ */
+
+/* The indexes are exchanged between the cores with acquire / release semantics,
+ * so the message slots are visible before the index is */
+#define MBX_LOAD(INDEX)             __atomic_load_n(&(INDEX), __ATOMIC_ACQUIRE)
+#define MBX_STORE(INDEX, VALUE)     __atomic_store_n(&(INDEX), (VALUE), __ATOMIC_RELEASE)
+
+/**
+ * @brief Returns the index of the following mailbox slot.
+ * @param index: the current slot index
+ * @return The next slot index
+ */
+static inline uint16_t mbx_next(uint16_t index)
+{
+    return (index + 1 < USBD_MAILBOX_SIZE) ? index + 1 : 0;
+}
+
+/** @} */
+
+/** @defgroup USBD_Mailbox_Exported_Functions Mailbox Exported Functions
+ * @{ */
+
+/**
+ * @brief Empties the mailbox, before either core uses it.
+ * @param mbx: mailbox reference
+ */
+void USBD_MBX_Init(USBD_MailboxType *mbx)
+{
+    mbx->Head = 0;
+    mbx->Tail = 0;
+}
+
+/**
+ * @brief Posts a message to the mailbox, which is executed by the receiving core.
+ *        It shall only be called from the single sender core.
+ * @param mbx: mailbox reference
+ * @param handler: the message handler
+ * @param context: reference passed to the handler
+ * @param data: the buffer, whose ownership is passed to the receiver
+ * @param length: the length of the data
+ * @return BUSY if the mailbox is full, OK if successful
+ */
+USBD_ReturnType USBD_MBX_Post(USBD_MailboxType *mbx,
+        USBD_MessageCbkType handler, void *context,
+        void *data, USBD_LengthType length)
+{
+    USBD_ReturnType retval = USBD_E_BUSY;
+    uint16_t head = mbx->Head;
+    uint16_t next = mbx_next(head);
+
+    if (next != MBX_LOAD(mbx->Tail))
+    {
+        USBD_MessageType *msg = &mbx->Queue[head];
+
+        msg->Handler = handler;
+        msg->Context = context;
+        msg->Data    = data;
+        msg->Length  = length;
+        MBX_STORE(mbx->Head, next);
+
+        USBD_MailboxCallback(mbx);
+        retval = USBD_E_OK;
+    }
+
+    return retval;
+}
+
+/**
+ * @brief Executes the handlers of the posted messages.
+ *        It shall only be called from the single receiver core.
+ * @param mbx: mailbox reference
+ * @return The number of executed messages
+ */
+uint16_t USBD_MBX_Dispatch(USBD_MailboxType *mbx)
+{
+    uint16_t count = 0;
+    uint16_t tail = mbx->Tail;
+
+    while (tail != MBX_LOAD(mbx->Head))
+    {
+        USBD_MessageType msg = mbx->Queue[tail];
+
+        /* The slot is released before the handler is executed,
+         * since the handler might post a reply in a full loop */
+        tail = mbx_next(tail);
+        MBX_STORE(mbx->Tail, tail);
+
+        msg.Handler(msg.Context, msg.Data, msg.Length);
+        count++;
+    }
+    return count;
+}
+
+/**
+ * @brief Counts the messages waiting for dispatch.
+ * @param mbx: mailbox reference
+ * @return The number of pending messages
+ */
+uint16_t USBD_MBX_Pending(USBD_MailboxType *mbx)
+{
+    uint16_t head = MBX_LOAD(mbx->Head);
+    uint16_t tail = MBX_LOAD(mbx->Tail);
+
+    return (head >= tail) ? head - tail : head + USBD_MAILBOX_SIZE - tail;
+}
+
+/**
+ * @brief This function is called when a new message is posted to the mailbox.
+ *        It is called from the sender core's context,
+ *        the application can use it to signal the receiver core.
+ * @param mbx: mailbox reference
+ */
+__weak void USBD_MailboxCallback(USBD_MailboxType *mbx)
+{
+    (void)mbx;
+}
+
+/** @} */
@@ -31,6 +31,72 @@
 
 #if (USBD_MS_OS_DESC_VERSION == 1)
 
+#if (USBD_CTRL_STREAMING == 1)
+/**
+ * @brief This function generates a part of the USB Microsoft OS 1.0 compatible ID descriptor
+ *        using the compatible IDs of the mounted interfaces.
+ * @param dev: USB Device handle reference
+ * @param offset: offset of the requested part within the descriptor
+ * @param data: the target container for the requested part, NULL if only the length is queried
+ * @param len: length of the requested part
+ * @return The length of the entire descriptor
+ */
+static uint16_t USBD_MsOsCompatIdDescStream(USBD_HandleType *dev, uint16_t offset,
+        uint8_t *data, uint16_t len)
+{
+    USBD_DescWindowType win = {
+        .Data     = data,
+        .Offset   = offset,
+        .Length   = len,
+        .Position = sizeof(USB_MsCompatIdDescType),
+    };
+    uint8_t desc[sizeof(USB_MsCompatIdDescType) +
+                 sizeof(((USB_MsCompatIdDescType*)NULL)->Function[0])];
+    USB_MsCompatIdDescType *devCompatId = (void*)desc;
+    USBD_IfHandleType *itf = NULL;
+    uint8_t ifNum;
+
+    memset(desc, 0, sizeof(desc));
+
+    /* Get the individual functions */
+    for (ifNum = 0; ifNum < dev->IfCount; ifNum++)
+    {
+        const char *compatIdStr;
+
+        /* Associated interfaces form a single function */
+        if (USBD_IfRef(dev, ifNum) == itf) { continue; }
+
+        itf = USBD_IfRef(dev, ifNum);
+        compatIdStr = USBD_IfClass_GetMsCompatibleId(itf);
+
+        /* all functions get a descriptor, at least empty ones */
+        memset(&devCompatId->Function[0], 0, sizeof(devCompatId->Function[0]));
+
+        devCompatId->Function[0].bFirstInterfaceNumber = ifNum;
+
+        if (compatIdStr != NULL)
+        {
+            strncpy(devCompatId->Function[0].CompatibleID,
+                    compatIdStr, sizeof(devCompatId->Function[0].CompatibleID));
+        }
+        USBD_DescWindowPut(&win, &devCompatId->Function[0], sizeof(devCompatId->Function[0]));
+
+        /* Note the number of functions */
+        devCompatId->bCount++;
+    }
+
+    /* When finished with the contents, emit the header with the total size of the set */
+    devCompatId->dwLength   = win.Position;
+    devCompatId->bcdVersion = USBD_MS_OS_DESC_VERSION << 8;
+    devCompatId->wIndex     = USB_MS_OS_1p0_EXTENDED_COMPAT_ID_INDEX;
+
+    win.Position = 0;
+    USBD_DescWindowPut(&win, devCompatId, sizeof(USB_MsCompatIdDescType));
+
+    return devCompatId->dwLength;
+}
+
+#else
 /**
  * @brief This function assembles the USB Microsoft OS 1.0 compatible ID descriptor
  *        using the compatible IDs of the mounted interfaces.
@@ -56,9 +122,9 @@ static uint16_t USBD_MsOsCompatIdDesc(USBD_HandleType *dev, uint8_t *data)
         const char *compatIdStr;
 
         /* Associated interfaces form a single function */
-        if (dev->IF[ifNum] == itf) { continue; }
+        if (USBD_IfRef(dev, ifNum) == itf) { continue; }
 
-        itf = dev->IF[ifNum];
+        itf = USBD_IfRef(dev, ifNum);
         compatIdStr = USBD_IfClass_GetMsCompatibleId(itf);
 
         /* all functions get a descriptor, at least empty ones */
@@ -81,6 +147,7 @@ static uint16_t USBD_MsOsCompatIdDesc(USBD_HandleType *dev, uint8_t *data)
 
     return devCompatId->dwLength;
 }
+#endif /* (USBD_CTRL_STREAMING == 1) */
 
 /**
  * @brief This function collects and transfers the requested Microsoft descriptor through EP0.
@@ -90,7 +157,9 @@ static uint16_t USBD_MsOsCompatIdDesc(USBD_HandleType *dev, uint8_t *data)
 USBD_ReturnType USBD_GetMsDescriptor(USBD_HandleType *dev)
 {
     USBD_ReturnType retval = USBD_E_INVALID;
+#if (USBD_CTRL_STREAMING != 1)
     uint8_t *data = dev->CtrlData;
+#endif
     uint16_t len = 0;
     //uint8_t ifNum = (uint8_t)dev->Setup.Value >> 8;
     //uint8_t pageNum = (uint8_t)dev->Setup.Value;
@@ -100,7 +169,11 @@ USBD_ReturnType USBD_GetMsDescriptor(USBD_HandleType *dev)
         case USB_MS_OS_1p0_EXTENDED_COMPAT_ID_INDEX:
         {
             /* Only one descriptor per device */
+#if (USBD_CTRL_STREAMING == 1)
+            len = USBD_MsOsCompatIdDescStream(dev, 0, NULL, 0);
+#else
             len = USBD_MsOsCompatIdDesc(dev, data);
+#endif
             break;
         }
 
@@ -113,7 +186,11 @@ USBD_ReturnType USBD_GetMsDescriptor(USBD_HandleType *dev)
     /* Transfer the non-null descriptor */
     if (len > 0)
     {
+#if (USBD_CTRL_STREAMING == 1)
+        retval = USBD_CtrlSendStream(dev, USBD_MsOsCompatIdDescStream, len);
+#else
         retval = USBD_CtrlSendData(dev, data, len);
+#endif
     }
 
     return retval;
@@ -121,6 +198,98 @@ USBD_ReturnType USBD_GetMsDescriptor(USBD_HandleType *dev)
 
 #elif (USBD_MS_OS_DESC_VERSION == 2)
 
+#if (USBD_CTRL_STREAMING == 1)
+/**
+ * @brief This function generates a part of the USB Microsoft OS 2.0 descriptor
+ *        using the compatible IDs of the mounted interfaces.
+ * @param dev: USB Device handle reference
+ * @param offset: offset of the requested part within the descriptor
+ * @param data: the target container for the requested part, NULL if only the length is queried
+ * @param len: length of the requested part
+ * @return The length of the entire descriptor, 0 if there are no features to describe
+ */
+uint16_t USBD_MsOs2p0DescStream(USBD_HandleType *dev, uint16_t offset,
+        uint8_t *data, uint16_t len)
+{
+    USBD_DescWindowType win = {
+        .Data     = data,
+        .Offset   = offset,
+        .Length   = len,
+        .Position = 0,
+    };
+    USB_MsDescSetHeaderType descSet;
+    USB_MsConfSubsetHeaderType confSubset;
+    USB_MsFuncSubsetHeaderType funcSubset;
+    USB_MsCompatIdDescType compatId;
+    USBD_IfHandleType *itf = NULL;
+    uint16_t funcLength = 0;
+    uint8_t ifNum;
+
+    /* Only the functions with compatible ID get a function subset */
+    for (ifNum = 0; ifNum < dev->IfCount; ifNum++)
+    {
+        /* Associated interfaces form a single function */
+        if (USBD_IfRef(dev, ifNum) == itf) { continue; }
+
+        itf = USBD_IfRef(dev, ifNum);
+        if (USBD_IfClass_GetMsCompatibleId(itf) != NULL)
+        {
+            funcLength += sizeof(funcSubset) + sizeof(compatId);
+        }
+    }
+
+    /* If no features are added in the whole set, reject this request */
+    if (funcLength == 0)
+    {
+        return 0;
+    }
+
+    /* Device header */
+    descSet.wLength             = sizeof(USB_MsDescSetHeaderType);
+    descSet.wDescriptorType     = USB_MS_OS_2p0_SET_HEADER_DESCRIPTOR;
+    descSet.dwWindowsVersion    = USB_MS_OS_2P0_MIN_WINDOWS_VERSION;
+    descSet.wTotalLength        = sizeof(descSet) + sizeof(confSubset) + funcLength;
+    USBD_DescWindowPut(&win, &descSet, sizeof(descSet));
+
+    /* Configuration subset */
+    confSubset.wLength              = sizeof(USB_MsConfSubsetHeaderType);
+    confSubset.wDescriptorType      = USB_MS_OS_2p0_SUBSET_HEADER_CONFIGURATION;
+    confSubset.bConfigurationValue  = 0; /* ~ USBD_ConfigDesc.bConfigurationValue - 1 */
+    confSubset.bReserved            = 0;
+    confSubset.wTotalLength         = sizeof(confSubset) + funcLength;
+    USBD_DescWindowPut(&win, &confSubset, sizeof(confSubset));
+
+    /* Function subsets */
+    for (ifNum = 0, itf = NULL; ifNum < dev->IfCount; ifNum++)
+    {
+        const char *compatIdStr;
+
+        /* Associated interfaces form a single function */
+        if (USBD_IfRef(dev, ifNum) == itf) { continue; }
+
+        itf = USBD_IfRef(dev, ifNum);
+        compatIdStr = USBD_IfClass_GetMsCompatibleId(itf);
+        if (compatIdStr == NULL) { continue; }
+
+        funcSubset.wLength          = sizeof(USB_MsFuncSubsetHeaderType);
+        funcSubset.wDescriptorType  = USB_MS_OS_2p0_SUBSET_HEADER_FUNCTION;
+        funcSubset.bFirstInterface  = ifNum;
+        funcSubset.bReserved        = 0;
+        funcSubset.wSubsetLength    = sizeof(funcSubset) + sizeof(compatId);
+        USBD_DescWindowPut(&win, &funcSubset, sizeof(funcSubset));
+
+        /* Function-level features */
+        compatId.wLength            = sizeof(USB_MsCompatIdDescType);
+        compatId.wDescriptorType    = USB_MS_OS_2p0_FEATURE_COMPATBLE_ID;
+        memset (compatId.CompatibleID, 0, sizeof(compatId.CompatibleID) + sizeof(compatId.SubCompatibleID));
+        strncpy(compatId.CompatibleID, compatIdStr, sizeof(compatId.CompatibleID));
+        USBD_DescWindowPut(&win, &compatId, sizeof(compatId));
+    }
+
+    return win.Position;
+}
+
+#else
 /**
  * @brief This function assembles the USB Microsoft OS 2.0 descriptor
  *        using the compatible IDs of the mounted interfaces.
@@ -172,9 +341,9 @@ uint16_t USBD_MsOs2p0Desc(USBD_HandleType *dev, uint8_t *data)
                     const char *compatIdStr;
 
                     /* Associated interfaces form a single function */
-                    if (dev->IF[ifNum] == itf) { continue; }
+                    if (USBD_IfRef(dev, ifNum) == itf) { continue; }
 
-                    itf = dev->IF[ifNum];
+                    itf = USBD_IfRef(dev, ifNum);
 
                     /* If the compatible ID is defined, add the feature under the function header */
                     funcSubset = (void*)data;
@@ -250,6 +419,7 @@ uint16_t USBD_MsOs2p0Desc(USBD_HandleType *dev, uint8_t *data)
 
     return descSet->wTotalLength;
 }
+#endif /* (USBD_CTRL_STREAMING == 1) */
 
 /**
  * @brief This function collects and transfers the requested Microsoft descriptor through EP0.
@@ -259,17 +429,27 @@ uint16_t USBD_MsOs2p0Desc(USBD_HandleType *dev, uint8_t *data)
 USBD_ReturnType USBD_GetMsDescriptor(USBD_HandleType *dev)
 {
     USBD_ReturnType retval = USBD_E_INVALID;
+#if (USBD_CTRL_STREAMING != 1)
     uint8_t *data = dev->CtrlData;
+#endif
     uint16_t len;
 
     if (dev->Setup.Index == USB_MS_OS_2p0_GET_DESCRIPTOR_INDEX)
     {
+#if (USBD_CTRL_STREAMING == 1)
+        len = USBD_MsOs2p0DescStream(dev, 0, NULL, 0);
+#else
         len = USBD_MsOs2p0Desc(dev, data);
+#endif
 
         /* Transfer the non-null descriptor */
         if (len > 0)
         {
+#if (USBD_CTRL_STREAMING == 1)
+            retval = USBD_CtrlSendStream(dev, USBD_MsOs2p0DescStream, len);
+#else
             retval = USBD_CtrlSendData(dev, data, len);
+#endif
         }
     }
 
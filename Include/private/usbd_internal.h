@@ -35,6 +35,17 @@ extern "C"
 /* strlen(), memcpy() */
 #include <string.h>
 
+#if (USBD_EP_STATS == 1)
+/**
+ * @brief  Increments an endpoint statistics counter.
+ * @param  EP: USB endpoint handle reference
+ * @param  FIELD: the counter field of @ref USBD_EpStatsType
+ */
+#define USBD_EP_STATS_INC(EP, FIELD)    ((EP)->Stats.FIELD++)
+#else
+#define USBD_EP_STATS_INC(EP, FIELD)    ((void)0)
+#endif /* (USBD_EP_STATS == 1) */
+
 /** @ingroup USBD
  * @addtogroup USBD_Internal_Functions
  * @{ */
@@ -43,6 +54,12 @@ USBD_ReturnType USBD_CtrlSendData       (USBD_HandleType *dev,
                                          void *data,
                                          uint16_t len);
 
+#if (USBD_CTRL_STREAMING == 1)
+USBD_ReturnType USBD_CtrlSendStream     (USBD_HandleType *dev,
+                                         USBD_CtrlStreamCbkType generate,
+                                         uint16_t len);
+#endif /* (USBD_CTRL_STREAMING == 1) */
+
 USBD_ReturnType USBD_CtrlReceiveData    (USBD_HandleType *dev,
                                          void *data, uint16_t len);
 
@@ -55,12 +72,47 @@ uint8_t         USBD_EpHsInterval       (uint32_t interval_ms);
 USBD_ReturnType USBD_EpSend             (USBD_HandleType *dev,
                                          uint8_t epAddr,
                                          void *data,
-                                         uint16_t len);
+                                         USBD_LengthType len);
 
 USBD_ReturnType USBD_EpReceive          (USBD_HandleType *dev,
                                          uint8_t epAddr,
                                          void *data,
-                                         uint16_t len);
+                                         USBD_LengthType len);
+
+USBD_ReturnType USBD_EpSendv            (USBD_HandleType *dev,
+                                         uint8_t epAddr,
+                                         const USBD_EpSegmentType *segs,
+                                         uint8_t count);
+
+USBD_ReturnType USBD_EpReceivev         (USBD_HandleType *dev,
+                                         uint8_t epAddr,
+                                         const USBD_EpSegmentType *segs,
+                                         uint8_t count);
+
+#if (USBD_EP_QUEUE_SUPPORT == 1)
+USBD_ReturnType USBD_EpSubmit           (USBD_HandleType *dev,
+                                         uint8_t epAddr,
+                                         USBD_EpRequestType *req);
+
+USBD_ReturnType USBD_EpCancel           (USBD_HandleType *dev,
+                                         uint8_t epAddr,
+                                         USBD_EpRequestType *req);
+
+void            USBD_EpQueueFlush       (USBD_HandleType *dev,
+                                         uint8_t epAddr);
+
+void            USBD_EpQueueResume      (USBD_HandleType *dev,
+                                         uint8_t epAddr);
+#endif /* (USBD_EP_QUEUE_SUPPORT == 1) */
+
+#if (USBD_EP_SCHEDULER == 1)
+void            USBD_EpSchedCancel      (USBD_HandleType *dev,
+                                         uint8_t epAddr);
+#endif /* (USBD_EP_SCHEDULER == 1) */
+
+#if (USBD_STATIC_INTERFACES == 1)
+extern USBD_IfHandleType *const USBD_StaticIfs[USBD_MAX_IF_COUNT];
+#endif /* (USBD_STATIC_INTERFACES == 1) */
 
 /**
  * @brief Converts the USBD endpoint address to its reference.
@@ -84,13 +136,123 @@ USBD_EpHandleType* USBD_EpAddr2Ref      (USBD_HandleType *dev,
 static inline uint8_t USBD_EpRef2Addr   (USBD_HandleType *dev,
                                          USBD_EpHandleType *ep)
 {
-    uint8_t epAddr = (((uint32_t)ep - (uint32_t)&dev->EP.IN[0])
-            / sizeof(USBD_EpHandleType));
+    uint8_t epAddr = (uint8_t)(ep - &dev->EP.IN[0]);
     return (epAddr < USBD_MAX_EP_COUNT) ?
             (0x80 | epAddr) :                   /* IN endpoint */
             (epAddr - USBD_MAX_EP_COUNT); /* OUT endpoint */
 }
 
+#if (USBD_TRACE_SIZE > 0)
+/**
+ * @brief Records an event in the device trace ring.
+ * @param dev: USB Device handle reference
+ * @param event: the event type
+ * @param param: endpoint address or event specific parameter
+ * @param data: the transferred data to capture (optional)
+ * @param len: length of the transfer
+ */
+static inline void USBD_TraceEvent      (USBD_HandleType *dev,
+                                         USBD_TraceEventType event,
+                                         uint8_t param,
+                                         const void *data,
+                                         USBD_LengthType len)
+{
+    USBD_TraceEntryType *entry = &dev->Trace.Entries[dev->Trace.Count++ % USBD_TRACE_SIZE];
+
+    entry->Timestamp = USBD_TRACE_TIMESTAMP();
+    entry->Event     = event;
+    entry->Param     = param;
+    entry->Length    = (len < 0xFFFF) ? len : 0xFFFF;
+    if (data != NULL)
+    {
+        entry->Event |= USBD_TRACE_CAPTURED;
+        memcpy(entry->Data, data,
+                (len < USBD_TRACE_DATA_SIZE) ? len : USBD_TRACE_DATA_SIZE);
+    }
+}
+
+/**
+ * @brief Records an endpoint transfer event. The data of control transfers
+ *        is captured entirely in continuation entries, so the descriptors
+ *        and class requests can be decoded from the trace.
+ * @param dev: USB Device handle reference
+ * @param event: the event type
+ * @param epAddr: endpoint address
+ * @param data: the transferred data to capture (optional)
+ * @param len: length of the transfer
+ */
+static inline void USBD_TraceTransfer   (USBD_HandleType *dev,
+                                         USBD_TraceEventType event,
+                                         uint8_t epAddr,
+                                         const uint8_t *data,
+                                         USBD_LengthType len)
+{
+    USBD_TraceEvent(dev, event, epAddr, data, len);
+
+    if (((epAddr & 0x7F) == 0) && (data != NULL))
+    {
+        uint16_t offset;
+
+        for (offset = USBD_TRACE_DATA_SIZE; offset < len; offset += USBD_TRACE_DATA_SIZE)
+        {
+            USBD_TraceEvent(dev, USBD_TRACE_DATA, epAddr, &data[offset], len - offset);
+        }
+    }
+}
+#else
+#define USBD_TraceEvent(DEV, EVENT, PARAM, DATA, LEN)   ((void)0)
+#define USBD_TraceTransfer(DEV, EVENT, EPADDR, DATA, LEN) ((void)0)
+#endif /* (USBD_TRACE_SIZE > 0) */
+
+#if (USBD_TRACE_SIZE > 0) || (USBD_EVENT_RECORDING == 1)
+
+/**
+ * @brief Records the start of an endpoint transfer.
+ *        The OUT data is captured from the receive buffer at the transfer's completion.
+ * @param dev: USB Device handle reference
+ * @param epAddr: endpoint address
+ * @param data: the transfer buffer
+ * @param len: length of the transfer
+ */
+static inline void USBD_TraceSubmit     (USBD_HandleType *dev,
+                                         uint8_t epAddr,
+                                         const void *data,
+                                         USBD_LengthType len)
+{
+    if (epAddr > 0x7F)
+    {
+        USBD_TraceTransfer(dev, USBD_TRACE_SUBMIT, epAddr, data, len);
+    }
+    else
+    {
+        dev->EP.OUT[epAddr].RxBuffer = data;
+        USBD_TraceEvent(dev, USBD_TRACE_SUBMIT, epAddr, NULL, len);
+    }
+    (void)len;
+}
+#else
+#define USBD_TraceSubmit(DEV, EPADDR, DATA, LEN)        ((void)0)
+#endif
+
+#if (USBD_TRACE_SIZE > 0)
+
+/**
+ * @brief Records the completion of an endpoint transfer.
+ * @param dev: USB Device handle reference
+ * @param ep: USB endpoint handle reference
+ */
+static inline void USBD_TraceComplete   (USBD_HandleType *dev,
+                                         USBD_EpHandleType *ep)
+{
+    uint8_t epAddr = USBD_EpRef2Addr(dev, ep);
+
+    USBD_TraceTransfer(dev, USBD_TRACE_COMPLETE, epAddr,
+            (epAddr > 0x7F) ? NULL : ep->RxBuffer, ep->Transfer.Length);
+}
+#else
+#define USBD_TraceComplete(DEV, EP)                     ((void)0)
+#endif /* (USBD_TRACE_SIZE > 0) */
+
 /**
  * @brief Opens the device endpoint.
  * @param dev: USB Device handle reference
@@ -103,32 +265,94 @@ static inline void USBD_EpOpen          (USBD_HandleType *dev,
                                          USB_EndPointType type,
                                          uint16_t mps)
 {
+    USBD_EpHandleType *ep = USBD_EpAddr2Ref(dev, epAddr);
+
     USBD_PD_EpOpen(dev, epAddr, type, mps);
-    USBD_EpAddr2Ref(dev, epAddr)->State = USB_EP_STATE_IDLE;
+    ep->State = USB_EP_STATE_IDLE;
+    USBD_TraceEvent(dev, USBD_TRACE_EP_OPEN, epAddr, NULL, type);
+#if (USBD_EP_QUEUE_SUPPORT == 1)
+    /* The queue of a closed endpoint is empty,
+     * the requests of a reopened one are completed */
+    USBD_EpQueueFlush(dev, epAddr);
+#endif
 }
 
 /**
  * @brief Closes the device endpoint.
  * @param dev: USB Device handle reference
  * @param epAddr: endpoint address
+ * @note  The queued transfer requests are completed without transferred data.
  */
 static inline void USBD_EpClose         (USBD_HandleType *dev,
                                          uint8_t epAddr)
 {
+    USBD_EpHandleType *ep = USBD_EpAddr2Ref(dev, epAddr);
+
     USBD_PD_EpClose(dev, epAddr);
-    USBD_EpAddr2Ref(dev, epAddr)->State = USB_EP_STATE_CLOSED;
+    ep->State = USB_EP_STATE_CLOSED;
+#if (USBD_EP_SCHEDULER == 1)
+    USBD_EpSchedCancel(dev, epAddr);
+#endif
+#if (USBD_EP_HANDLERS == 1)
+    ep->Handler.Complete = NULL;
+#endif
+#if (USBD_EP_SG_SUPPORT != 1) && (USBD_EP_SG_BUFFER_SIZE > 0)
+    if (dev->SgBuffer.EpAddr == epAddr)
+    {
+        dev->SgBuffer.EpAddr = 0;
+    }
+#endif
+#if (USBD_EP_QUEUE_SUPPORT == 1)
+    USBD_EpQueueFlush(dev, epAddr);
+#endif
 }
 
+#if (USBD_EP_HANDLERS == 1)
+/**
+ * @brief Binds a completion handler to the non-control endpoint,
+ *        which is then called instead of the interface class's
+ *        @ref USBD_ClassType::InData or @ref USBD_ClassType::OutData function.
+ *        The binding is released when the endpoint is closed.
+ * @param dev: USB Device handle reference
+ * @param epAddr: endpoint address
+ * @param handler: the completion handler, NULL restores the class dispatch
+ * @param context: reference passed to the handler
+ */
+static inline void USBD_EpSetHandler    (USBD_HandleType *dev,
+                                         uint8_t epAddr,
+                                         USBD_EpCbkType handler,
+                                         void *context)
+{
+    USBD_EpHandleType *ep = USBD_EpAddr2Ref(dev, epAddr);
+
+    ep->Handler.Context  = context;
+    ep->Handler.Complete = handler;
+}
+#endif /* (USBD_EP_HANDLERS == 1) */
+
 /**
  * @brief Flushes the buffered data from the endpoint.
  * @param dev: USB Device handle reference
  * @param epAddr: endpoint address
+ * @note  The queued transfer requests are completed without transferred data.
  */
 static inline void USBD_EpFlush         (USBD_HandleType *dev,
                                          uint8_t epAddr)
 {
     USBD_PD_EpFlush(dev, epAddr);
     USBD_EpAddr2Ref(dev, epAddr)->State = USB_EP_STATE_IDLE;
+#if (USBD_EP_SCHEDULER == 1)
+    USBD_EpSchedCancel(dev, epAddr);
+#endif
+#if (USBD_EP_SG_SUPPORT != 1) && (USBD_EP_SG_BUFFER_SIZE > 0)
+    if (dev->SgBuffer.EpAddr == epAddr)
+    {
+        dev->SgBuffer.EpAddr = 0;
+    }
+#endif
+#if (USBD_EP_QUEUE_SUPPORT == 1)
+    USBD_EpQueueFlush(dev, epAddr);
+#endif
 }
 
 /**
@@ -139,20 +363,127 @@ static inline void USBD_EpFlush         (USBD_HandleType *dev,
 static inline void USBD_EpSetStall      (USBD_HandleType *dev,
                                          uint8_t epAddr)
 {
+    USBD_EpHandleType *ep = USBD_EpAddr2Ref(dev, epAddr);
+
     USBD_PD_EpSetStall(dev, epAddr);
-    USBD_EpAddr2Ref(dev, epAddr)->State = USB_EP_STATE_STALL;
+    ep->State = USB_EP_STATE_STALL;
+#if (USBD_EP_SCHEDULER == 1)
+    USBD_EpSchedCancel(dev, epAddr);
+#endif
+    USBD_EP_STATS_INC(ep, Stalls);
+    USBD_TraceEvent(dev, USBD_TRACE_STALL, epAddr, NULL, 0);
 }
 
 /**
  * @brief Clears the stall (NAK) status on the endpoint.
  * @param dev: USB Device handle reference
  * @param epAddr: endpoint address
+ * @note  The interrupted queued transfer request is restarted.
  */
 static inline void USBD_EpClearStall    (USBD_HandleType *dev,
                                          uint8_t epAddr)
 {
     USBD_PD_EpClearStall(dev, epAddr);
     USBD_EpAddr2Ref(dev, epAddr)->State = USB_EP_STATE_IDLE;
+#if (USBD_EP_QUEUE_SUPPORT == 1)
+    USBD_EpQueueResume(dev, epAddr);
+#endif
+}
+
+/**
+ * @brief Discards the cached configuration and string descriptors,
+ *        to be called when the device's interfaces change.
+ * @param dev: USB Device handle reference
+ */
+static inline void USBD_DescInvalidate  (USBD_HandleType *dev)
+{
+#if (USBD_CONFIG_DESC_CACHE_SIZE > 0)
+    memset(dev->ConfigDesc.Length, 0, sizeof(dev->ConfigDesc.Length));
+#endif
+#if (USBD_STRING_TABLE_SIZE > 0)
+    dev->Strings.Length = 0;
+#endif
+    (void)dev;
+}
+
+/**
+ * @brief Converts the interface number to the interface reference.
+ * @param dev: USB Device handle reference
+ * @param ifNum: the interface index in the device
+ * @return The interface's reference
+ */
+static inline USBD_IfHandleType* USBD_IfRef (USBD_HandleType *dev,
+                                         uint8_t ifNum)
+{
+#if (USBD_STATIC_INTERFACES == 1)
+    (void)dev;
+    return (ifNum < USBD_MAX_IF_COUNT) ? USBD_StaticIfs[ifNum] : NULL;
+#else
+    return dev->IF[ifNum];
+#endif
+}
+
+/**
+ * @brief Checks if the interface can be mounted at the next interface numbers of the device.
+ *        With USBD_STATIC_INTERFACES the interface has to be mounted
+ *        at the same position as it is listed in USBD_STATIC_IF_LIST.
+ * @param dev: USB Device handle reference
+ * @param itf: reference of the interface
+ * @param count: the number of interface numbers used by the interface
+ * @param descLength: the maximal length of the interface's descriptors
+ * @return OK if the interface can be mounted,
+ *         ERROR if the device interface slots are insufficient,
+ *         or with USBD_CTRL_STREAMING if the descriptors don't fit USBD_MAX_IF_DESC_SIZE,
+ *         INVALID if the interface isn't listed at these positions
+ */
+static inline USBD_ReturnType USBD_IfMountCheck(USBD_HandleType *dev,
+                                         USBD_IfHandleType *itf,
+                                         uint8_t count,
+                                         uint16_t descLength)
+{
+    if ((dev->IfCount + count) > USBD_MAX_IF_COUNT)
+    {
+        return USBD_E_ERROR;
+    }
+#if (USBD_CTRL_STREAMING == 1)
+    /* The streamed configuration descriptor is assembled
+     * one interface at a time in a buffer of this size */
+    if (descLength > USBD_MAX_IF_DESC_SIZE)
+    {
+        return USBD_E_ERROR;
+    }
+#else
+    (void)descLength;
+#endif
+#if (USBD_STATIC_INTERFACES == 1)
+    while (count-- > 0)
+    {
+        if (USBD_StaticIfs[dev->IfCount + count] != itf)
+        {
+            return USBD_E_INVALID;
+        }
+    }
+#else
+    (void)itf;
+#endif
+    return USBD_E_OK;
+}
+
+/**
+ * @brief Assigns the next interface number of the device to the interface.
+ *        The mounting shall be checked first by @ref USBD_IfMountCheck.
+ * @param dev: USB Device handle reference
+ * @param itf: reference of the interface
+ */
+static inline void USBD_IfAttach        (USBD_HandleType *dev,
+                                         USBD_IfHandleType *itf)
+{
+#if (USBD_STATIC_INTERFACES == 1)
+    (void)itf;
+#else
+    dev->IF[dev->IfCount] = itf;
+#endif
+    dev->IfCount++;
 }
 
 /** @} */
@@ -33,6 +33,34 @@ extern "C"
 
 /* {function definition} <- {call site} */
 
+#if (USBD_DEFERRED_EVENTS == 1)
+/* usbd, usbd_ctrl, usbd_ep <- USBD_Process */
+void            USBD_ResetHandler       (USBD_HandleType *dev,
+                                         USB_SpeedType speed);
+void            USBD_SetupHandler       (USBD_HandleType *dev);
+void            USBD_EpInHandler        (USBD_HandleType *dev,
+                                         USBD_EpHandleType *ep);
+void            USBD_EpOutHandler       (USBD_HandleType *dev,
+                                         USBD_EpHandleType *ep);
+#else
+/* The Peripheral Driver callbacks are the event handlers themselves */
+#define USBD_ResetHandler               USBD_ResetCallback
+#define USBD_SetupHandler               USBD_SetupCallback
+#define USBD_EpInHandler                USBD_EpInCallback
+#define USBD_EpOutHandler               USBD_EpOutCallback
+#endif /* (USBD_DEFERRED_EVENTS == 1) */
+
+#if (USBD_EVENT_RECORDING == 1)
+/* usbd <- usbd_ctrl, usbd_ep */
+void            USBD_RecordEvent        (USBD_HandleType *dev,
+                                         USBD_EventIdType id,
+                                         uint8_t param,
+                                         const uint8_t *data,
+                                         USBD_LengthType len);
+#else
+#define USBD_RecordEvent(DEV, ID, PARAM, DATA, LEN)     ((void)0)
+#endif /* (USBD_EVENT_RECORDING == 1) */
+
 /* usbd <- usbd_ctrl */
 USBD_ReturnType USBD_DevRequest         (USBD_HandleType *dev);
 
@@ -56,16 +84,49 @@ USBD_ReturnType USBD_EpRequest          (USBD_HandleType *dev);
 /* usbd_desc <- usbd */
 USBD_ReturnType USBD_GetDescriptor      (USBD_HandleType *dev);
 
+#if (USBD_CTRL_STREAMING == 1)
+/** @brief Descriptor window, the part of a descriptor which is being generated */
+typedef struct
+{
+    uint8_t *Data;      /*!< Target container of the window, NULL if only the length is measured */
+    uint16_t Offset;    /*!< Start of the window within the descriptor */
+    uint16_t Length;    /*!< Length of the window */
+    uint16_t Position;  /*!< Length of the descriptor elements emitted so far */
+}USBD_DescWindowType;
+
+/* usbd_desc <- usbd_microsoft_os */
+void            USBD_DescWindowPut      (USBD_DescWindowType *win,
+                                         const void *src,
+                                         uint16_t len);
+#endif /* (USBD_CTRL_STREAMING == 1) */
+
 #if (USBD_MS_OS_DESC_VERSION > 0)
 USBD_ReturnType USBD_GetMsDescriptor    (USBD_HandleType *dev);
 
 #if (USBD_MS_OS_DESC_VERSION == 2)
+#if (USBD_CTRL_STREAMING == 1)
+uint16_t        USBD_MsOs2p0DescStream  (USBD_HandleType *dev,
+                                         uint16_t offset,
+                                         uint8_t *data,
+                                         uint16_t len);
+#else
 uint16_t        USBD_MsOs2p0Desc        (USBD_HandleType *dev,
                                          uint8_t *data);
+#endif /* (USBD_CTRL_STREAMING == 1) */
 #endif /* (USBD_MS_OS_DESC_VERSION == 2) */
 
 #endif /* (USBD_MS_OS_DESC_VERSION > 0) */
 
+#if (USBD_STATIC_INTERFACES == 1)
+#include <usbd_interfaces.h>
+
+/* Selects the interface from USBD_STATIC_IF_LIST by comparing its reference
+ * to the listed handles, and expands USBD_IF_CALL with the matching class,
+ * so the class functions are called directly instead of through itf->Class */
+#define USBD_IF_MATCH(IFNUM, CLASS, ITF)                \
+    if (itf == (USBD_IfHandleType*)&(ITF)) { USBD_IF_CALL(CLASS) } else
+#endif /* (USBD_STATIC_INTERFACES == 1) */
+
 /** @ingroup USBD
  * @defgroup USBD_Private_Functions_IfClass USBD Class-specific Interface Callouts
  * @brief These functions simply call the class-specific function pointer
@@ -82,10 +143,19 @@ uint16_t        USBD_MsOs2p0Desc        (USBD_HandleType *dev,
 static inline uint16_t USBD_IfClass_GetDesc(
         USBD_IfHandleType *itf, uint8_t ifNum, uint8_t *dest)
 {
+#if (USBD_STATIC_INTERFACES == 1)
+    uint16_t len = 0;
+#define USBD_IF_CALL(CLASS)                             \
+    if ((CLASS).GetDescriptor != NULL) { len = (CLASS).GetDescriptor(itf, ifNum, dest); }
+    USBD_STATIC_IF_LIST(USBD_IF_MATCH) {}
+#undef USBD_IF_CALL
+    return len;
+#else
     if (itf->Class->GetDescriptor != NULL)
         { return itf->Class->GetDescriptor(itf, ifNum, dest); }
     else
         { return 0; }
+#endif
 }
 
 /**
@@ -98,10 +168,19 @@ static inline uint16_t USBD_IfClass_GetDesc(
 static inline const char* USBD_IfClass_GetString(
         USBD_IfHandleType *itf, uint8_t intNum)
 {
+#if (USBD_STATIC_INTERFACES == 1)
+    const char *str = NULL;
+#define USBD_IF_CALL(CLASS)                             \
+    if ((CLASS).GetString != NULL) { str = (CLASS).GetString(itf, intNum); }
+    USBD_STATIC_IF_LIST(USBD_IF_MATCH) {}
+#undef USBD_IF_CALL
+    return str;
+#else
     if (itf->Class->GetString == NULL)
     {   return (const char*)NULL; }
     else
     {   return itf->Class->GetString(itf, intNum); }
+#endif
 }
 
 /**
@@ -112,7 +191,13 @@ static inline const char* USBD_IfClass_GetString(
 static inline void USBD_IfClass_Init(
         USBD_IfHandleType *itf)
 {
+#if (USBD_STATIC_INTERFACES == 1)
+#define USBD_IF_CALL(CLASS)     USBD_SAFE_CALLBACK((CLASS).Init, itf);
+    USBD_STATIC_IF_LIST(USBD_IF_MATCH) {}
+#undef USBD_IF_CALL
+#else
     USBD_SAFE_CALLBACK(itf->Class->Init, itf);
+#endif
 }
 
 /**
@@ -123,7 +208,13 @@ static inline void USBD_IfClass_Init(
 static inline void USBD_IfClass_Deinit(
         USBD_IfHandleType *itf)
 {
+#if (USBD_STATIC_INTERFACES == 1)
+#define USBD_IF_CALL(CLASS)     USBD_SAFE_CALLBACK((CLASS).Deinit, itf);
+    USBD_STATIC_IF_LIST(USBD_IF_MATCH) {}
+#undef USBD_IF_CALL
+#else
     USBD_SAFE_CALLBACK(itf->Class->Deinit, itf);
+#endif
 }
 
 /**
@@ -135,10 +226,19 @@ static inline void USBD_IfClass_Deinit(
 static inline USBD_ReturnType USBD_IfClass_SetupStage(
         USBD_IfHandleType *itf)
 {
+#if (USBD_STATIC_INTERFACES == 1)
+    USBD_ReturnType retval = USBD_E_INVALID;
+#define USBD_IF_CALL(CLASS)                             \
+    if ((CLASS).SetupStage != NULL) { retval = (CLASS).SetupStage(itf); }
+    USBD_STATIC_IF_LIST(USBD_IF_MATCH) {}
+#undef USBD_IF_CALL
+    return retval;
+#else
     if (itf->Class->SetupStage == NULL)
     {   return USBD_E_INVALID; }
     else
     {   return itf->Class->SetupStage(itf); }
+#endif
 }
 
 /**
@@ -149,7 +249,13 @@ static inline USBD_ReturnType USBD_IfClass_SetupStage(
 static inline void USBD_IfClass_DataStage(
         USBD_IfHandleType *itf)
 {
+#if (USBD_STATIC_INTERFACES == 1)
+#define USBD_IF_CALL(CLASS)     USBD_SAFE_CALLBACK((CLASS).DataStage, itf);
+    USBD_STATIC_IF_LIST(USBD_IF_MATCH) {}
+#undef USBD_IF_CALL
+#else
     USBD_SAFE_CALLBACK(itf->Class->DataStage, itf);
+#endif
 }
 
 /**
@@ -161,7 +267,13 @@ static inline void USBD_IfClass_DataStage(
 static inline void USBD_IfClass_InData(
         USBD_IfHandleType *itf, USBD_EpHandleType *ep)
 {
+#if (USBD_STATIC_INTERFACES == 1)
+#define USBD_IF_CALL(CLASS)     USBD_SAFE_CALLBACK((CLASS).InData, itf, ep);
+    USBD_STATIC_IF_LIST(USBD_IF_MATCH) {}
+#undef USBD_IF_CALL
+#else
     USBD_SAFE_CALLBACK(itf->Class->InData, itf, ep);
+#endif
 }
 
 /**
@@ -173,7 +285,13 @@ static inline void USBD_IfClass_InData(
 static inline void USBD_IfClass_OutData(
         USBD_IfHandleType *itf, USBD_EpHandleType *ep)
 {
+#if (USBD_STATIC_INTERFACES == 1)
+#define USBD_IF_CALL(CLASS)     USBD_SAFE_CALLBACK((CLASS).OutData, itf, ep);
+    USBD_STATIC_IF_LIST(USBD_IF_MATCH) {}
+#undef USBD_IF_CALL
+#else
     USBD_SAFE_CALLBACK(itf->Class->OutData, itf, ep);
+#endif
 }
 
 #if (USBD_MS_OS_DESC_VERSION > 0)
@@ -186,7 +304,15 @@ static inline void USBD_IfClass_OutData(
 static inline const char* USBD_IfClass_GetMsCompatibleId(
         USBD_IfHandleType *itf)
 {
+#if (USBD_STATIC_INTERFACES == 1)
+    const char *id = NULL;
+#define USBD_IF_CALL(CLASS)     id = (CLASS).MsCompatibleId;
+    USBD_STATIC_IF_LIST(USBD_IF_MATCH) {}
+#undef USBD_IF_CALL
+    return id;
+#else
     return itf->Class->MsCompatibleId;
+#endif
 }
 #endif
 
@@ -44,6 +44,49 @@ void            USBD_Disconnect         (USBD_HandleType *dev);
 
 USBD_ReturnType USBD_SetRemoteWakeup    (USBD_HandleType *dev);
 USBD_ReturnType USBD_ClearRemoteWakeup  (USBD_HandleType *dev);
+
+#if (USBD_DEFERRED_EVENTS == 1)
+uint16_t        USBD_Process            (USBD_HandleType *dev);
+
+void            USBD_EventCallback      (USBD_HandleType *dev);
+#endif /* (USBD_DEFERRED_EVENTS == 1) */
+
+#if (USBD_EP_STATS == 1)
+USBD_ReturnType USBD_GetEpStats         (USBD_HandleType *dev,
+                                         uint8_t epAddr,
+                                         USBD_EpStatsType *stats);
+
+USBD_ReturnType USBD_ClearEpStats       (USBD_HandleType *dev,
+                                         uint8_t epAddr);
+#endif /* (USBD_EP_STATS == 1) */
+
+#if (USBD_EP_SCHEDULER == 1)
+USBD_ReturnType USBD_SetEpPriority      (USBD_HandleType *dev,
+                                         uint8_t epAddr,
+                                         USBD_EpPriorityType priority,
+                                         uint32_t deadline);
+
+USBD_ReturnType USBD_GetEpWaitStats     (USBD_HandleType *dev,
+                                         uint8_t epAddr,
+                                         USBD_EpWaitStatsType *stats);
+
+USBD_ReturnType USBD_ClearEpWaitStats   (USBD_HandleType *dev,
+                                         uint8_t epAddr);
+#endif /* (USBD_EP_SCHEDULER == 1) */
+
+#if (USBD_EVENT_RECORDING == 1)
+void            USBD_RecordCallback     (USBD_HandleType *dev,
+                                         const USBD_RecordType *rec,
+                                         const uint8_t *data);
+#endif /* (USBD_EVENT_RECORDING == 1) */
+
+#if (USBD_TRACE_SIZE > 0)
+void            USBD_TraceLinkState     (USBD_HandleType *dev);
+
+#define USBD_TRACE_LINK_STATE(DEV)      USBD_TraceLinkState(DEV)
+#else
+#define USBD_TRACE_LINK_STATE(DEV)      ((void)0)
+#endif /* (USBD_TRACE_SIZE > 0) */
 /** @} */
 
 #ifdef __cplusplus
@@ -0,0 +1,583 @@
+/**
+  ******************************************************************************
+  * @file    usbd.hpp
+  * @author  Benedek Kupper
+  * @version 0.1
+  * @date    2019-01-27
+  * @brief   Universal Serial Bus Device Driver
+  *          C++17 compile-time descriptor builder
+  *
+  * @details
+  * This header-only layer computes the configuration descriptor,
+  * the interface numbering and the string descriptors of the device
+  * as constant expressions, so they are placed in read-only memory,
+  * and the configuration errors are reported at compile time:
+  * duplicate or misdirected endpoint addresses, endpoint numbers
+  * beyond USBD_MAX_EP_COUNT, more interfaces than USBD_MAX_IF_COUNT,
+  * or a configuration descriptor which doesn't fit USBD_EP0_BUFFER_SIZE.
+  * The value errors are reported as calls to the functions of @ref usbd::error.
+  *
+  * The functions are listed in interface number order, and mounted
+  * through the builder, which configures the C interface handles
+  * with the same endpoints as the descriptor:
+  *     @code
+  *     static constexpr usbd::configuration config {
+  *         usbd::power{ 100, true },
+  *         usbd::cdc_acm{ 0x81, 0x01, 0x82 },
+  *         usbd::msc{ 0x83, 0x02 },
+  *     };
+  *     static constexpr auto config_fs = config.descriptor(usbd::speed::full);
+  *     static constexpr auto product = usbd::string_descriptor("Gadget");
+  *
+  *     const USBD_DescriptionType dev_desc = {
+  *         ...
+  *         .ConfigDesc = { config_fs.data() },     // USBD_STATIC_INTERFACES
+  *     };
+  *
+  *     config.mount<0>(cdc_if, &dev);
+  *     config.mount<1>(msc_if, &dev);
+  *     @endcode
+  * Other classes (e.g. DFU, NCM) are still mounted with their C API,
+  * in this case the configuration descriptor is assembled at runtime.
+  * The class functions are called without runtime indirection
+  * when USBD_STATIC_INTERFACES lists the same interfaces.
+  *
+  * Copyright (c) 2019 Benedek Kupper
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+#ifndef __USBD_HPP_
+#define __USBD_HPP_
+
+#include <usbd.h>
+#include <usbd_cdc.h>
+#include <usbd_hid.h>
+#include <usbd_msc.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <tuple>
+
+/** @ingroup USBD
+ * @defgroup USBD_Cpp USBD C++ Descriptor Builder
+ * @{ */
+
+namespace usbd
+{
+
+/** @brief The configuration errors are reported by calling these undefined functions
+ *         in the constant evaluation, so the compiler's diagnostic names the violated rule. */
+namespace error
+{
+void endpoint_address_is_duplicated();
+void endpoint_address_is_invalid();
+void endpoint_direction_is_invalid();
+void endpoint_number_exceeds_USBD_MAX_EP_COUNT();
+void configuration_exceeds_USBD_EP0_BUFFER_SIZE();
+void high_speed_requires_USBD_HS_SUPPORT();
+void string_is_not_valid_UTF8();
+void string_is_too_long();
+}
+
+/** @brief USB device speeds */
+enum class speed : uint8_t
+{
+    full = USB_SPEED_FULL,  /*!< Full speed (12 Mbps) */
+    high = USB_SPEED_HIGH,  /*!< High speed (480 Mbps) */
+};
+
+/** @brief Constant descriptor storage, aligned for the Peripheral Driver */
+template <std::size_t N>
+struct alignas(USBD_DATA_ALIGNMENT) descriptor
+{
+    uint8_t bytes[N] = {};  /*!< Descriptor data, N is an upper limit of its length */
+    std::size_t length = 0; /*!< Actual length of the descriptor */
+
+    constexpr const uint8_t* data() const { return bytes; }
+    constexpr std::size_t size() const { return length; }
+
+    constexpr void put(uint8_t b)
+    {
+        bytes[length++] = b;
+    }
+
+    constexpr void put16(uint16_t w)
+    {
+        put(static_cast<uint8_t>(w));
+        put(static_cast<uint8_t>(w >> 8));
+    }
+};
+
+/**
+ * @brief Calculates the index of an interface string, same as USBD_IIF_INDEX().
+ * @param ifNum: the interface index in the device
+ * @param intNum: the interface-internal string index
+ * @return The string descriptor index
+ */
+constexpr uint8_t interface_string(uint8_t ifNum, uint8_t intNum = 0)
+{
+    return static_cast<uint8_t>(USBD_ISTR_INTERFACES + ifNum + (intNum << 4));
+}
+
+/**
+ * @brief Converts milliseconds to HS descriptor bInterval format,
+ *        same as USBD_EpHsInterval().
+ * @param interval_ms: the EP polling interval in ms
+ * @return The closest bInterval field value
+ */
+constexpr uint8_t hs_interval(uint32_t interval_ms)
+{
+    uint32_t i = 3, interval_125us = (interval_ms * 1000) / 125;
+    for (; i < 16; i++)
+    {
+        if (interval_125us < (static_cast<uint32_t>(2) << i))
+        {
+            i++;
+            break;
+        }
+    }
+    return static_cast<uint8_t>(i);
+}
+
+/**
+ * @brief Converts a UTF-8 string to a USB string descriptor at compile time.
+ * @param text: the UTF-8 string literal
+ * @return The string descriptor
+ */
+template <std::size_t N>
+constexpr descriptor<2 + 2 * (N - 1)> string_descriptor(const char (&text)[N])
+{
+    descriptor<2 + 2 * (N - 1)> d;
+    std::size_t i = 0;
+
+    d.put(0);
+    d.put(USB_DESC_TYPE_STRING);
+
+    while ((i < (N - 1)) && (text[i] != 0))
+    {
+        uint32_t code = static_cast<uint8_t>(text[i++]);
+        int ext = 0;
+
+        if      (code >= 0xF8) { error::string_is_not_valid_UTF8(); }
+        else if (code >= 0xF0) { code &= 0x07; ext = 3; }
+        else if (code >= 0xE0) { code &= 0x0F; ext = 2; }
+        else if (code >= 0xC0) { code &= 0x1F; ext = 1; }
+        else if (code >= 0x80) { error::string_is_not_valid_UTF8(); }
+
+        for (; ext > 0; ext--)
+        {
+            if ((i >= (N - 1)) || ((static_cast<uint8_t>(text[i]) & 0xC0) != 0x80))
+            {
+                error::string_is_not_valid_UTF8();
+            }
+            code = (code << 6) | (static_cast<uint8_t>(text[i++]) & 0x3F);
+        }
+
+        if ((code > 0x10FFFF) || ((code >= 0xD800) && (code <= 0xDFFF)))
+        {
+            error::string_is_not_valid_UTF8();
+        }
+        else if (code >= 0x10000)
+        {
+            /* Encode as surrogate pair */
+            code -= 0x10000;
+            d.put16(static_cast<uint16_t>(0xD800 | (code >> 10)));
+            d.put16(static_cast<uint16_t>(0xDC00 | (code & 0x3FF)));
+        }
+        else
+        {
+            d.put16(static_cast<uint16_t>(code));
+        }
+    }
+
+    /* The descriptor length is limited to 8 bits */
+    if (d.length > 0xFF)
+    {
+        error::string_is_too_long();
+    }
+    d.bytes[0] = static_cast<uint8_t>(d.length);
+    return d;
+}
+
+/** @brief Configuration power attributes */
+struct power
+{
+    uint16_t max_current_mA;        /*!< Maximum current demand (2 .. 500 mA) */
+    bool self_powered = false;      /*!< Self powered vs USB bus powered */
+    bool remote_wakeup = false;     /*!< Remote wakeup support */
+};
+
+namespace detail
+{
+template <std::size_t N>
+constexpr void interface_desc(descriptor<N> &d, uint8_t ifNum, uint8_t numEps,
+        uint8_t cls, uint8_t subCls, uint8_t prot, uint8_t iInterface)
+{
+    d.put(sizeof(USB_InterfaceDescType));
+    d.put(USB_DESC_TYPE_INTERFACE);
+    d.put(ifNum);
+    d.put(0);
+    d.put(numEps);
+    d.put(cls);
+    d.put(subCls);
+    d.put(prot);
+    d.put(iInterface);
+}
+
+template <std::size_t N>
+constexpr void endpoint_desc(descriptor<N> &d, uint8_t epAddr,
+        USB_EndPointType type, uint16_t mps, uint8_t interval = 1)
+{
+    d.put(sizeof(USB_EndpointDescType));
+    d.put(USB_DESC_TYPE_ENDPOINT);
+    d.put(epAddr);
+    d.put(type);
+    d.put16(mps);
+    d.put(interval);
+}
+
+constexpr uint8_t in_ep(uint8_t epAddr)
+{
+    if ((epAddr & 0x80) == 0)
+    {
+        error::endpoint_direction_is_invalid();
+    }
+    return epAddr;
+}
+
+constexpr uint8_t out_ep(uint8_t epAddr)
+{
+    if ((epAddr & 0x80) != 0)
+    {
+        error::endpoint_direction_is_invalid();
+    }
+    return epAddr;
+}
+
+constexpr uint16_t bulk_mps(speed s)
+{
+    return (s == speed::high) ? USB_EP_BULK_HS_MPS : USB_EP_BULK_FS_MPS;
+}
+}
+
+/** @brief CDC Abstract Control Model function (serial port), see @ref USBD_CDC */
+struct cdc_acm
+{
+    uint8_t in_ep;              /*!< IN endpoint address */
+    uint8_t out_ep;             /*!< OUT endpoint address */
+    uint8_t notify_ep;          /*!< Notification endpoint address */
+    uint8_t protocol = 0;       /*!< Protocol used for Control requests, 0 for AT commands */
+    bool send_break = false;    /*!< Set if the application handles SEND_BREAK */
+
+    using handle_type = USBD_CDC_IfHandleType;
+
+    static constexpr uint8_t interface_count = 2;
+    static constexpr std::size_t max_length = 8 + 9 + 5 + 5 + 4 + 5 + 7 + 9 + 7 + 7;
+
+    constexpr std::size_t endpoints(uint8_t *addrs) const
+    {
+        addrs[0] = detail::in_ep(in_ep);
+        addrs[1] = detail::out_ep(out_ep);
+        addrs[2] = detail::in_ep(notify_ep);
+        return 3;
+    }
+
+    template <std::size_t N>
+    constexpr void write(descriptor<N> &d, uint8_t ifNum, speed s) const
+    {
+        const uint8_t prot = (protocol != 0) ? protocol : 0x01;
+
+        /* Interface Association Descriptor */
+        d.put(sizeof(USB_IfAssocDescType));
+        d.put(USB_DESC_TYPE_IAD);
+        d.put(ifNum);
+        d.put(interface_count);
+        d.put(0x02);
+        d.put(0x02);
+        d.put(prot);
+        d.put(interface_string(ifNum));
+
+        detail::interface_desc(d, ifNum, USBD_CDC_NOTEP_USED, 0x02, 0x02, prot,
+                interface_string(ifNum));
+
+        /* Header Functional Descriptor */
+        d.put(5); d.put(0x24); d.put(0x00); d.put16(0x110);
+        /* Call Management Functional Descriptor */
+        d.put(5); d.put(0x24); d.put(0x01); d.put(0x00); d.put(ifNum + 1);
+        /* ACM Functional Descriptor */
+        d.put(4); d.put(0x24); d.put(0x02);
+        d.put(((USBD_CDC_BREAK_SUPPORT == 1) && send_break) ? 0x06 : 0x02);
+        /* Union Functional Descriptor */
+        d.put(5); d.put(0x24); d.put(0x06); d.put(ifNum); d.put(ifNum + 1);
+
+#if (USBD_CDC_NOTEP_USED == 1)
+        detail::endpoint_desc(d, notify_ep, USB_EP_TYPE_INTERRUPT, 8, 20);
+#endif
+
+        /* The data interface shares the function's string */
+        detail::interface_desc(d, ifNum + 1, 2, 0x0A, 0x00, 0x00,
+                interface_string(ifNum));
+        detail::endpoint_desc(d, out_ep, USB_EP_TYPE_BULK, detail::bulk_mps(s));
+        detail::endpoint_desc(d, in_ep, USB_EP_TYPE_BULK, detail::bulk_mps(s));
+    }
+
+    USBD_ReturnType mount(handle_type &itf, USBD_HandleType *dev) const
+    {
+        itf.Config.Protocol = protocol;
+        itf.Config.InEpNum  = in_ep;
+        itf.Config.OutEpNum = out_ep;
+        itf.Config.NotEpNum = notify_ep;
+        return USBD_CDC_MountInterface(&itf, dev);
+    }
+};
+
+/** @brief Mass Storage Bulk-Only function, see @ref USBD_MSC */
+struct msc
+{
+    uint8_t in_ep;              /*!< IN endpoint address */
+    uint8_t out_ep;             /*!< OUT endpoint address */
+
+    using handle_type = USBD_MSC_IfHandleType;
+
+    static constexpr uint8_t interface_count = 1;
+    static constexpr std::size_t max_length = 9 + 7 + 7;
+
+    constexpr std::size_t endpoints(uint8_t *addrs) const
+    {
+        addrs[0] = detail::in_ep(in_ep);
+        addrs[1] = detail::out_ep(out_ep);
+        return 2;
+    }
+
+    template <std::size_t N>
+    constexpr void write(descriptor<N> &d, uint8_t ifNum, speed s) const
+    {
+        /* SCSI transparent, Bulk-Only (BBB) */
+        detail::interface_desc(d, ifNum, 2, 0x08, 0x06, 0x50,
+                interface_string(ifNum));
+        detail::endpoint_desc(d, out_ep, USB_EP_TYPE_BULK, detail::bulk_mps(s));
+        detail::endpoint_desc(d, in_ep, USB_EP_TYPE_BULK, detail::bulk_mps(s));
+    }
+
+    USBD_ReturnType mount(handle_type &itf, USBD_HandleType *dev) const
+    {
+        itf.Config.InEpNum  = in_ep;
+        itf.Config.OutEpNum = out_ep;
+        return USBD_MSC_MountInterface(&itf, dev);
+    }
+};
+
+/** @brief Human Interface Device function without alternate settings, see @ref USBD_HID */
+struct hid
+{
+    uint8_t in_ep;              /*!< IN endpoint address */
+    const USBD_HID_ReportConfigType *report; /*!< The report configuration of the application */
+    uint8_t out_ep = 0;         /*!< OUT endpoint address, 0 if not used */
+
+    using handle_type = USBD_HID_IfHandleType;
+
+    static constexpr uint8_t interface_count = 1;
+    static constexpr std::size_t max_length = 9 + 9 + 7 + 7;
+
+    constexpr std::size_t endpoints(uint8_t *addrs) const
+    {
+        addrs[0] = detail::in_ep(in_ep);
+        addrs[1] = detail::out_ep(out_ep);
+        return (has_out()) ? 2 : 1;
+    }
+
+    template <std::size_t N>
+    constexpr void write(descriptor<N> &d, uint8_t ifNum, speed s) const
+    {
+        detail::interface_desc(d, ifNum, has_out() ? 2 : 1, 0x03, 0x00, 0x00,
+                interface_string(ifNum));
+
+        /* HID Class Descriptor */
+        d.put(9); d.put(HID_DESC_TYPE_HID); d.put16(0x0111); d.put(0x00); d.put(1);
+        d.put(HID_DESC_TYPE_REPORT); d.put16(report->DescLength);
+
+        detail::endpoint_desc(d, in_ep, USB_EP_TYPE_INTERRUPT,
+                mps(report->Input.MaxSize), interval(report->Input.Interval_ms, s));
+        if (has_out())
+        {
+            detail::endpoint_desc(d, out_ep, USB_EP_TYPE_INTERRUPT,
+                    mps(report->Output.MaxSize), interval(report->Output.Interval_ms, s));
+        }
+    }
+
+    USBD_ReturnType mount(handle_type &itf, USBD_HandleType *dev) const
+    {
+        itf.Config.InEpNum  = in_ep;
+#if (USBD_HID_OUT_SUPPORT == 1)
+        itf.Config.OutEpNum = out_ep;
+#endif
+        return USBD_HID_MountInterface(&itf, dev);
+    }
+
+private:
+    constexpr bool has_out() const
+    {
+        return (USBD_HID_OUT_SUPPORT == 1) && (out_ep != 0);
+    }
+
+    static constexpr uint16_t mps(uint16_t maxSize)
+    {
+        const uint16_t limit = (USBD_HS_SUPPORT == 1) ? USB_EP_INTR_HS_MPS : USB_EP_INTR_FS_MPS;
+        return (maxSize > limit) ? limit : maxSize;
+    }
+
+    static constexpr uint8_t interval(uint8_t interval_ms, speed s)
+    {
+        return (s == speed::high) ? hs_interval(interval_ms) : interval_ms;
+    }
+};
+
+/**
+ * @brief The single configuration of the device, composed of functions
+ *        in interface number order. Declare it constexpr, so the validation
+ *        takes place at compile time.
+ */
+template <typename... Fns>
+class configuration
+{
+public:
+    /** @brief Upper limit of the configuration descriptor length */
+    static constexpr std::size_t max_length = sizeof(USB_ConfigDescType) + (Fns::max_length + ...);
+
+    /** @brief Number of interfaces in the configuration */
+    static constexpr uint8_t interface_count = (Fns::interface_count + ...);
+
+    static_assert(interface_count <= USBD_MAX_IF_COUNT,
+            "The interface count exceeds USBD_MAX_IF_COUNT");
+
+    constexpr configuration(const power &pwr, const Fns&... fns)
+        : power_(pwr), functions_(fns...)
+    {
+        uint8_t addrs[3 * sizeof...(Fns)] = {};
+        std::size_t count = 0;
+
+        std::apply([&](const auto&... fn) {
+            ((count += fn.endpoints(&addrs[count])), ...);
+        }, functions_);
+
+        for (std::size_t i = 0; i < count; i++)
+        {
+            if (((addrs[i] & 0x7F) == 0) || ((addrs[i] & 0x70) != 0))
+            {
+                error::endpoint_address_is_invalid();
+            }
+            if ((addrs[i] & 0xF) >= USBD_MAX_EP_COUNT)
+            {
+                error::endpoint_number_exceeds_USBD_MAX_EP_COUNT();
+            }
+            for (std::size_t j = 0; j < i; j++)
+            {
+                if (addrs[i] == addrs[j])
+                {
+                    error::endpoint_address_is_duplicated();
+                }
+            }
+        }
+
+#if (USBD_CTRL_STREAMING != 1)
+        /* The descriptor is assembled in the EP0 buffer when it isn't provided */
+        if (descriptor(speed::full).size() > USBD_EP0_BUFFER_SIZE)
+        {
+            error::configuration_exceeds_USBD_EP0_BUFFER_SIZE();
+        }
+#endif
+    }
+
+    /**
+     * @brief Returns the number of the function's first interface.
+     * @tparam I: the index of the function in the configuration
+     */
+    template <std::size_t I>
+    static constexpr uint8_t interface_number()
+    {
+        constexpr uint8_t counts[] = { Fns::interface_count... };
+        uint8_t ifNum = 0;
+
+        for (std::size_t i = 0; i < I; i++)
+        {
+            ifNum += counts[i];
+        }
+        return ifNum;
+    }
+
+    /**
+     * @brief Assembles the configuration descriptor for the selected speed,
+     *        which is identical to the one the classes assemble at runtime.
+     * @param s: the device speed
+     * @return The configuration descriptor
+     */
+    constexpr usbd::descriptor<max_length> descriptor(speed s) const
+    {
+        usbd::descriptor<max_length> d;
+        uint8_t ifNum = 0;
+
+        if ((s == speed::high) && (USBD_HS_SUPPORT != 1))
+        {
+            error::high_speed_requires_USBD_HS_SUPPORT();
+        }
+
+        d.put(sizeof(USB_ConfigDescType));
+        d.put(USB_DESC_TYPE_CONFIGURATION);
+        d.put16(0);
+        d.put(interface_count);
+        d.put(1);
+        d.put(USBD_ISTR_CONFIG);
+        d.put(0x80 | (power_.remote_wakeup ? 0x20 : 0) | (power_.self_powered ? 0x40 : 0));
+        d.put(static_cast<uint8_t>(power_.max_current_mA / 2));
+
+        std::apply([&](const auto&... fn) {
+            ((fn.write(d, ifNum, s), ifNum += fn.interface_count), ...);
+        }, functions_);
+
+        /* wTotalLength */
+        d.bytes[2] = static_cast<uint8_t>(d.length);
+        d.bytes[3] = static_cast<uint8_t>(d.length >> 8);
+        return d;
+    }
+
+    /**
+     * @brief Configures the endpoints of the interface handle,
+     *        and mounts it to the device with its C API.
+     * @tparam I: the index of the function in the configuration
+     * @param itf: the C interface handle of the function
+     * @param dev: USB Device handle reference
+     * @return INVALID if the interface would be mounted at a different number
+     *         than in the configuration descriptor, otherwise the mount result
+     */
+    template <std::size_t I>
+    USBD_ReturnType mount(
+            typename std::tuple_element_t<I, std::tuple<Fns...>>::handle_type &itf,
+            USBD_HandleType *dev) const
+    {
+        if (dev->IfCount != interface_number<I>())
+        {
+            return USBD_E_INVALID;
+        }
+        return std::get<I>(functions_).mount(itf, dev);
+    }
+
+private:
+    power power_;
+    std::tuple<Fns...> functions_;
+};
+
+}
+
+/** @} */
+
+#endif /* __USBD_HPP_ */
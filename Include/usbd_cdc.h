@@ -37,6 +37,56 @@ extern "C"
 /** @defgroup USBD_CDC Communications Device Class (CDC)
  * @{ */
 
+/** @defgroup USBD_CDC_Exported_Macros CDC Exported Macros
+ * @{ */
+
+#ifndef USBD_CDC_STREAMING
+/** @brief The application manages the transfer buffers by default */
+#define USBD_CDC_STREAMING          0
+#endif
+
+#if (USBD_CDC_STREAMING == 1)
+#ifndef USBD_CDC_TX_BUFFER_SIZE
+/** @brief Size of the transmit ring of a streaming CDC interface */
+#define USBD_CDC_TX_BUFFER_SIZE     1024
+#endif
+#if ((USBD_CDC_TX_BUFFER_SIZE & (USBD_CDC_TX_BUFFER_SIZE - 1)) != 0) || (USBD_CDC_TX_BUFFER_SIZE > 0x8000)
+#error "USBD_CDC_TX_BUFFER_SIZE must be a power of 2, and at most 32 kB!"
+#endif
+
+#ifndef USBD_CDC_TX_HOLD_TIME
+/** @brief The written data is sent without delay by default */
+#define USBD_CDC_TX_HOLD_TIME       0
+#endif
+#if (USBD_CDC_TX_HOLD_TIME > 0) && !defined(USBD_CDC_TX_TIMESTAMP)
+#error "USBD_CDC_TX_HOLD_TIME requires the USBD_CDC_TX_TIMESTAMP() time source!"
+#endif
+
+#ifndef USBD_CDC_RX_BUFFER_SIZE
+/** @brief Size of the receive ring of a streaming CDC interface */
+#define USBD_CDC_RX_BUFFER_SIZE     1024
+#endif
+#if ((USBD_CDC_RX_BUFFER_SIZE & (USBD_CDC_RX_BUFFER_SIZE - 1)) != 0) || (USBD_CDC_RX_BUFFER_SIZE > 0x8000)
+#error "USBD_CDC_RX_BUFFER_SIZE must be a power of 2, and at most 32 kB!"
+#endif
+
+#ifndef USBD_CDC_RX_HIGH_WATERMARK
+/** @brief The reception is paused when this much unread data is in the receive ring */
+#define USBD_CDC_RX_HIGH_WATERMARK  (USBD_CDC_RX_BUFFER_SIZE * 3 / 4)
+#endif
+
+#ifndef USBD_CDC_RX_LOW_WATERMARK
+/** @brief The paused reception is resumed when the unread data is reduced to this level */
+#define USBD_CDC_RX_LOW_WATERMARK   (USBD_CDC_RX_BUFFER_SIZE / 4)
+#endif
+#if (USBD_CDC_RX_LOW_WATERMARK >= USBD_CDC_RX_HIGH_WATERMARK) || \
+    (USBD_CDC_RX_HIGH_WATERMARK > USBD_CDC_RX_BUFFER_SIZE)
+#error "The CDC receive watermarks must be in increasing order within the receive ring!"
+#endif
+#endif /* (USBD_CDC_STREAMING == 1) */
+
+/** @} */
+
 /** @defgroup USBD_CDC_Exported_Types CDC Exported Types
  * @{ */
 
@@ -169,11 +219,15 @@ typedef struct
 
     void (*Received)    (void* itf,
                          uint8_t* data,
-                         uint16_t length);  /*!< Received data available */
+                         uint16_t length);  /*!< Received data available
+                                                 @note In streaming mode the data stays
+                                                 in the receive buffer until it's read */
 
     void (*Transmitted) (void* itf,
                          uint8_t* data,
-                         uint16_t length);  /*!< Transmission of data completed */
+                         uint16_t length);  /*!< Transmission of data completed
+                                                 @note In streaming mode the length
+                                                 is freed up in the transmit ring */
 
 #if (USBD_CDC_CONTROL_LINE_USED == 1)
     void (*SetCtrlLine) (void* itf,
@@ -210,10 +264,49 @@ typedef struct
     USBD_CDC_LineCodingType LineCoding; /*!< CDC line coding */
     USBD_PADDING_1();
     uint16_t TransmitLength;            /*!< Backup transmitted length for splitting transfers */
+#if (USBD_CDC_STREAMING == 1)
+    struct {
+        uint8_t Buffer[USBD_CDC_TX_BUFFER_SIZE] __align(USBD_DATA_ALIGNMENT);
+        uint16_t Head;                  /*!< Free-running write index (application) */
+        uint16_t Tail;                  /*!< Free-running send index (USB core) */
+        uint16_t Length;                /*!< Length of the transfer in progress */
+        uint16_t Wrap;                  /*!< Write index from which the end of the ring is skipped */
+        uint16_t Reserved;              /*!< Size of the region reserved for direct writing */
+        uint8_t Busy;                   /*!< Set while the IN endpoint is used by the ring */
+        uint8_t Wraps;                  /*!< Number of skipped ring ends (application) */
+        uint8_t Wrapped;                /*!< Number of skipped ring ends (USB core) */
+#if (USBD_CDC_NOTEP_USED == 1)
+        uint8_t Dropped;                /*!< Number of overruns reported by the application */
+        uint8_t Reported;               /*!< Number of overruns notified to the host (USB core) */
+        uint8_t Notifying;              /*!< Set while the overrun notification is in progress */
+#endif
+#if (USBD_CDC_TX_HOLD_TIME > 0)
+        uint8_t Holding;                /*!< Set while a partial packet is held back */
+        uint16_t Flush;                 /*!< Write index until which the data is sent without delay */
+        uint32_t HoldStart;             /*!< Timestamp of holding back the partial packet */
+#endif
+    }Tx;                                /*!< Transmit ring of the streaming mode */
+    struct {
+        uint8_t Buffer[USBD_CDC_RX_BUFFER_SIZE +
+            ((USBD_HS_SUPPORT == 1) ? USB_EP_BULK_HS_MPS : USB_EP_BULK_FS_MPS)]
+            __align(USBD_DATA_ALIGNMENT); /*!< The packet received past the ring's end
+                                               is moved to its start */
+        uint16_t Head;                  /*!< Free-running receive index (USB core) */
+        uint16_t Tail;                  /*!< Free-running read index (application) */
+        uint8_t Armed;                  /*!< Set while the OUT endpoint is used by the ring */
+        uint8_t Paused;                 /*!< Set from reaching the high watermark until the low one */
+    }Rx;                                /*!< Receive ring of the streaming mode */
+#if (USBD_CDC_NOTEP_USED == 1)
+    USBD_CDC_NotifyMessageType SerialState; /*!< Overrun notification of the streaming mode */
+#endif
+#endif /* (USBD_CDC_STREAMING == 1) */
 }USBD_CDC_IfHandleType;
 
 /** @} */
 
+/** @brief The CDC-ACM interface class, to be listed in USBD_STATIC_IF_LIST */
+extern const USBD_ClassType USBD_CDC_Class;
+
 /** @addtogroup USBD_CDC_Exported_Functions
  * @{ */
 USBD_ReturnType USBD_CDC_MountInterface (USBD_CDC_IfHandleType *itf,
@@ -227,6 +320,32 @@ USBD_ReturnType USBD_CDC_Receive        (USBD_CDC_IfHandleType *itf,
                                          uint8_t *data,
                                          uint16_t length);
 
+#if (USBD_CDC_STREAMING == 1)
+uint16_t        USBD_CDC_Write          (USBD_CDC_IfHandleType *itf,
+                                         const uint8_t *data,
+                                         uint16_t length);
+
+uint8_t*        USBD_CDC_TxReserve      (USBD_CDC_IfHandleType *itf,
+                                         uint16_t length);
+
+USBD_ReturnType USBD_CDC_TxCommit       (USBD_CDC_IfHandleType *itf,
+                                         uint16_t length);
+
+#if (USBD_CDC_NOTEP_USED == 1)
+void            USBD_CDC_ReportOverrun  (USBD_CDC_IfHandleType *itf);
+#endif
+
+uint16_t        USBD_CDC_Read           (USBD_CDC_IfHandleType *itf,
+                                         uint8_t *data,
+                                         uint16_t length);
+
+#if (USBD_CDC_TX_HOLD_TIME > 0)
+void            USBD_CDC_Flush          (USBD_CDC_IfHandleType *itf);
+
+void            USBD_CDC_Poll           (USBD_CDC_IfHandleType *itf);
+#endif /* (USBD_CDC_TX_HOLD_TIME > 0) */
+#endif /* (USBD_CDC_STREAMING == 1) */
+
 #if (USBD_CDC_NOTEP_USED == 1)
 USBD_ReturnType USBD_CDC_Notify         (USBD_CDC_IfHandleType *itf,
                                          USBD_CDC_NotifyMessageType *notice);
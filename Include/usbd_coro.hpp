@@ -0,0 +1,534 @@
+/**
+  ******************************************************************************
+  * @file    usbd_coro.hpp
+  * @author  Benedek Kupper
+  * @version 0.1
+  * @date    2019-01-28
+  * @brief   Universal Serial Bus Device Driver
+  *          C++20 coroutine awaitables of the transfers
+  *
+  * @details
+  * The awaitables start the transfer when awaited, and resume the coroutine
+  * from the existing completion callbacks, so a sequence of transfers
+  * can be written without a callback driven state machine:
+  *     @code
+  *     static usbd::cdc_port serial("Serial port");
+  *
+  *     static usbd::task echo(usbd::cdc_port &port)
+  *     {
+  *         static uint8_t buffer[64];
+  *         co_await port.opened();
+  *         for (;;)
+  *         {
+  *             auto rx = co_await port.read(buffer);
+  *             if (rx.status != USBD_E_OK) { co_await port.opened(); continue; }
+  *             co_await port.write(std::span(buffer, rx.length));
+  *         }
+  *     }
+  *
+  *     USBD_CDC_MountInterface(serial.handle(), &dev);
+  *     echo(serial);
+  *     @endcode
+  * The coroutine frames are allocated from a static arena of
+  * USBD_CORO_FRAME_COUNT blocks of USBD_CORO_FRAME_SIZE bytes, a coroutine
+  * which doesn't fit isn't started (see @ref usbd::task::started).
+  * Each port serves one pending operation of each kind, the others
+  * are rejected with BUSY, but the operations of different endpoints
+  * and interfaces can be outstanding at the same time.
+  * The coroutines are resumed in the context of the completion callbacks,
+  * so the arena isn't locked: start the coroutines from the same context,
+  * e.g. the thread calling @ref USBD_Process with USBD_DEFERRED_EVENTS.
+  *
+  * Copyright (c) 2019 Benedek Kupper
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+#ifndef __USBD_CORO_HPP_
+#define __USBD_CORO_HPP_
+
+#if (__cplusplus < 202002L)
+#error "usbd_coro.hpp requires C++20 coroutines!"
+#endif
+
+#include <private/usbd_internal.h>
+#include <usbd_cdc.h>
+#include <usbd_ncm.h>
+
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <span>
+
+/** @ingroup USBD
+ * @defgroup USBD_Coro USBD C++ Coroutines
+ * @{ */
+
+#ifndef USBD_CORO_FRAME_SIZE
+/** @brief Size of a coroutine frame block in the static arena */
+#define USBD_CORO_FRAME_SIZE            256
+#endif
+
+#ifndef USBD_CORO_FRAME_COUNT
+/** @brief Number of coroutine frame blocks in the static arena */
+#define USBD_CORO_FRAME_COUNT           4
+#endif
+
+namespace usbd
+{
+
+namespace detail
+{
+/** @brief Static coroutine frame pool */
+class frame_arena
+{
+public:
+    void* allocate(std::size_t size) noexcept
+    {
+        if (size <= USBD_CORO_FRAME_SIZE)
+        {
+            for (std::size_t i = 0; i < USBD_CORO_FRAME_COUNT; i++)
+            {
+                if (!used_[i])
+                {
+                    used_[i] = true;
+                    return blocks_[i];
+                }
+            }
+        }
+        return nullptr;
+    }
+
+    void deallocate(void *frame) noexcept
+    {
+        for (std::size_t i = 0; i < USBD_CORO_FRAME_COUNT; i++)
+        {
+            if (frame == blocks_[i])
+            {
+                used_[i] = false;
+            }
+        }
+    }
+
+private:
+    alignas(std::max_align_t) unsigned char blocks_[USBD_CORO_FRAME_COUNT][USBD_CORO_FRAME_SIZE];
+    bool used_[USBD_CORO_FRAME_COUNT] = {};
+};
+
+inline frame_arena arena;
+
+/** @brief A single pending operation of a port */
+struct pending
+{
+    std::coroutine_handle<> waiter;
+
+    bool busy() const noexcept { return static_cast<bool>(waiter); }
+
+    void resume() noexcept
+    {
+        if (waiter)
+        {
+            std::coroutine_handle<> h = waiter;
+            waiter = nullptr;
+            h.resume();
+        }
+    }
+};
+}
+
+/**
+ * @brief Detached coroutine, which starts immediately,
+ *        and releases its frame to the arena when it returns.
+ */
+class task
+{
+public:
+    struct promise_type
+    {
+        static void* operator new(std::size_t size) noexcept
+        {
+            return detail::arena.allocate(size);
+        }
+
+        static void operator delete(void *frame) noexcept
+        {
+            detail::arena.deallocate(frame);
+        }
+
+        static task get_return_object_on_allocation_failure() noexcept { return task(false); }
+        task get_return_object() noexcept { return task(true); }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() noexcept {}
+        void unhandled_exception() noexcept { std::terminate(); }
+    };
+
+    /** @brief False if the coroutine frame didn't fit in the arena */
+    bool started() const noexcept { return started_; }
+
+private:
+    explicit task(bool started) noexcept : started_(started) {}
+
+    bool started_;
+};
+
+/** @brief Result of an awaited transfer */
+struct transfer_result
+{
+    USBD_ReturnType status;     /*!< OK if the transfer completed, the rejection reason otherwise */
+    USBD_LengthType length;     /*!< The transferred length */
+};
+
+namespace detail
+{
+/** @brief Base of the awaitables which start a transfer when suspending */
+template <typename Starter>
+struct transfer_awaiter
+{
+    pending &op;
+    Starter start;
+    transfer_result result = { USBD_E_OK, 0 };
+
+    bool await_ready() const noexcept { return false; }
+
+    bool await_suspend(std::coroutine_handle<> h) noexcept
+    {
+        USBD_ReturnType status;
+
+        if (op.busy())
+        {
+            result.status = USBD_E_BUSY;
+            return false;
+        }
+        op.waiter = h;
+
+        /* The transfer may complete (and resume) before returning,
+         * so the awaiter isn't accessed after a successful start */
+        status = start(&result);
+        if (status != USBD_E_OK)
+        {
+            op.waiter = nullptr;
+            result.status = status;
+            return false;
+        }
+        return true;
+    }
+
+    transfer_result await_resume() const noexcept { return result; }
+};
+
+template <typename Starter>
+transfer_awaiter(pending&, Starter) -> transfer_awaiter<Starter>;
+}
+
+#if (USBD_EP_HANDLERS == 1)
+/**
+ * @brief Awaitable transfers of a non-control endpoint, which isn't served by
+ *        an interface class, using @ref USBD_EpSetHandler.
+ */
+class endpoint
+{
+    /* Starts the transfer when the awaiter suspends */
+    struct starter
+    {
+        endpoint *self;
+        uint8_t *data;
+        std::size_t length;
+
+        USBD_ReturnType operator()(transfer_result *result) const noexcept
+        {
+            if (length > USBD_MAX_TRANSFER_LENGTH)
+            {
+                return USBD_E_INVALID;
+            }
+            self->result_ = result;
+            USBD_EpSetHandler(self->dev_, self->addr_, &endpoint::complete, self);
+            return (self->addr_ > 0x7F) ?
+                    USBD_EpSend   (self->dev_, self->addr_, data, static_cast<USBD_LengthType>(length)) :
+                    USBD_EpReceive(self->dev_, self->addr_, data, static_cast<USBD_LengthType>(length));
+        }
+    };
+
+public:
+    endpoint(USBD_HandleType *dev, uint8_t epAddr) noexcept
+        : dev_(dev), addr_(epAddr)
+    {}
+
+    endpoint(const endpoint&) = delete;
+    endpoint& operator=(const endpoint&) = delete;
+
+    /** @brief Sends the data through the IN endpoint. */
+    detail::transfer_awaiter<starter> send(std::span<const uint8_t> data) noexcept
+    {
+        return { op_, { this, const_cast<uint8_t*>(data.data()), data.size() } };
+    }
+
+    /** @brief Receives data through the OUT endpoint. */
+    detail::transfer_awaiter<starter> receive(std::span<uint8_t> data) noexcept
+    {
+        return { op_, { this, data.data(), data.size() } };
+    }
+
+private:
+    static void complete(void *context, USBD_EpHandleType *ep) noexcept
+    {
+        endpoint *self = static_cast<endpoint*>(context);
+
+        self->result_->length = ep->Transfer.Length;
+        self->op_.resume();
+    }
+
+    USBD_HandleType *dev_;
+    uint8_t addr_;
+    transfer_result *result_ = nullptr;
+    detail::pending op_;
+};
+#endif /* (USBD_EP_HANDLERS == 1) */
+
+/**
+ * @brief CDC-ACM interface with awaitable operations,
+ *        the application callbacks of the class are implemented by the port.
+ */
+class cdc_port
+{
+public:
+    explicit cdc_port(const char *name, uint8_t inEp = 0x81,
+            uint8_t outEp = 0x01, uint8_t notEp = 0x82) noexcept
+    {
+        app_.Name        = name;
+        app_.Open        = &cdc_port::on_open;
+        app_.Close       = &cdc_port::on_close;
+        app_.Received    = &cdc_port::on_received;
+        app_.Transmitted = &cdc_port::on_transmitted;
+        handle_.App             = &app_;
+        handle_.Config.InEpNum  = inEp;
+        handle_.Config.OutEpNum = outEp;
+        handle_.Config.NotEpNum = notEp;
+    }
+
+    cdc_port(const cdc_port&) = delete;
+    cdc_port& operator=(const cdc_port&) = delete;
+
+    /** @brief The C interface handle to mount. */
+    USBD_CDC_IfHandleType* handle() noexcept { return &handle_; }
+
+    /**
+     * @brief Waits until the host opens the port, resumes immediately if it's open.
+     *        A single coroutine can wait, a concurrent one is rejected with BUSY.
+     */
+    auto opened() noexcept
+    {
+        struct awaiter
+        {
+            cdc_port &port;
+            USBD_ReturnType status;
+
+            bool await_ready() noexcept
+            {
+                if (port.is_open_)
+                {
+                    return true;
+                }
+                else if (port.open_.busy())
+                {
+                    status = USBD_E_BUSY;
+                    return true;
+                }
+                else
+                {
+                    return false;
+                }
+            }
+
+            void await_suspend(std::coroutine_handle<> h) noexcept { port.open_.waiter = h; }
+            USBD_ReturnType await_resume() const noexcept { return status; }
+        };
+        return awaiter{ *this, USBD_E_OK };
+    }
+
+    /** @brief Receives the next chunk of data from the host into the buffer. */
+    auto read(std::span<uint8_t> data) noexcept
+    {
+        return detail::transfer_awaiter{ read_, [this, data](transfer_result *result)
+        {
+            read_result_ = result;
+            return USBD_CDC_Receive(&handle_, data.data(), static_cast<uint16_t>(data.size()));
+        }};
+    }
+
+    /** @brief Transmits the data to the host. */
+    auto write(std::span<const uint8_t> data) noexcept
+    {
+        return detail::transfer_awaiter{ write_, [this, data](transfer_result *result)
+        {
+            write_result_ = result;
+            return USBD_CDC_Transmit(&handle_, const_cast<uint8_t*>(data.data()),
+                    static_cast<uint16_t>(data.size()));
+        }};
+    }
+
+private:
+    static cdc_port* from(void *itf) noexcept
+    {
+        /* The handle is the first member */
+        return reinterpret_cast<cdc_port*>(itf);
+    }
+
+    static void on_open(void *itf, USBD_CDC_LineCodingType*) noexcept
+    {
+        cdc_port *self = from(itf);
+
+        self->is_open_ = true;
+        self->open_.resume();
+    }
+
+    static void on_close(void *itf) noexcept
+    {
+        cdc_port *self = from(itf);
+
+        self->is_open_ = false;
+        if (self->read_.busy())
+        {
+            self->read_result_->status = USBD_E_ERROR;
+            self->read_.resume();
+        }
+        if (self->write_.busy())
+        {
+            self->write_result_->status = USBD_E_ERROR;
+            self->write_.resume();
+        }
+    }
+
+    static void on_received(void *itf, uint8_t*, uint16_t length) noexcept
+    {
+        cdc_port *self = from(itf);
+
+        if (self->read_.busy())
+        {
+            self->read_result_->length = length;
+            self->read_.resume();
+        }
+    }
+
+    static void on_transmitted(void *itf, uint8_t*, uint16_t length) noexcept
+    {
+        cdc_port *self = from(itf);
+
+        if (self->write_.busy())
+        {
+            self->write_result_->length = length;
+            self->write_.resume();
+        }
+    }
+
+    USBD_CDC_IfHandleType handle_ = {};
+    USBD_CDC_AppType app_ = {};
+    bool is_open_ = false;
+    detail::pending open_;
+    detail::pending read_;
+    detail::pending write_;
+    transfer_result *read_result_ = nullptr;
+    transfer_result *write_result_ = nullptr;
+};
+
+/**
+ * @brief CDC-NCM interface with awaitable datagram reception,
+ *        the application callbacks of the class are implemented by the port.
+ */
+class ncm_port
+{
+public:
+    explicit ncm_port(const char *name, const USBD_NCM_NetAddressType *mac,
+            uint8_t inEp = 0x81, uint8_t outEp = 0x01, uint8_t notEp = 0x82) noexcept
+    {
+        app_.Name       = name;
+        app_.NetAddress = mac;
+        app_.Received   = &ncm_port::on_received;
+        handle_.App             = &app_;
+        handle_.Config.InEpNum  = inEp;
+        handle_.Config.OutEpNum = outEp;
+        handle_.Config.NotEpNum = notEp;
+    }
+
+    ncm_port(const ncm_port&) = delete;
+    ncm_port& operator=(const ncm_port&) = delete;
+
+    /** @brief The C interface handle to mount. */
+    USBD_NCM_IfHandleType* handle() noexcept { return &handle_; }
+
+    /** @brief Returns the next received datagram, which is valid until the next call. */
+    auto next_datagram() noexcept
+    {
+        struct awaiter
+        {
+            ncm_port &port;
+            std::span<uint8_t> datagram;
+
+            bool await_ready() noexcept
+            {
+                uint16_t length;
+                uint8_t *data;
+
+                /* A concurrent request gets an empty datagram */
+                if (port.datagram_.busy())
+                {
+                    return true;
+                }
+                data = USBD_NCM_GetDatagram(&port.handle_, &length);
+                if (data != nullptr)
+                {
+                    datagram = std::span<uint8_t>(data, length);
+                }
+                return (data != nullptr);
+            }
+
+            void await_suspend(std::coroutine_handle<> h) noexcept
+            {
+                port.datagram_.waiter = h;
+                port.next_ = &datagram;
+            }
+
+            std::span<uint8_t> await_resume() const noexcept { return datagram; }
+        };
+        return awaiter{ *this, {} };
+    }
+
+private:
+    static void on_received(void *itf) noexcept
+    {
+        /* The handle is the first member */
+        ncm_port *self = reinterpret_cast<ncm_port*>(itf);
+
+        if (self->datagram_.busy())
+        {
+            uint16_t length;
+            uint8_t *data = USBD_NCM_GetDatagram(&self->handle_, &length);
+
+            if (data != nullptr)
+            {
+                *self->next_ = std::span<uint8_t>(data, length);
+                self->datagram_.resume();
+            }
+        }
+    }
+
+    USBD_NCM_IfHandleType handle_ = {};
+    USBD_NCM_AppType app_ = {};
+    detail::pending datagram_;
+    std::span<uint8_t> *next_ = nullptr;
+};
+
+}
+
+/** @} */
+
+#endif /* __USBD_CORO_HPP_ */
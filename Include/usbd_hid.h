@@ -175,6 +175,9 @@ typedef struct
 
 /** @} */
 
+/** @brief The HID interface class, to be listed in USBD_STATIC_IF_LIST */
+extern const USBD_ClassType USBD_HID_Class;
+
 /** @addtogroup USBD_HID_Exported_Functions
  * @{ */
 USBD_ReturnType USBD_HID_MountInterface (USBD_HID_IfHandleType *itf,
@@ -0,0 +1,145 @@
+/**
+  ******************************************************************************
+  * @file    usbd_mailbox.h
+  * @author  Benedek Kupper
+  * @version 0.1
+  * @date    2019-01-29
+  * @brief   Universal Serial Bus Device Driver
+  *          Inter-core message passing
+  *
+  * @details
+  * The mailboxes split the device between two cores (or threads):
+  * the USB core handles the peripheral interrupt and the USBD / class callbacks,
+  * while the application core processes the data. Each mailbox is a lock-free
+  * single producer, single consumer ring of messages, so the two directions
+  * take one mailbox each:
+  *     @code
+  *     static USBD_MailboxType to_app, to_usb;
+  *
+  *     // USB core, class application callback
+  *     static void cdc_received(void *itf, uint8_t *data, uint16_t length)
+  *     {
+  *         USBD_MBX_Post(&to_app, app_process, itf, data, length);
+  *     }
+  *
+  *     // application core, the buffer is returned when it's processed
+  *     static void app_process(void *itf, void *data, USBD_LengthType length)
+  *     {
+  *         ...
+  *         USBD_MBX_Post(&to_usb, usb_receive, itf, data, RX_BUFFER_SIZE);
+  *     }
+  *     @endcode
+  * Both cores call @ref USBD_MBX_Dispatch on their incoming mailbox,
+  * which executes the handlers of the messages in their order of posting.
+  * @ref USBD_MailboxCallback can be overridden to wake up the receiver.
+  *
+  * Buffer ownership: a message passes the ownership of its data buffer
+  * to the receiving core, which may only access the buffer until it posts it back.
+  * - The buffers passed to the class transfer functions (e.g. @ref USBD_CDC_Receive,
+  *   @ref USBD_CDC_Transmit, @ref USBD_HID_ReportIn) belong to the USB core
+  *   until the class reports their completion. These functions, as well as
+  *   the other class functions, are only called from the USB core.
+  * - The class internal buffers (@ref USBD_NCM_IfHandleType::Out,
+  *   @ref USBD_NCM_IfHandleType::In, @ref USBD_MSC_IfHandleType::Buffer)
+  *   never leave the USB core. A datagram of @ref USBD_NCM_GetDatagram
+  *   can be posted to the application core, but the next datagram
+  *   may only be requested after it's posted back (released).
+  * - The MSC storage callbacks return their result to the class synchronously,
+  *   they are executed on the USB core.
+  *
+  * Copyright (c) 2019 Benedek Kupper
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+#ifndef __USBD_MAILBOX_H_
+#define __USBD_MAILBOX_H_
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <usbd_types.h>
+
+/** @ingroup USBD
+ * @defgroup USBD_Mailbox USBD Inter-core Mailboxes
+ * @{ */
+
+/** @defgroup USBD_Mailbox_Exported_Macros Mailbox Exported Macros
+ * @{ */
+
+#ifndef USBD_MAILBOX_SIZE
+/** @brief Number of message slots in a mailbox, one of them is always kept empty */
+#define USBD_MAILBOX_SIZE           16
+#endif
+
+/** @} */
+
+/** @defgroup USBD_Mailbox_Exported_Types Mailbox Exported Types
+ * @{ */
+
+/**
+ * @brief Message handler function pointer type
+ * @param context: the reference posted with the message (e.g. the interface)
+ * @param data: the buffer passed with the message
+ * @param length: the length of the data
+ */
+typedef void            ( *USBD_MessageCbkType )( void *context,
+                                                  void *data,
+                                                  USBD_LengthType length );
+
+
+/** @brief Mailbox message structure */
+typedef struct
+{
+    USBD_MessageCbkType Handler;    /*!< Executed by the receiving core */
+    void *Context;                  /*!< Reference passed to the handler */
+    void *Data;                     /*!< The buffer handed over to the receiving core */
+    USBD_LengthType Length;         /*!< The length of the data */
+}USBD_MessageType;
+
+
+/** @brief Single producer, single consumer mailbox structure */
+typedef struct
+{
+    USBD_MessageType Queue[USBD_MAILBOX_SIZE]; /*!< Message slots */
+    uint16_t Head;                  /*!< Next slot to post to (written by the sender) */
+    uint16_t Tail;                  /*!< Next slot to dispatch (written by the receiver) */
+}USBD_MailboxType;
+
+/** @} */
+
+/** @addtogroup USBD_Mailbox_Exported_Functions
+ * @{ */
+void            USBD_MBX_Init           (USBD_MailboxType *mbx);
+
+USBD_ReturnType USBD_MBX_Post           (USBD_MailboxType *mbx,
+                                         USBD_MessageCbkType handler,
+                                         void *context,
+                                         void *data,
+                                         USBD_LengthType length);
+
+uint16_t        USBD_MBX_Dispatch       (USBD_MailboxType *mbx);
+
+uint16_t        USBD_MBX_Pending        (USBD_MailboxType *mbx);
+
+void            USBD_MailboxCallback    (USBD_MailboxType *mbx);
+/** @} */
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __USBD_MAILBOX_H_ */
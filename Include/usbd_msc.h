@@ -43,6 +43,9 @@ extern "C"
 #ifndef USBD_MSC_BUFFER_SIZE
 #define USBD_MSC_BUFFER_SIZE        512
 #endif
+#if (USBD_MSC_BUFFER_SIZE > USBD_MAX_TRANSFER_LENGTH)
+#error "USBD_MSC_BUFFER_SIZE exceeds the transfer length, see USBD_TRANSFER_LENGTH_BITS!"
+#endif
 
 /** @} */
 
@@ -181,7 +184,9 @@ typedef struct
 /** @brief MSC Logical Unit interfacing structure */
 typedef struct
 {
-    void           (*Init)  (uint8_t lun);      /*!< Initialize media (optional) */
+    void           (*Init)  (uint8_t lun);      /*!< Initialize media (optional),
+                                                     slow media can finish it in the background,
+                                                     reporting !Status->Ready until then */
 
     void           (*Deinit)(uint8_t lun);      /*!< Release media (optional) */
 
@@ -220,7 +225,7 @@ typedef struct
     USBD_PADDING_1(a);
 
     /* MSC class internal context */
-    uint8_t Buffer[USBD_MSC_BUFFER_SIZE];   /*!< Block transferring buffer */
+    uint8_t Buffer[USBD_MSC_BUFFER_SIZE];   /*!< Block transferring buffer (owned by the USB core) */
     USBD_MSC_CommandBlockWrapperType  CBW;  /*!< Command Block Wrapper */
     USBD_PADDING_1(b);
     USBD_MSC_CommandStatusWrapperType CSW;  /*!< Command Status Wrapper */
@@ -238,6 +243,9 @@ typedef struct
 
 /** @} */
 
+/** @brief The MSC interface class, to be listed in USBD_STATIC_IF_LIST */
+extern const USBD_ClassType USBD_MSC_Class;
+
 /** @addtogroup USBD_MSC_Exported_Functions
  * @{ */
 USBD_ReturnType USBD_MSC_MountInterface (USBD_MSC_IfHandleType *itf,
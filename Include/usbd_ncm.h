@@ -104,7 +104,7 @@ typedef struct
         uint8_t  Page;
         uint8_t  Dx;
         volatile uint8_t State[2];
-    }Out;                           /*!< Received NTB status and double buffer */
+    }Out;                           /*!< Received NTB status and double buffer (owned by the USB core) */
 
     struct {
         uint32_t Data[2][USBD_NCM_MAX_IN_SIZE  / sizeof(uint32_t)];
@@ -115,11 +115,14 @@ typedef struct
         uint8_t  DgCount;
         volatile uint8_t SendState;
         volatile uint8_t FillState;
-    }In;                            /*!< Transmit NTB status and double buffer */
+    }In;                            /*!< Transmit NTB status and double buffer (owned by the USB core) */
 }USBD_NCM_IfHandleType;
 
 /** @} */
 
+/** @brief The CDC-NCM interface class, to be listed in USBD_STATIC_IF_LIST */
+extern const USBD_ClassType USBD_NCM_Class;
+
 /** @addtogroup USBD_NCM_Exported_Functions
  * @{ */
 USBD_ReturnType USBD_NCM_MountInterface (USBD_NCM_IfHandleType *itf,
@@ -85,6 +85,143 @@
 #define USBD_HS_SUPPORT                 0
 #endif
 
+#ifndef USBD_EP_QUEUE_SUPPORT
+#define USBD_EP_QUEUE_SUPPORT           0
+#endif
+
+#ifndef USBD_EP_HANDLERS
+#define USBD_EP_HANDLERS                0
+#endif
+
+#ifndef USBD_EP_SCHEDULER
+/** @brief The IN transfers are passed to the peripheral in the order of submission by default */
+#define USBD_EP_SCHEDULER               0
+#endif
+
+#ifndef USBD_EP_SCHED_SLOTS
+/** @brief A single scheduled IN transfer is in progress at a time */
+#define USBD_EP_SCHED_SLOTS             1
+#endif
+
+#ifndef USBD_EP_SCHED_BUDGET
+/** @brief The number of bytes a bulk endpoint can send before yielding its turn */
+#define USBD_EP_SCHED_BUDGET            2048
+#endif
+
+#ifndef USBD_EP_ATOMIC_CLAIM
+/** @brief The endpoints are only submitted from the USB event handling context by default */
+#define USBD_EP_ATOMIC_CLAIM            0
+#endif
+#if (USBD_EP_ATOMIC_CLAIM == 1) && (USBD_EP_QUEUE_SUPPORT == 1) && !defined(USBD_CRITICAL_ENTER)
+#error "USBD_EP_ATOMIC_CLAIM requires USBD_CRITICAL_ENTER() and USBD_CRITICAL_EXIT() to protect the endpoint queues!"
+#endif
+#if (USBD_EP_ATOMIC_CLAIM == 1) && (USBD_EP_SCHEDULER == 1) && !defined(USBD_CRITICAL_ENTER)
+#error "USBD_EP_ATOMIC_CLAIM requires USBD_CRITICAL_ENTER() and USBD_CRITICAL_EXIT() to protect the endpoint scheduler!"
+#endif
+
+#ifndef USBD_TRANSFER_LENGTH_BITS
+/** @brief A single endpoint transfer is limited to 64 kB by default */
+#define USBD_TRANSFER_LENGTH_BITS       16
+#endif
+#if (USBD_TRANSFER_LENGTH_BITS == 16)
+#define USBD_MAX_TRANSFER_LENGTH        0xFFFF
+#elif (USBD_TRANSFER_LENGTH_BITS == 32)
+#define USBD_MAX_TRANSFER_LENGTH        0xFFFFFFFF
+#else
+#error "USBD_TRANSFER_LENGTH_BITS must be either 16 or 32!"
+#endif
+
+#ifndef USBD_CONFIG_DESC_CACHE_SIZE
+/** @brief The configuration descriptors are assembled on each request by default */
+#define USBD_CONFIG_DESC_CACHE_SIZE     0
+#endif
+
+#ifndef USBD_STRING_TABLE_SIZE
+/** @brief The string descriptors are converted on each request by default */
+#define USBD_STRING_TABLE_SIZE          0
+#endif
+
+#ifndef USBD_CONST_STRING_TABLE
+#define USBD_CONST_STRING_TABLE         0
+#endif
+
+#ifndef USBD_CTRL_STREAMING
+#define USBD_CTRL_STREAMING             0
+#endif
+
+#if (USBD_CTRL_STREAMING == 1) && (USBD_EP0_BUFFER_SIZE < USB_EP0_FS_MAX_PACKET_SIZE)
+#error "USBD_CTRL_STREAMING requires USBD_EP0_BUFFER_SIZE to fit at least one EP0 packet!"
+#endif
+
+#ifndef USBD_STATIC_INTERFACES
+/** @brief The interfaces are mounted at runtime by default */
+#define USBD_STATIC_INTERFACES          0
+#endif
+
+#ifndef USBD_MAX_IF_DESC_SIZE
+/** @brief The longest descriptor of a single function, including its associated interfaces */
+#define USBD_MAX_IF_DESC_SIZE           128
+#endif
+
+#ifndef USBD_ASYNC_CONFIG
+/** @brief The interfaces are configured before the SET_CONFIGURATION status stage by default */
+#define USBD_ASYNC_CONFIG               0
+#endif
+
+#ifndef USBD_DEFERRED_EVENTS
+#define USBD_DEFERRED_EVENTS            0
+#endif
+
+#ifndef USBD_EVENT_QUEUE_SIZE
+/** @brief Each endpoint can have a single pending completion,
+ * with some space left for the bus resets and setup requests */
+#define USBD_EVENT_QUEUE_SIZE           (2 * USBD_MAX_EP_COUNT + 4)
+#endif
+
+#if (USBD_DEFERRED_EVENTS == 1) && (USBD_EVENT_QUEUE_SIZE > 255)
+#error "USBD_EVENT_QUEUE_SIZE must not exceed 255!"
+#endif
+
+#ifndef USBD_EP_SG_SUPPORT
+/** @brief Determined by the peripheral's ability to transfer segmented buffers */
+#define USBD_EP_SG_SUPPORT              0
+#endif
+
+#ifndef USBD_EP_SG_BUFFER_SIZE
+/** @brief Size of the buffer which linearizes the segmented transfers
+ * when the peripheral doesn't support them */
+#define USBD_EP_SG_BUFFER_SIZE          0
+#endif
+
+#ifndef USBD_EP_STATS
+#define USBD_EP_STATS                   0
+#endif
+
+#ifndef USBD_EP_STATS_BINS
+/** @brief The last bin collects the latencies of 2^14 timestamp ticks and above */
+#define USBD_EP_STATS_BINS              16
+#endif
+
+#ifndef USBD_TRACE_SIZE
+#define USBD_TRACE_SIZE                 0
+#endif
+
+#ifndef USBD_EVENT_RECORDING
+#define USBD_EVENT_RECORDING            0
+#endif
+
+#ifndef USBD_TRACE_DATA_SIZE
+/** @brief Fits a setup request, and the header of most class specific transfers */
+#define USBD_TRACE_DATA_SIZE            8
+#elif ((USBD_TRACE_DATA_SIZE < 8) || ((USBD_TRACE_DATA_SIZE % 4) != 0))
+#error "USBD_TRACE_DATA_SIZE must be a multiple of 4, and at least 8!"
+#endif
+
+#ifndef USBD_TRACE_TIMESTAMP
+/** @brief Without a timestamp source the trace only preserves the order of events */
+#define USBD_TRACE_TIMESTAMP()          0
+#endif
+
 #if !defined(USBD_SPEC_BCD) && ((USBD_LPM_SUPPORT != 0) || (USBD_MS_OS_DESC_VERSION == 2))
 /** @brief In order to support reading the BOS descriptor
  * (which specifies the LPM support of the device),
@@ -155,6 +292,16 @@ typedef struct
 }USBD_ConfigurationType;
 
 
+#if (USBD_CONST_STRING_TABLE == 1)
+/** @brief USB string descriptor table entry */
+typedef struct
+{
+    uint8_t Index;              /*!< String descriptor index (iString) */
+    const uint8_t *Desc;        /*!< Ready-to-send string descriptor, NULL terminates the table */
+}USBD_StringTableEntryType;
+#endif /* (USBD_CONST_STRING_TABLE == 1) */
+
+
 /** @brief USB Device descriptors structure */
 typedef struct
 {
@@ -180,27 +327,224 @@ typedef struct
 #if (USBD_SERIAL_BCD_SIZE > 0)
     USBD_SerialNumberType *SerialNumber;/*!< Product serial number reference */
 #endif
+#if (USBD_CONST_STRING_TABLE == 1)
+    const USBD_StringTableEntryType *StringTable; /*!< Prepared string descriptors, served before the converted ones */
+#endif
+#if (USBD_STATIC_INTERFACES == 1)
+    const uint8_t *ConfigDesc[USBD_HS_SUPPORT + 1]; /*!< Prepared configuration descriptors per speed,
+                                                         assembled from the interfaces when NULL */
+#endif
 }USBD_DescriptionType;
 
 
-/** @brief USB endpoint handle structure */
+/** @brief USB endpoint transfer length type, see USBD_TRANSFER_LENGTH_BITS */
+#if (USBD_TRANSFER_LENGTH_BITS == 32)
+typedef uint32_t USBD_LengthType;
+#else
+typedef uint16_t USBD_LengthType;
+#endif
+
+
+/** @brief USB endpoint transfer buffer segment */
+typedef struct
+{
+    uint8_t *Data;                      /*!< Segment data */
+    USBD_LengthType Length;             /*!< Segment length */
+}USBD_EpSegmentType;
+
+
+#if (USBD_EP_QUEUE_SUPPORT == 1)
+struct _USBD_EpRequestType;
+
+/**
+ * @brief Endpoint transfer request completion callback function pointer type
+ * @param req: reference to the completed transfer request
+ */
+typedef void            ( *USBD_EpReqCbkType )  ( struct _USBD_EpRequestType *req );
+
+
+/** @brief USB endpoint transfer request structure */
+typedef struct _USBD_EpRequestType
+{
+    struct _USBD_EpRequestType *Next;   /*!< Next request in the endpoint queue (managed by USBD) */
+    uint8_t *Data;                      /*!< Transfer buffer */
+    USBD_LengthType Length;             /*!< Length of the transfer buffer */
+    USBD_LengthType Actual;             /*!< Transferred length at completion */
+    USBD_EpReqCbkType Complete;         /*!< Completion callback (optional) */
+    void *Context;                      /*!< Reference of the request owner */
+}USBD_EpRequestType;
+#endif /* (USBD_EP_QUEUE_SUPPORT == 1) */
+
+
+#if (USBD_EP_HANDLERS == 1)
+struct _USBD_EpHandleType;
+
+/**
+ * @brief Endpoint transfer completion handler function pointer type
+ * @param context: the reference bound together with the handler
+ * @param ep: reference of the endpoint which completed the transfer
+ */
+typedef void            ( *USBD_EpCbkType )     ( void *context,
+                                                  struct _USBD_EpHandleType *ep );
+#endif /* (USBD_EP_HANDLERS == 1) */
+
+
+#if (USBD_EP_STATS == 1)
+/** @brief USB endpoint statistics */
+typedef struct
+{
+    uint32_t Bytes;                     /*!< Number of transferred bytes */
+    uint32_t Transfers;                 /*!< Number of completed transfers */
+    uint32_t ZeroLength;                /*!< Number of completed zero length transfers */
+    uint32_t Busy;                      /*!< Number of transfers rejected due to the busy endpoint */
+    uint32_t Stalls;                    /*!< Number of times the endpoint was halted */
+#ifdef USBD_EP_STATS_TIMESTAMP
+    uint32_t Latency[USBD_EP_STATS_BINS]; /*!< Log2 histogram of the submit to completion times:
+                                             bin 0 counts 0, bin n counts [2^(n-1), 2^n) ticks */
+#endif
+}USBD_EpStatsType;
+#endif /* (USBD_EP_STATS == 1) */
+
+
+#if (USBD_EP_SCHEDULER == 1)
+/** @brief USB IN endpoint scheduling priority classes */
+typedef enum
+{
+    USBD_EP_PRIO_DEFAULT    = 0,    /*!< Determined by the endpoint type:
+                                         interrupt endpoints are HIGH, the others NORMAL */
+    USBD_EP_PRIO_LOW        = 1,    /*!< Background traffic, only served when nothing else is pending */
+    USBD_EP_PRIO_NORMAL     = 2,    /*!< Bulk data streams */
+    USBD_EP_PRIO_HIGH       = 3,    /*!< Latency sensitive reports and notifications */
+}USBD_EpPriorityType;
+
+
+/** @brief USB IN endpoint scheduler waiting time statistics */
 typedef struct
+{
+    uint32_t Count;                     /*!< Number of started transfers */
+    uint32_t Total;                     /*!< Sum of the submit to start waiting times */
+    uint32_t Max;                       /*!< Longest waiting time */
+}USBD_EpWaitStatsType;
+#endif /* (USBD_EP_SCHEDULER == 1) */
+
+
+/** @brief USB endpoint handle structure */
+typedef struct _USBD_EpHandleType
 {
     struct {
         uint8_t *Data;                  /*!< Current data for transfer */
-        uint16_t Length;                /*!< Total length of the transfer */
-        uint16_t Progress;
+        USBD_LengthType Length;         /*!< Total length of the transfer */
+        USBD_LengthType Progress;
     }Transfer;                          /*!< Endpoint data transfer context */
     uint16_t              MaxPacketSize;/*!< Endpoint Max packet size */
     USB_EndPointType      Type;         /*!< Endpoint type */
     USB_EndPointStateType State;        /*!< Endpoint state */
     uint8_t               IfNum;        /*!< Interface index of non-control endpoint */
+#if (USBD_EP_HANDLERS == 1)
+    struct {
+        USBD_EpCbkType Complete;        /*!< Completion handler, called instead of the interface class */
+        void *Context;                  /*!< Reference passed to the handler */
+    }Handler;                           /*!< Directly bound handler of non-control endpoint */
+#endif
+#if (USBD_EP_QUEUE_SUPPORT == 1)
+    struct {
+        USBD_EpRequestType *Head;       /*!< The active transfer request */
+        USBD_EpRequestType *Tail;       /*!< The last queued transfer request */
+    }Queue;                             /*!< Transfer request queue of non-control endpoint */
+#endif
+#if (USBD_EP_STATS == 1)
+    USBD_EpStatsType      Stats;        /*!< Endpoint statistics */
+#ifdef USBD_EP_STATS_TIMESTAMP
+    uint32_t              StartTime;    /*!< Timestamp of the active transfer's start */
+#endif
+#endif
+#if (USBD_EP_SCHEDULER == 1)
+    struct {
+        uint32_t Deadline;              /*!< Requested maximal waiting time, 0 if none */
+        uint32_t Submitted;             /*!< Time of the pending transfer's submission */
+        USBD_EpWaitStatsType Wait;      /*!< Waiting time statistics */
+        uint8_t Priority;               /*!< @ref USBD_EpPriorityType */
+        uint8_t State;                  /*!< Idle, pending or started by the scheduler */
+    }Sched;                             /*!< Transmit scheduling of non-control IN endpoint */
+#endif
+#if (USBD_TRACE_SIZE > 0) || (USBD_EVENT_RECORDING == 1)
+    const uint8_t        *RxBuffer;     /*!< Receive buffer of the OUT transfer, captured at completion */
+#endif
 #ifdef USBD_PD_EP_FIELDS
     USBD_PD_EP_FIELDS;                  /*!< Peripheral Driver specific endpoint context */
 #endif
 }USBD_EpHandleType;
 
 
+/** @brief USB device event types */
+typedef enum
+{
+    USBD_EVENT_RESET = 0,   /*!< Bus reset */
+    USBD_EVENT_SETUP,       /*!< Setup request received */
+    USBD_EVENT_EP_IN,       /*!< IN endpoint transfer completed */
+    USBD_EVENT_EP_OUT,      /*!< OUT endpoint transfer completed */
+}USBD_EventIdType;
+
+
+#if (USBD_DEFERRED_EVENTS == 1)
+
+/** @brief USB device event record */
+typedef struct
+{
+    uint8_t Id;                         /*!< Event type, see @ref USBD_EventIdType */
+    union {
+        USB_SpeedType Speed;            /*!< The new device speed (RESET) */
+        uint8_t EpAddr;                 /*!< Endpoint address (EP_IN, EP_OUT) */
+        USB_SetupRequestType Setup;     /*!< The received request (SETUP) */
+    };
+}USBD_EventType;
+#endif /* (USBD_DEFERRED_EVENTS == 1) */
+
+
+#if (USBD_EVENT_RECORDING == 1)
+/**
+ * @brief USB device event record header. In the recorded stream,
+ *        each header is followed by the event's data (if any).
+ *        The fields are stored in little-endian byte order.
+ */
+typedef struct
+{
+    uint8_t  Id;                        /*!< Event type, see @ref USBD_EventIdType */
+    uint8_t  Param;                     /*!< The new device speed (RESET) or endpoint address */
+    uint16_t Length;                    /*!< Transfer length (saturated to 16 bits), which is also the length
+                                             of the data following the SETUP (8) and EP_OUT records */
+}USBD_RecordType;
+#endif /* (USBD_EVENT_RECORDING == 1) */
+
+
+#if (USBD_TRACE_SIZE > 0)
+/** @brief USB device trace event types */
+typedef enum
+{
+    USBD_TRACE_SETUP = 1,   /*!< Setup request received, Data: the request */
+    USBD_TRACE_SUBMIT,      /*!< Endpoint transfer started, Data: the IN transfer data */
+    USBD_TRACE_COMPLETE,    /*!< Endpoint transfer completed, Data: the OUT transfer data */
+    USBD_TRACE_DATA,        /*!< Continued control transfer data, Length: the remaining length */
+    USBD_TRACE_STALL,       /*!< Endpoint halted */
+    USBD_TRACE_EP_OPEN,     /*!< Endpoint opened, Length: the endpoint type */
+    USBD_TRACE_RESET,       /*!< Bus reset, Param: the new device speed */
+    USBD_TRACE_LINK,        /*!< Link state changed, Param: the new link state */
+    USBD_TRACE_CAPTURED = 0x80, /*!< Flag of the entries which hold transferred data */
+}USBD_TraceEventType;
+
+
+/** @brief USB device trace record */
+typedef struct
+{
+    uint32_t Timestamp;                 /*!< Value of USBD_TRACE_TIMESTAMP() at the event */
+    uint8_t  Event;                     /*!< Event type and flags, see @ref USBD_TraceEventType */
+    uint8_t  Param;                     /*!< Endpoint address, or event specific parameter */
+    uint16_t Length;                    /*!< Transfer length (saturated to 16 bits) */
+    uint8_t  Data[USBD_TRACE_DATA_SIZE];/*!< The beginning of the transferred data */
+}USBD_TraceEntryType;
+#endif /* (USBD_TRACE_SIZE > 0) */
+
+
 struct _USBD_HandleType;
 
 struct _USBD_IfHandleType;
@@ -247,6 +591,21 @@ typedef const char*     ( *USBD_IfStrCbkType )  ( struct _USBD_IfHandleType *itf
 typedef void            ( *USBD_IfEpCbkType )   ( struct _USBD_IfHandleType *itf,
                                                   USBD_EpHandleType *ep);
 
+#if (USBD_CTRL_STREAMING == 1)
+/**
+ * @brief Control IN data stage generator function pointer type
+ * @param dev: USB Device handle reference
+ * @param offset: offset of the requested part within the entire data
+ * @param data: target buffer of the requested part, NULL if only the length is queried
+ * @param len: length of the requested part
+ * @return The length of the entire data
+ */
+typedef uint16_t        ( *USBD_CtrlStreamCbkType ) ( struct _USBD_HandleType *dev,
+                                                  uint16_t offset,
+                                                  uint8_t *data,
+                                                  uint16_t len);
+#endif /* (USBD_CTRL_STREAMING == 1) */
+
 
 /** @brief USB interface class callback (virtual functions) structure */
 typedef struct
@@ -303,13 +662,77 @@ typedef struct _USBD_HandleType
     uint8_t ConfigSelector;                 /*!< Device active configuration index */
 
     uint8_t IfCount;                                /*!< Number of device interfaces */
+#if (USBD_STATIC_INTERFACES != 1)
     USBD_IfHandleType* IF[USBD_MAX_IF_COUNT];       /*!< Device interface references */
+#endif
 
     struct {
         USBD_EpHandleType IN [USBD_MAX_EP_COUNT];   /*!< IN endpoint status */
         USBD_EpHandleType OUT[USBD_MAX_EP_COUNT];   /*!< OUT endpoint status */
     }EP;                                            /*!< Endpoint management */
 
+#if (USBD_CONFIG_DESC_CACHE_SIZE > 0)
+    struct {
+        uint16_t Length[USBD_HS_SUPPORT + 1];       /*!< Length of the descriptor per speed, 0 if invalid */
+        uint8_t Data[USBD_HS_SUPPORT + 1][USBD_CONFIG_DESC_CACHE_SIZE] __align(USBD_DATA_ALIGNMENT); /*!< Assembled descriptors */
+    }ConfigDesc;                                    /*!< Configuration descriptor cache */
+#endif
+
+#if (USBD_STRING_TABLE_SIZE > 0)
+    struct {
+        uint16_t Length;                            /*!< Used length of the table */
+        uint8_t Data[USBD_STRING_TABLE_SIZE] __align(USBD_DATA_ALIGNMENT); /*!< String descriptors, each followed by its index */
+    }Strings;                                       /*!< Converted string descriptor table */
+#endif
+
+#if (USBD_CTRL_STREAMING == 1)
+    struct {
+        USBD_CtrlStreamCbkType Generate;            /*!< Generator of the data stage, NULL if inactive */
+        uint16_t Offset;                            /*!< Length of the already generated data */
+        uint16_t Length;                            /*!< Length of the entire data stage */
+    }CtrlStream;                                    /*!< Chunked control IN data stage */
+#endif
+
+#if (USBD_DEFERRED_EVENTS == 1)
+    struct {
+        uint8_t Head;                               /*!< Write index (Peripheral Driver context) */
+        uint8_t Tail;                               /*!< Read index (@ref USBD_Process context) */
+        uint8_t Flush;                              /*!< Write index + 1 of an overflowed bus reset, 0 if none */
+        uint8_t SetupSeq;                           /*!< Sequence number of the overflowed setup requests */
+        uint16_t Setup;                             /*!< Sequence number and write index + 1 of an overflowed setup request, 0 if none */
+        USB_SpeedType Speed;                        /*!< The new device speed of the overflowed bus reset */
+        USB_SetupRequestType Request;               /*!< The overflowed setup request */
+        USBD_EventType Queue[USBD_EVENT_QUEUE_SIZE]; /*!< Pending events */
+    }Events;                                        /*!< Deferred event queue */
+#endif
+
+#if (USBD_EP_SG_SUPPORT != 1) && (USBD_EP_SG_BUFFER_SIZE > 0)
+    struct {
+        const USBD_EpSegmentType *Segments;         /*!< Segments of the linearized transfer */
+        uint8_t Count;                              /*!< Number of segments */
+        uint8_t EpAddr;                             /*!< Address of the owner endpoint, 0 if free */
+        uint8_t Buffer[USBD_EP_SG_BUFFER_SIZE] __align(USBD_DATA_ALIGNMENT); /*!< Linear transfer buffer */
+    }SgBuffer;                                      /*!< Linearization of segmented transfers */
+#endif
+
+#if (USBD_EP_SCHEDULER == 1)
+    struct {
+        uint32_t Clock;                             /*!< Counts the submissions when no timestamp is available */
+        uint32_t Used;                              /*!< Bytes sent in the current bulk turn */
+        uint8_t Active;                             /*!< Number of started transfers */
+        uint8_t Turn;                               /*!< Endpoint number holding the bulk turn */
+    }Sched;                                         /*!< IN endpoint transmit scheduler */
+#endif
+
+#if (USBD_TRACE_SIZE > 0)
+    struct {
+        uint32_t Count;                             /*!< Number of recorded events */
+        uint16_t EntryCount;                        /*!< Size of the ring, for the trace decoder */
+        uint16_t DataSize;                          /*!< Size of the entry data, for the trace decoder */
+        USBD_TraceEntryType Entries[USBD_TRACE_SIZE]; /*!< Event ring, overwriting the oldest entries */
+    }Trace;                                         /*!< Binary event trace */
+#endif
+
     uint8_t CtrlData[USBD_EP0_BUFFER_SIZE] __align(USBD_DATA_ALIGNMENT); /*!< Control EP buffer for common use */
 }USBD_HandleType;
 
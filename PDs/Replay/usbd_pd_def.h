@@ -0,0 +1,71 @@
+/**
+  ******************************************************************************
+  * @file    usbd_pd_def.h
+  * @author  Benedek Kupper
+  * @version 0.1
+  * @date    2019-01-20
+  * @brief   Universal Serial Bus Device Driver
+  *          Replay Peripheral Driver constant and type definitions
+  *
+  * Copyright (c) 2019 Benedek Kupper
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+#ifndef __USBD_PD_DEF_H_
+#define __USBD_PD_DEF_H_
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <usbd_config.h>
+#include <stddef.h>
+
+/** @addtogroup USBD_Exported_Macros
+ * @{ */
+
+#ifndef __weak
+#define __weak                          __attribute__((weak))
+#endif
+
+/* The virtual peripheral has no Link Power Management */
+#define USBD_LPM_SUPPORT                0
+
+/* The address is only stored, the recorded stream is addressed to the device */
+#define USBD_SET_ADDRESS_IMMEDIATE      0
+
+/* The number of virtual endpoints can be tailored to the recorded device */
+#ifndef USBD_REPLAY_EP_COUNT
+#define USBD_REPLAY_EP_COUNT            8
+#endif
+#define USBD_MAX_EP_COUNT               USBD_REPLAY_EP_COUNT
+
+/* Word alignment, so DMA-like constraints are also exercised */
+#define USBD_DATA_ALIGNMENT             4
+
+/* Peripheral Driver extension fields */
+#define USBD_PD_EP_FIELDS                                           \
+    uint8_t             Armed;          /*!< A transfer is pending on the endpoint */\
+    uint8_t             Halted          /*!< The endpoint responds with STALL */
+
+#define USBD_PD_DEV_FIELDS                                          \
+    uint8_t             Address         /*!< The address assigned by the host */
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __USBD_PD_DEF_H_ */
@@ -0,0 +1,363 @@
+/**
+  ******************************************************************************
+  * @file    usbd_replay.c
+  * @author  Benedek Kupper
+  * @version 0.1
+  * @date    2019-01-20
+  * @brief   Universal Serial Bus Device Driver
+  *          Replay Peripheral Driver
+  *
+  * Copyright (c) 2019 Benedek Kupper
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+#include <usbd.h>
+#include <usbd_replay.h>
+#include <usbd_pd_if.h>
+
+#include <string.h>
+#include <time.h>
+
+/** @ingroup USBD_REPLAY
+ * @defgroup USBD_REPLAY_Private_Functions Replay Private Functions
+ * @{ */
+
+/* Length of the record header in the stream */
+#define REPLAY_HEADER_SIZE          4
+
+/* Length of the setup request in bus format */
+#define REPLAY_SETUP_SIZE           8
+
+static USBD_EpHandleType* replay_epRef(USBD_HandleType *dev, uint8_t epAddr)
+{
+    return (epAddr > 0x7F) ? &dev->EP.IN[epAddr & 0xF] : &dev->EP.OUT[epAddr];
+}
+
+/* Loads the setup request from its bus format */
+static void replay_setup(USBD_HandleType *dev, const uint8_t *data)
+{
+    dev->Setup.RequestType.b = data[0];
+    dev->Setup.Request       = data[1];
+    dev->Setup.Value         = data[2] | (data[3] << 8);
+    dev->Setup.Index         = data[4] | (data[5] << 8);
+    dev->Setup.Length        = data[6] | (data[7] << 8);
+
+    /* The setup packet clears the halt and cancels the transfers of EP0 */
+    dev->EP.IN [0].Armed  = 0;
+    dev->EP.IN [0].Halted = 0;
+    dev->EP.OUT[0].Armed  = 0;
+    dev->EP.OUT[0].Halted = 0;
+
+    USBD_SetupCallback(dev);
+}
+
+/* Completes the armed IN transfer, returns 0 if the device's state matched */
+static int replay_epIn(USBD_HandleType *dev, uint8_t epAddr, uint16_t len)
+{
+    USBD_EpHandleType *ep = replay_epRef(dev, epAddr | 0x80);
+
+    if (((epAddr & 0xF) >= USBD_MAX_EP_COUNT) ||
+        (ep->Armed == 0) || (ep->Halted != 0))
+    {
+        /* The device has no transfer to complete */
+        return -1;
+    }
+    else
+    {
+        int diff = (ep->Transfer.Length != len) ? -1 : 0;
+
+        ep->Armed = 0;
+        USBD_EpInCallback(dev, ep);
+        return diff;
+    }
+}
+
+/* Completes the armed OUT transfer with the recorded data,
+ * returns 0 if the device's state matched */
+static int replay_epOut(USBD_HandleType *dev, uint8_t epAddr,
+        const uint8_t *data, uint16_t len)
+{
+    USBD_EpHandleType *ep = replay_epRef(dev, epAddr & 0x7F);
+
+    if (((epAddr & 0x7F) >= USBD_MAX_EP_COUNT) ||
+        (ep->Armed == 0) || (ep->Halted != 0))
+    {
+        /* The device has no receive buffer for the data */
+        return -1;
+    }
+    else
+    {
+        int diff = (ep->Transfer.Length < len) ? -1 : 0;
+
+        if (diff != 0)
+        {
+            len = ep->Transfer.Length;
+        }
+        if (len > 0)
+        {
+            memcpy(ep->Transfer.Data, data, len);
+        }
+        ep->Transfer.Length = len;
+        ep->Armed = 0;
+        USBD_EpOutCallback(dev, ep);
+        return diff;
+    }
+}
+
+/** @} */
+
+/** @defgroup USBD_REPLAY_Exported_Functions Replay Exported Functions
+ * @brief These functions are called by the benchmark application.
+ * @{ */
+
+/**
+ * @brief Binds the recorded event stream to the device.
+ * @param rp: replay context reference
+ * @param dev: USB Device handle reference
+ * @param stream: the recorded event stream
+ * @param length: the length of the stream
+ */
+void USBD_REPLAY_Init(USBD_ReplayType *rp, USBD_HandleType *dev,
+        const uint8_t *stream, uint32_t length)
+{
+    memset(rp, 0, sizeof(*rp));
+    rp->Device = dev;
+    rp->Stream = stream;
+    rp->Length = length;
+}
+
+/**
+ * @brief Restarts the replay from the beginning of the stream,
+ *        while the statistics are kept.
+ * @param rp: replay context reference
+ */
+void USBD_REPLAY_Rewind(USBD_ReplayType *rp)
+{
+    rp->Position = 0;
+}
+
+/**
+ * @brief Feeds the next recorded event to the device, and measures its handling.
+ * @param rp: replay context reference
+ * @return OK if the event was replayed,
+ *         INVALID if the event didn't match the device's state,
+ *         ERROR if the stream is over or truncated
+ */
+USBD_ReturnType USBD_REPLAY_Step(USBD_ReplayType *rp)
+{
+    USBD_HandleType *dev = rp->Device;
+    const uint8_t *rec = &rp->Stream[rp->Position];
+    uint64_t start;
+    uint32_t dataLen = 0;
+    uint16_t len;
+    int diff = 0;
+
+    if ((rp->Position + REPLAY_HEADER_SIZE) > rp->Length)
+    {
+        return USBD_E_ERROR;
+    }
+    len = rec[2] | (rec[3] << 8);
+    if ((rec[0] == USBD_EVENT_SETUP) || (rec[0] == USBD_EVENT_EP_OUT))
+    {
+        dataLen = len;
+    }
+    if ((rec[0] > USBD_EVENT_EP_OUT) ||
+        ((rp->Position + REPLAY_HEADER_SIZE + dataLen) > rp->Length) ||
+        ((rec[0] == USBD_EVENT_SETUP) && (len != REPLAY_SETUP_SIZE)))
+    {
+        return USBD_E_ERROR;
+    }
+    rp->Position += REPLAY_HEADER_SIZE + dataLen;
+
+    start = USBD_REPLAY_TIMESTAMP();
+
+    switch (rec[0])
+    {
+        case USBD_EVENT_RESET:
+            dev->Address = 0;
+            USBD_ResetCallback(dev, (USB_SpeedType)rec[1]);
+            break;
+
+        case USBD_EVENT_SETUP:
+            replay_setup(dev, &rec[REPLAY_HEADER_SIZE]);
+            break;
+
+        case USBD_EVENT_EP_IN:
+            diff = replay_epIn(dev, rec[1], len);
+            break;
+
+        default:
+            diff = replay_epOut(dev, rec[1], &rec[REPLAY_HEADER_SIZE], len);
+            break;
+    }
+
+#if (USBD_DEFERRED_EVENTS == 1)
+    (void) USBD_Process(dev);
+#endif
+
+    rp->Stats[rec[0]].Time += USBD_REPLAY_TIMESTAMP() - start;
+    rp->Stats[rec[0]].Count++;
+
+    if (diff != 0)
+    {
+        rp->Mismatches++;
+        return USBD_E_INVALID;
+    }
+    return USBD_E_OK;
+}
+
+/**
+ * @brief Replays the stream until its end.
+ * @param rp: replay context reference
+ * @return The number of replayed events
+ */
+uint32_t USBD_REPLAY_Run(USBD_ReplayType *rp)
+{
+    uint32_t count = 0;
+
+    while (USBD_REPLAY_Step(rp) != USBD_E_ERROR)
+    {
+        count++;
+    }
+    return count;
+}
+
+/**
+ * @brief Reads the monotonic clock of the host.
+ * @return The current time in nanoseconds
+ */
+uint64_t USBD_REPLAY_Time_ns(void)
+{
+    struct timespec ts;
+
+    (void) clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/** @} */
+
+/** @ingroup USBD_REPLAY
+ * @defgroup USBD_REPLAY_PD_Functions Replay Peripheral Driver Functions
+ * @brief The @ref USBD_PD_Interface implementation of the replay.
+ * @{ */
+
+void USBD_PD_Init(USBD_HandleType *dev, const USBD_ConfigurationType *conf)
+{
+    uint8_t i;
+
+    (void)conf;
+    for (i = 0; i < USBD_MAX_EP_COUNT; i++)
+    {
+        dev->EP.IN [i].Armed  = 0;
+        dev->EP.IN [i].Halted = 0;
+        dev->EP.OUT[i].Armed  = 0;
+        dev->EP.OUT[i].Halted = 0;
+    }
+    dev->Address = 0;
+    dev->LinkState = USB_LINK_STATE_OFF;
+}
+
+void USBD_PD_Deinit(USBD_HandleType *dev)
+{
+    USBD_PD_Stop(dev);
+}
+
+void USBD_PD_Start(USBD_HandleType *dev)
+{
+    dev->LinkState = USB_LINK_STATE_ACTIVE;
+}
+
+void USBD_PD_Stop(USBD_HandleType *dev)
+{
+    dev->LinkState = USB_LINK_STATE_OFF;
+}
+
+void USBD_PD_SetRemoteWakeup(USBD_HandleType *dev)
+{
+    (void)dev;
+}
+
+void USBD_PD_ClearRemoteWakeup(USBD_HandleType *dev)
+{
+    dev->LinkState = USB_LINK_STATE_ACTIVE;
+}
+
+void USBD_PD_SetAddress(USBD_HandleType *dev, uint8_t addr)
+{
+    dev->Address = addr;
+}
+
+void USBD_PD_CtrlEpOpen(USBD_HandleType *dev)
+{
+    dev->EP.IN [0].Type   = USB_EP_TYPE_CONTROL;
+    dev->EP.IN [0].Armed  = 0;
+    dev->EP.IN [0].Halted = 0;
+    dev->EP.OUT[0].Type   = USB_EP_TYPE_CONTROL;
+    dev->EP.OUT[0].Armed  = 0;
+    dev->EP.OUT[0].Halted = 0;
+}
+
+void USBD_PD_EpOpen(USBD_HandleType *dev, uint8_t addr,
+        USB_EndPointType type, uint16_t mps)
+{
+    USBD_EpHandleType *ep = replay_epRef(dev, addr);
+
+    ep->Type          = type;
+    ep->MaxPacketSize = mps;
+    ep->Armed         = 0;
+    ep->Halted        = 0;
+}
+
+void USBD_PD_EpClose(USBD_HandleType *dev, uint8_t addr)
+{
+    replay_epRef(dev, addr)->Armed = 0;
+}
+
+void USBD_PD_EpSend(USBD_HandleType *dev, uint8_t addr,
+        const uint8_t *data, USBD_LengthType len)
+{
+    USBD_EpHandleType *ep = replay_epRef(dev, addr);
+
+    ep->Transfer.Data     = (uint8_t*)data;
+    ep->Transfer.Length   = len;
+    ep->Transfer.Progress = 0;
+    ep->Armed             = 1;
+}
+
+void USBD_PD_EpReceive(USBD_HandleType *dev, uint8_t addr,
+        uint8_t *data, USBD_LengthType len)
+{
+    USBD_EpHandleType *ep = replay_epRef(dev, addr);
+
+    ep->Transfer.Data     = data;
+    ep->Transfer.Length   = len;
+    ep->Transfer.Progress = 0;
+    ep->Armed             = 1;
+}
+
+void USBD_PD_EpSetStall(USBD_HandleType *dev, uint8_t addr)
+{
+    replay_epRef(dev, addr)->Halted = 1;
+}
+
+void USBD_PD_EpClearStall(USBD_HandleType *dev, uint8_t addr)
+{
+    replay_epRef(dev, addr)->Halted = 0;
+}
+
+void USBD_PD_EpFlush(USBD_HandleType *dev, uint8_t addr)
+{
+    replay_epRef(dev, addr)->Armed = 0;
+}
+
+/** @} */
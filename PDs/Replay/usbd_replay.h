@@ -0,0 +1,126 @@
+/**
+  ******************************************************************************
+  * @file    usbd_replay.h
+  * @author  Benedek Kupper
+  * @version 0.1
+  * @date    2019-01-20
+  * @brief   Universal Serial Bus Device Driver
+  *          Replay of recorded device event streams
+  *
+  * @details
+  * The replay Peripheral Driver feeds an event stream recorded on a live
+  * device back into the stack as a host-native process, so a real-world
+  * session (enumeration, file copy, etc.) becomes a repeatable benchmark.
+  * The stream is recorded by setting USBD_EVENT_RECORDING on the live device,
+  * and storing each record by the @ref USBD_RecordCallback :
+  *     @code
+  *     void USBD_RecordCallback(USBD_HandleType *dev, const USBD_RecordType *rec,
+  *             const uint8_t *data)
+  *     {
+  *         uint8_t hdr[4] = { rec->Id, rec->Param, rec->Length, rec->Length >> 8 };
+  *         log_write(hdr, sizeof(hdr));
+  *         if ((rec->Id == USBD_EVENT_SETUP) || (rec->Id == USBD_EVENT_EP_OUT))
+  *         {
+  *             log_write(data, rec->Length); // zeros if data is NULL
+  *         }
+  *     }
+  *     @endcode
+  * The replayed device has to be mounted with the same configuration
+  * as the recorded one:
+  *     @code
+  *     USBD_ReplayType rp;
+  *     USBD_HandleType dev;
+  *     USBD_Init(&dev, &dev_desc);
+  *     ...mount interfaces...
+  *     USBD_Connect(&dev);
+  *     USBD_REPLAY_Init(&rp, &dev, stream, streamLength);
+  *     USBD_REPLAY_Run(&rp);
+  *     @endcode
+  *
+  * Copyright (c) 2019 Benedek Kupper
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+#ifndef __USBD_REPLAY_H_
+#define __USBD_REPLAY_H_
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <usbd_types.h>
+
+/** @ingroup USBD
+ * @defgroup USBD_REPLAY Replay Peripheral Driver
+ * @{ */
+
+/** @defgroup USBD_REPLAY_Exported_Macros Replay Exported Macros
+ * @{ */
+
+#ifndef USBD_REPLAY_TIMESTAMP
+/** @brief Time source of the event handling measurement,
+ *         the default is the monotonic clock in nanoseconds.
+ *         Define it e.g. as __rdtsc() to measure in CPU cycles. */
+#define USBD_REPLAY_TIMESTAMP()         USBD_REPLAY_Time_ns()
+#endif
+
+/** @} */
+
+/** @defgroup USBD_REPLAY_Exported_Types Replay Exported Types
+ * @{ */
+
+/** @brief Replay statistics of an event type */
+typedef struct
+{
+    uint32_t Count;             /*!< Number of replayed events */
+    uint64_t Time;              /*!< Total handling time in USBD_REPLAY_TIMESTAMP() units */
+}USBD_ReplayStatsType;
+
+
+/** @brief Replay context */
+typedef struct
+{
+    USBD_HandleType *Device;    /*!< The replayed device */
+    const uint8_t *Stream;      /*!< The recorded event stream */
+    uint32_t Length;            /*!< Length of the stream */
+    uint32_t Position;          /*!< Offset of the next record in the stream */
+    uint32_t Mismatches;        /*!< Number of events which didn't match the device's state */
+    USBD_ReplayStatsType Stats[4]; /*!< Statistics indexed by @ref USBD_EventIdType */
+}USBD_ReplayType;
+
+/** @} */
+
+/** @addtogroup USBD_REPLAY_Exported_Functions
+ * @{ */
+void            USBD_REPLAY_Init        (USBD_ReplayType *rp,
+                                         USBD_HandleType *dev,
+                                         const uint8_t *stream,
+                                         uint32_t length);
+
+void            USBD_REPLAY_Rewind      (USBD_ReplayType *rp);
+
+USBD_ReturnType USBD_REPLAY_Step        (USBD_ReplayType *rp);
+
+uint32_t        USBD_REPLAY_Run         (USBD_ReplayType *rp);
+
+uint64_t        USBD_REPLAY_Time_ns     (void);
+/** @} */
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __USBD_REPLAY_H_ */
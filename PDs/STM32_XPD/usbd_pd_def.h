@@ -42,6 +42,11 @@ extern "C"
 #define USBD_HS_SUPPORT                 0
 #endif
 
+#if defined(USBD_TRANSFER_LENGTH_BITS) && (USBD_TRANSFER_LENGTH_BITS == 32)
+/* The XPD endpoint transfer functions take 16 bit lengths */
+#error "USBD_TRANSFER_LENGTH_BITS 32 isn't supported by the STM32_XPD peripheral driver!"
+#endif
+
 /* Link Power Management support by peripheral */
 #define USBD_LPM_SUPPORT                \
     (defined(USB_OTG_GLPMCFG_LPMEN) || defined(USB_LPMCSR_LPMEN))
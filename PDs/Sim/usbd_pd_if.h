@@ -0,0 +1,102 @@
+/**
+  ******************************************************************************
+  * @file    usbd_pd_if.h
+  * @author  Benedek Kupper
+  * @version 0.1
+  * @date    2018-12-30
+  * @brief   Universal Serial Bus Device Driver
+  *          Simulated Peripheral Driver interface function declarations
+  *
+  * Copyright (c) 2018 Benedek Kupper
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+#ifndef __USBD_PD_IF_H_
+#define __USBD_PD_IF_H_
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <usbd_types.h>
+
+void USBD_PD_Init               (USBD_HandleType *dev,
+                                 const USBD_ConfigurationType *conf);
+void USBD_PD_Deinit             (USBD_HandleType *dev);
+void USBD_PD_Start              (USBD_HandleType *dev);
+void USBD_PD_Stop               (USBD_HandleType *dev);
+void USBD_PD_SetRemoteWakeup    (USBD_HandleType *dev);
+void USBD_PD_ClearRemoteWakeup  (USBD_HandleType *dev);
+void USBD_PD_SetAddress         (USBD_HandleType *dev,
+                                 uint8_t addr);
+void USBD_PD_CtrlEpOpen         (USBD_HandleType *dev);
+void USBD_PD_EpOpen             (USBD_HandleType *dev,
+                                 uint8_t addr,
+                                 USB_EndPointType type,
+                                 uint16_t mps);
+void USBD_PD_EpClose            (USBD_HandleType *dev,
+                                 uint8_t addr);
+void USBD_PD_EpSend             (USBD_HandleType *dev,
+                                 uint8_t addr,
+                                 const uint8_t *data,
+                                 USBD_LengthType len);
+void USBD_PD_EpReceive          (USBD_HandleType *dev,
+                                 uint8_t addr,
+                                 uint8_t *data,
+                                 USBD_LengthType len);
+void USBD_PD_EpSendv            (USBD_HandleType *dev,
+                                 uint8_t addr,
+                                 const USBD_EpSegmentType *segs,
+                                 uint8_t count);
+void USBD_PD_EpReceivev         (USBD_HandleType *dev,
+                                 uint8_t addr,
+                                 const USBD_EpSegmentType *segs,
+                                 uint8_t count);
+void USBD_PD_EpSetStall         (USBD_HandleType *dev,
+                                 uint8_t addr);
+void USBD_PD_EpClearStall       (USBD_HandleType *dev,
+                                 uint8_t addr);
+void USBD_PD_EpFlush            (USBD_HandleType *dev,
+                                 uint8_t addr);
+
+/* usbd <- PD */
+void USBD_ResetCallback         (USBD_HandleType *dev,
+                                 USB_SpeedType speed);
+
+/* usbd_ctrl <- PD */
+void USBD_SetupCallback         (USBD_HandleType *dev);
+
+/* usbd_ep <- PD */
+void USBD_EpInCallback          (USBD_HandleType *dev,
+                                 USBD_EpHandleType *ep);
+void USBD_EpOutCallback         (USBD_HandleType *dev,
+                                 USBD_EpHandleType *ep);
+
+/** @addtogroup USBD_Exported_Macros
+ * @{ */
+
+#ifndef __htonl
+#define __htonl(_x)                     ((uint32_t)__builtin_bswap32(_x))
+#endif
+#ifndef __htons
+#define __htons(_x)                     ((uint16_t)__builtin_bswap16(_x))
+#endif
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __USBD_PD_IF_H_ */
@@ -0,0 +1,907 @@
+/**
+  ******************************************************************************
+  * @file    usbd_sim.c
+  * @author  Benedek Kupper
+  * @version 0.1
+  * @date    2018-12-30
+  * @brief   Universal Serial Bus Device Driver
+  *          Simulated Peripheral Driver and USB 2.0 bus model
+  *
+  * Copyright (c) 2018 Benedek Kupper
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+#include <usbd.h>
+#include <usbd_sim.h>
+#include <usbd_pd_if.h>
+#include <string.h>
+
+/** @ingroup USBD_SIM
+ * @defgroup USBD_SIM_Private_Functions Simulation Private Functions
+ * @{ */
+
+/* Control transfer stages of the host */
+enum
+{
+    SIM_CTRL_IDLE = 0,
+    SIM_CTRL_SETUP,
+    SIM_CTRL_DATA_IN,
+    SIM_CTRL_DATA_OUT,
+    SIM_CTRL_STATUS_IN,
+    SIM_CTRL_STATUS_OUT,
+};
+
+/* Outcome of a single bus transaction */
+typedef enum
+{
+    SIM_ACK = 0,
+    SIM_NAK,
+    SIM_STALL,
+    SIM_NO_RESPONSE,
+}SimHandshakeType;
+
+/* (Micro)frame length and the periodic share of it (USB 2.0 5.7.4) */
+#define SIM_FS_FRAME_NS         1000000
+#define SIM_HS_FRAME_NS          125000
+#define SIM_FS_PERIODIC_NS       900000
+#define SIM_HS_PERIODIC_NS       100000
+
+/* Start Of Frame token duration */
+#define SIM_FS_SOF_NS              2924
+#define SIM_HS_SOF_NS               200
+
+static USBD_EpHandleType* sim_epRef(USBD_HandleType *dev, uint8_t epAddr)
+{
+    return (epAddr > 0x7F) ? &dev->EP.IN[epAddr & 0xF] : &dev->EP.OUT[epAddr];
+}
+
+static USBD_SimEpType* sim_pipeRef(USBD_SimBusType *bus, uint8_t epAddr)
+{
+    return (epAddr > 0x7F) ? &bus->IN[epAddr & 0xF] : &bus->OUT[epAddr];
+}
+
+/**
+ * @brief Copies the packet data between the host buffer and the endpoint,
+ *        continuing in the next segment of segmented transfers.
+ * @param ep: device endpoint reference
+ * @param epAddr: endpoint address
+ * @param hostData: host side buffer
+ * @param len: length of the packet data
+ */
+static void sim_epCopy(USBD_EpHandleType *ep, uint8_t epAddr,
+        uint8_t *hostData, uint32_t len)
+{
+    while (len > 0)
+    {
+        uint32_t n = (len < ep->SegLeft) ? len : ep->SegLeft;
+
+        if (n == 0)
+        {
+            ep->Segment++;
+            ep->Transfer.Data = ep->Segment->Data;
+            ep->SegLeft       = ep->Segment->Length;
+            continue;
+        }
+        if (epAddr > 0x7F)
+        {
+            memcpy(hostData, ep->Transfer.Data, n);
+        }
+        else
+        {
+            memcpy(ep->Transfer.Data, hostData, n);
+        }
+        ep->Transfer.Data += n;
+        ep->SegLeft       -= n;
+        hostData          += n;
+        len               -= n;
+    }
+}
+
+static uint64_t sim_now(USBD_SimBusType *bus)
+{
+    return bus->Time_ns + bus->FrameTime_ns;
+}
+
+/**
+ * @brief Calculates the bus time of a transaction
+ *        according to the USB 2.0 specification (5.11.3).
+ * @param bus: simulated bus reference
+ * @param type: endpoint type
+ * @param bc: data byte count
+ * @return The transaction's duration in nanoseconds
+ */
+static uint32_t sim_transactionTime(USBD_SimBusType *bus,
+        USB_EndPointType type, uint32_t bc)
+{
+    /* Floor(3.167 + BitStuffTime(bc)) in bit times */
+    uint32_t bits = (3167 + (7 * 8 * 1000 * bc) / 6) / 1000;
+    uint32_t time;
+
+    if (bus->Speed == USB_SPEED_HIGH)
+    {
+        time = (type == USB_EP_TYPE_ISOCHRONOUS) ? 634 : 917;
+        time += (2083 * bits) / 1000;
+    }
+    else
+    {
+        time = (type == USB_EP_TYPE_ISOCHRONOUS) ? 7268 : 9107;
+        time += (8354 * bits) / 100;
+    }
+    return time + USBD_SIM_HOST_DELAY_NS;
+}
+
+/**
+ * @brief Performs a single data transaction between a host pipe and
+ *        the device endpoint, and notifies the device of transfer completion.
+ * @param bus: simulated bus reference
+ * @param epAddr: endpoint address
+ * @param urb: host transfer request
+ * @param stats: host statistics to update
+ * @return The handshake of the transaction
+ */
+static SimHandshakeType sim_transaction(USBD_SimBusType *bus, uint8_t epAddr,
+        USBD_SimUrbType *urb, USBD_SimEpStatsType *stats)
+{
+    USBD_HandleType *dev = bus->Device;
+    USBD_EpHandleType *ep = sim_epRef(dev, epAddr);
+    SimHandshakeType hs;
+    uint32_t n = 0, cost;
+
+    if (dev->Address != bus->Address)
+    {
+        hs = SIM_NO_RESPONSE;
+    }
+    else if (ep->Halted != 0)
+    {
+        hs = SIM_STALL;
+    }
+    else if (ep->Armed == 0)
+    {
+        hs = SIM_NAK;
+    }
+    else
+    {
+        hs = SIM_ACK;
+    }
+
+    /* Packet size is determined by the data sender */
+    if (epAddr > 0x7F)
+    {
+        if (hs == SIM_ACK)
+        {
+            n = ep->Transfer.Length - ep->Transfer.Progress;
+        }
+    }
+    else
+    {
+        n = urb->Length - urb->Actual;
+    }
+    if (n > ep->MaxPacketSize)
+    {
+        n = ep->MaxPacketSize;
+    }
+
+    cost = sim_transactionTime(bus, ep->Type, n);
+    bus->FrameTime_ns += cost;
+    stats->BusTime_ns += cost;
+
+    if (hs == SIM_ACK)
+    {
+        uint32_t hostSpace = urb->Length - urb->Actual;
+        uint32_t devSpace  = ep->Transfer.Length - ep->Transfer.Progress;
+        uint32_t copy = n;
+
+        /* Babble is truncated by the receiver */
+        if (copy > hostSpace)
+        {
+            copy = hostSpace;
+        }
+        if (copy > devSpace)
+        {
+            copy = devSpace;
+        }
+        sim_epCopy(ep, epAddr, &urb->Data[urb->Actual], copy);
+        ep->Transfer.Progress += copy;
+        urb->Actual           += copy;
+
+        stats->Transactions++;
+        stats->Bytes += copy;
+
+        /* A short packet or the requested length terminates the transfer */
+        if ((n < ep->MaxPacketSize) || (urb->Actual >= urb->Length))
+        {
+            urb->Status = USBD_SIM_DONE;
+            urb->Completed_ns = sim_now(bus);
+        }
+
+        if ((n < ep->MaxPacketSize) ||
+            (ep->Transfer.Progress >= ep->Transfer.Length))
+        {
+            ep->Armed = 0;
+            ep->Transfer.Length = ep->Transfer.Progress;
+
+            if (epAddr > 0x7F)
+            {
+                USBD_EpInCallback(dev, ep);
+            }
+            else
+            {
+                USBD_EpOutCallback(dev, ep);
+            }
+        }
+    }
+    else if (hs == SIM_NAK)
+    {
+        stats->Naks++;
+    }
+    else if (hs == SIM_STALL)
+    {
+        urb->Status = USBD_SIM_STALLED;
+        urb->Completed_ns = sim_now(bus);
+    }
+    else
+    {
+        urb->Status = USBD_SIM_NO_RESPONSE;
+        urb->Completed_ns = sim_now(bus);
+    }
+
+    return hs;
+}
+
+/**
+ * @brief Performs the next transaction of the ongoing control transfer.
+ * @param bus: simulated bus reference
+ * @return The handshake of the transaction
+ */
+static SimHandshakeType sim_ctrlTransaction(USBD_SimBusType *bus)
+{
+    USBD_HandleType *dev = bus->Device;
+    USBD_SimUrbType zlp = { .Data = NULL, .Length = 0 };
+    SimHandshakeType hs = SIM_ACK;
+
+    switch (bus->Ctrl.Stage)
+    {
+        case SIM_CTRL_SETUP:
+        {
+            uint32_t cost = sim_transactionTime(bus, USB_EP_TYPE_CONTROL,
+                    sizeof(USB_SetupRequestType));
+            bus->FrameTime_ns += cost;
+            bus->OUT[0].Stats.BusTime_ns += cost;
+
+            if (dev->Address != bus->Address)
+            {
+                hs = SIM_NO_RESPONSE;
+                bus->Ctrl.Urb.Status = USBD_SIM_NO_RESPONSE;
+                break;
+            }
+
+            /* SETUP is always accepted, and it cancels the previous transfer */
+            dev->EP.IN [0].Armed  = 0;
+            dev->EP.IN [0].Halted = 0;
+            dev->EP.OUT[0].Armed  = 0;
+            dev->EP.OUT[0].Halted = 0;
+
+            if (bus->Ctrl.Setup.Length == 0)
+            {
+                bus->Ctrl.Stage = SIM_CTRL_STATUS_IN;
+            }
+            else if (bus->Ctrl.Setup.RequestType.Direction == USB_DIRECTION_IN)
+            {
+                bus->Ctrl.Stage = SIM_CTRL_DATA_IN;
+            }
+            else
+            {
+                bus->Ctrl.Stage = SIM_CTRL_DATA_OUT;
+            }
+
+            memcpy(&dev->Setup, &bus->Ctrl.Setup, sizeof(dev->Setup));
+            USBD_SetupCallback(dev);
+            break;
+        }
+
+        case SIM_CTRL_DATA_IN:
+        case SIM_CTRL_DATA_OUT:
+        {
+            uint8_t epAddr = (bus->Ctrl.Stage == SIM_CTRL_DATA_IN) ? 0x80 : 0x00;
+
+            hs = sim_transaction(bus, epAddr, &bus->Ctrl.Urb,
+                    &sim_pipeRef(bus, epAddr)->Stats);
+
+            if ((hs == SIM_ACK) && (bus->Ctrl.Urb.Status == USBD_SIM_DONE))
+            {
+                /* The status stage is in the opposite direction */
+                bus->Ctrl.Urb.Status = USBD_SIM_PENDING;
+                bus->Ctrl.Stage = (epAddr > 0x7F) ?
+                        SIM_CTRL_STATUS_OUT : SIM_CTRL_STATUS_IN;
+            }
+            break;
+        }
+
+        case SIM_CTRL_STATUS_IN:
+        case SIM_CTRL_STATUS_OUT:
+        {
+            uint8_t epAddr = (bus->Ctrl.Stage == SIM_CTRL_STATUS_IN) ? 0x80 : 0x00;
+
+            hs = sim_transaction(bus, epAddr, &zlp,
+                    &sim_pipeRef(bus, epAddr)->Stats);
+
+            if (hs == SIM_ACK)
+            {
+                bus->Ctrl.Urb.Status = USBD_SIM_DONE;
+                bus->Ctrl.Urb.Completed_ns = sim_now(bus);
+            }
+            else if (hs != SIM_NAK)
+            {
+                bus->Ctrl.Urb.Status = zlp.Status;
+            }
+            break;
+        }
+
+        default:
+            break;
+    }
+
+    /* Any failure terminates the control transfer */
+    if ((hs == SIM_STALL) || (hs == SIM_NO_RESPONSE) ||
+        (bus->Ctrl.Urb.Status != USBD_SIM_PENDING))
+    {
+        bus->Ctrl.Stage = SIM_CTRL_IDLE;
+    }
+    return hs;
+}
+
+/**
+ * @brief Simulates a single (micro)frame of bus activity:
+ *         - Periodic endpoints are polled first when their interval has elapsed
+ *         - Control and bulk transfers share the remaining time in round-robin order
+ * @param bus: simulated bus reference
+ */
+static void sim_frame(USBD_SimBusType *bus)
+{
+    uint32_t frameLen, periodicLen;
+    uint8_t i, pipeCount = 2 * (USBD_MAX_EP_COUNT - 1);
+
+    if (bus->Speed == USB_SPEED_HIGH)
+    {
+        frameLen    = SIM_HS_FRAME_NS;
+        periodicLen = SIM_HS_PERIODIC_NS;
+        bus->FrameTime_ns = SIM_HS_SOF_NS;
+    }
+    else
+    {
+        frameLen    = SIM_FS_FRAME_NS;
+        periodicLen = SIM_FS_PERIODIC_NS;
+        bus->FrameTime_ns = SIM_FS_SOF_NS;
+    }
+
+#if (USBD_DEFERRED_EVENTS == 1)
+    /* The device's thread runs once in each (micro)frame */
+    (void) USBD_Process(bus->Device);
+#endif
+
+    if (bus->Attached != 0)
+    {
+        uint8_t progress = 1;
+
+        /* Periodic transfers are serviced at the start of the frame */
+        for (i = 0; i < pipeCount; i++)
+        {
+            uint8_t epAddr = (i / 2 + 1) | ((i & 1) << 7);
+            USBD_SimEpType *pipe = sim_pipeRef(bus, epAddr);
+            USBD_EpHandleType *ep = sim_epRef(bus->Device, epAddr);
+
+            if ((pipe->Interval > 0) &&
+                (pipe->Urb != NULL) && (pipe->Urb->Status == USBD_SIM_PENDING) &&
+                ((int32_t)(bus->Frame - pipe->NextFrame) >= 0) &&
+                ((bus->FrameTime_ns + sim_transactionTime(bus, ep->Type,
+                        ep->MaxPacketSize)) <= periodicLen))
+            {
+                pipe->NextFrame = bus->Frame + pipe->Interval;
+                (void) sim_transaction(bus, epAddr, pipe->Urb, &pipe->Stats);
+            }
+        }
+
+        /* Non-periodic transfers use the rest until nothing progresses */
+        while (progress != 0)
+        {
+            progress = 0;
+
+            if ((bus->Ctrl.Stage != SIM_CTRL_IDLE) &&
+                ((bus->FrameTime_ns + sim_transactionTime(bus,
+                        USB_EP_TYPE_CONTROL, bus->Device->EP.IN[0].MaxPacketSize))
+                        <= frameLen))
+            {
+                if (sim_ctrlTransaction(bus) == SIM_ACK)
+                {
+                    progress = 1;
+                }
+            }
+
+            for (i = 0; i < pipeCount; i++)
+            {
+                uint8_t index = (bus->RoundRobin + i) % pipeCount;
+                uint8_t epAddr = (index / 2 + 1) | ((index & 1) << 7);
+                USBD_SimEpType *pipe = sim_pipeRef(bus, epAddr);
+                USBD_EpHandleType *ep = sim_epRef(bus->Device, epAddr);
+
+                if ((pipe->Interval == 0) &&
+                    (pipe->Urb != NULL) && (pipe->Urb->Status == USBD_SIM_PENDING) &&
+                    ((bus->FrameTime_ns + sim_transactionTime(bus, ep->Type,
+                            ep->MaxPacketSize)) <= frameLen))
+                {
+                    if (sim_transaction(bus, epAddr, pipe->Urb, &pipe->Stats) == SIM_ACK)
+                    {
+                        progress = 1;
+                    }
+                }
+            }
+        }
+        bus->RoundRobin = (bus->RoundRobin + 1) % pipeCount;
+    }
+
+    bus->Time_ns += frameLen;
+    bus->FrameTime_ns = 0;
+    bus->Frame++;
+}
+
+/**
+ * @brief Learns the polling intervals of the periodic endpoints
+ *        from the configuration descriptor.
+ * @param bus: simulated bus reference
+ * @param desc: configuration descriptor
+ * @param len: length of the descriptor
+ */
+static void sim_parseConfig(USBD_SimBusType *bus, const uint8_t *desc, uint16_t len)
+{
+    uint16_t i;
+
+    for (i = 0; ((i + 2) <= len) && (desc[i] >= 2); i += desc[i])
+    {
+        if ((desc[i + 1] == USB_DESC_TYPE_ENDPOINT) && (desc[i] >= 7))
+        {
+            uint8_t type = desc[i + 3] & 3, bInterval = desc[i + 6];
+            uint16_t interval = 0;
+
+            if ((type == USB_EP_TYPE_ISOCHRONOUS) ||
+               ((type == USB_EP_TYPE_INTERRUPT) && (bus->Speed == USB_SPEED_HIGH)))
+            {
+                if (bInterval < 1)  { bInterval = 1; }
+                if (bInterval > 16) { bInterval = 16; }
+                interval = 1 << (bInterval - 1);
+            }
+            else if (type == USB_EP_TYPE_INTERRUPT)
+            {
+                interval = (bInterval > 0) ? bInterval : 1;
+            }
+            USBD_SIM_SetInterval(bus, desc[i + 2], interval);
+        }
+    }
+}
+
+static void sim_setup(USB_SetupRequestType *setup, uint8_t bmRequestType,
+        uint8_t bRequest, uint16_t wValue, uint16_t wIndex, uint16_t wLength)
+{
+    setup->RequestType.b = bmRequestType;
+    setup->Request       = bRequest;
+    setup->Value         = wValue;
+    setup->Index         = wIndex;
+    setup->Length        = wLength;
+}
+
+/** @} */
+
+/** @defgroup USBD_SIM_Exported_Functions Simulation Exported Functions
+ * @brief These functions are called by the host script.
+ * @{ */
+
+/**
+ * @brief Initializes the simulated bus and binds the device to it.
+ * @param bus: simulated bus reference
+ * @param dev: USB Device handle reference
+ */
+void USBD_SIM_Init(USBD_SimBusType *bus, USBD_HandleType *dev)
+{
+    memset(bus, 0, sizeof(*bus));
+    bus->Device = dev;
+    bus->Speed  = USB_SPEED_FULL;
+    dev->Bus    = bus;
+}
+
+/**
+ * @brief Signals bus reset to the attached device, which resets
+ *        the device address and all host pipes.
+ * @param bus: simulated bus reference
+ * @param speed: the speed negotiated during the reset
+ */
+void USBD_SIM_Reset(USBD_SimBusType *bus, USB_SpeedType speed)
+{
+    uint8_t i;
+
+    bus->Speed   = speed;
+    bus->Address = 0;
+    bus->Ctrl.Stage = SIM_CTRL_IDLE;
+    for (i = 0; i < USBD_MAX_EP_COUNT; i++)
+    {
+        bus->IN [i].Urb = NULL;
+        bus->IN [i].Interval = 0;
+        bus->OUT[i].Urb = NULL;
+        bus->OUT[i].Interval = 0;
+    }
+
+    /* Reset signaling lasts at least 10 ms */
+    bus->Time_ns += 10 * SIM_FS_FRAME_NS;
+
+    if (bus->Attached != 0)
+    {
+        bus->Device->Address = 0;
+        USBD_ResetCallback(bus->Device, speed);
+    }
+}
+
+/**
+ * @brief Performs a complete control transfer on the default pipe.
+ * @param bus: simulated bus reference
+ * @param setup: the setup request to send
+ * @param data: the data stage buffer
+ * @param actual: the length of the completed data stage (optional)
+ * @return OK if the transfer completed, INVALID if the device stalled it,
+ *         ERROR if the device didn't respond, BUSY if a transfer is ongoing
+ */
+USBD_ReturnType USBD_SIM_Control(USBD_SimBusType *bus,
+        const USB_SetupRequestType *setup, void *data, uint16_t *actual)
+{
+    USBD_ReturnType retval = USBD_E_BUSY;
+    uint32_t i;
+
+    if (bus->Ctrl.Stage == SIM_CTRL_IDLE)
+    {
+        memcpy(&bus->Ctrl.Setup, setup, sizeof(bus->Ctrl.Setup));
+        bus->Ctrl.Urb.Data   = (uint8_t*)data;
+        bus->Ctrl.Urb.Length = setup->Length;
+        bus->Ctrl.Urb.Actual = 0;
+        bus->Ctrl.Urb.Status = USBD_SIM_PENDING;
+        bus->Ctrl.Urb.Submitted_ns = sim_now(bus);
+        bus->Ctrl.Stage = SIM_CTRL_SETUP;
+
+        for (i = 0; (bus->Ctrl.Stage != SIM_CTRL_IDLE) &&
+                    (i < USBD_SIM_CTRL_TIMEOUT); i++)
+        {
+            sim_frame(bus);
+        }
+        bus->Ctrl.Stage = SIM_CTRL_IDLE;
+
+        if (actual != NULL)
+        {
+            *actual = (uint16_t)bus->Ctrl.Urb.Actual;
+        }
+
+        switch (bus->Ctrl.Urb.Status)
+        {
+            case USBD_SIM_DONE:
+                retval = USBD_E_OK;
+                break;
+            case USBD_SIM_STALLED:
+                retval = USBD_E_INVALID;
+                break;
+            default:
+                retval = USBD_E_ERROR;
+                break;
+        }
+    }
+    return retval;
+}
+
+/**
+ * @brief Performs the standard enumeration sequence of a host:
+ *        reset, device descriptor, address assignment, configuration descriptor,
+ *        and the selection of the first configuration.
+ * @param bus: simulated bus reference
+ * @param speed: the speed negotiated during the reset
+ * @return OK if the device is configured, the failed transfer's result otherwise
+ */
+USBD_ReturnType USBD_SIM_Enumerate(USBD_SimBusType *bus, USB_SpeedType speed)
+{
+    USBD_ReturnType retval = USBD_E_ERROR;
+    USB_SetupRequestType setup;
+    uint8_t desc[USBD_SIM_DESC_SIZE];
+    uint16_t len = 0;
+
+    if (bus->Attached == 0)
+    {
+        return retval;
+    }
+
+    USBD_SIM_Reset(bus, speed);
+
+    sim_setup(&setup, 0x80, USB_REQ_GET_DESCRIPTOR, USB_DESC_TYPE_DEVICE << 8, 0, 64);
+    retval = USBD_SIM_Control(bus, &setup, desc, &len);
+    if (retval != USBD_E_OK)
+    {
+        return retval;
+    }
+
+    sim_setup(&setup, 0x00, USB_REQ_SET_ADDRESS, 1, 0, 0);
+    retval = USBD_SIM_Control(bus, &setup, NULL, NULL);
+    if (retval != USBD_E_OK)
+    {
+        return retval;
+    }
+    bus->Address = 1;
+
+    sim_setup(&setup, 0x80, USB_REQ_GET_DESCRIPTOR,
+            USB_DESC_TYPE_CONFIGURATION << 8, 0, sizeof(USB_ConfigDescType));
+    retval = USBD_SIM_Control(bus, &setup, desc, &len);
+    if ((retval != USBD_E_OK) || (len < sizeof(USB_ConfigDescType)))
+    {
+        return USBD_E_ERROR;
+    }
+
+    len = desc[2] | (desc[3] << 8);
+    if (len > sizeof(desc))
+    {
+        len = sizeof(desc);
+    }
+    sim_setup(&setup, 0x80, USB_REQ_GET_DESCRIPTOR,
+            USB_DESC_TYPE_CONFIGURATION << 8, 0, len);
+    retval = USBD_SIM_Control(bus, &setup, desc, &len);
+    if (retval != USBD_E_OK)
+    {
+        return retval;
+    }
+    sim_parseConfig(bus, desc, len);
+
+    sim_setup(&setup, 0x00, USB_REQ_SET_CONFIGURATION, desc[5], 0, 0);
+    return USBD_SIM_Control(bus, &setup, NULL, NULL);
+}
+
+/**
+ * @brief Submits a transfer request on a non-control host pipe.
+ * @param bus: simulated bus reference
+ * @param epAddr: endpoint address
+ * @param urb: the transfer request (Data and Length must be set)
+ * @return BUSY if the pipe has a pending request, OK if successful
+ */
+USBD_ReturnType USBD_SIM_Submit(USBD_SimBusType *bus, uint8_t epAddr,
+        USBD_SimUrbType *urb)
+{
+    USBD_ReturnType retval = USBD_E_BUSY;
+    USBD_SimEpType *pipe = sim_pipeRef(bus, epAddr);
+
+    if ((epAddr & 0xF) == 0)
+    {
+        retval = USBD_E_INVALID;
+    }
+    else if ((pipe->Urb == NULL) || (pipe->Urb->Status != USBD_SIM_PENDING))
+    {
+        urb->Actual = 0;
+        urb->Status = USBD_SIM_PENDING;
+        urb->Submitted_ns = sim_now(bus);
+        pipe->Urb = urb;
+        pipe->NextFrame = bus->Frame;
+        retval = USBD_E_OK;
+    }
+    return retval;
+}
+
+/**
+ * @brief Sets the polling interval of a host pipe.
+ * @param bus: simulated bus reference
+ * @param epAddr: endpoint address
+ * @param interval: polling interval in (micro)frames, 0 for non-periodic
+ */
+void USBD_SIM_SetInterval(USBD_SimBusType *bus, uint8_t epAddr, uint16_t interval)
+{
+    sim_pipeRef(bus, epAddr)->Interval = interval;
+}
+
+/**
+ * @brief Advances the bus time by the given number of (micro)frames.
+ * @param bus: simulated bus reference
+ * @param frames: number of (micro)frames to simulate
+ */
+void USBD_SIM_Run(USBD_SimBusType *bus, uint32_t frames)
+{
+    while (frames-- > 0)
+    {
+        sim_frame(bus);
+    }
+}
+
+/**
+ * @brief Advances the bus time until the transfer request is completed.
+ * @param bus: simulated bus reference
+ * @param urb: the submitted transfer request
+ * @param maxFrames: the maximal number of (micro)frames to simulate
+ * @return The state of the transfer request
+ */
+USBD_SimStatusType USBD_SIM_Wait(USBD_SimBusType *bus, USBD_SimUrbType *urb,
+        uint32_t maxFrames)
+{
+    while ((urb->Status == USBD_SIM_PENDING) && (maxFrames-- > 0))
+    {
+        sim_frame(bus);
+    }
+    return urb->Status;
+}
+
+/**
+ * @brief Returns the elapsed bus time.
+ * @param bus: simulated bus reference
+ * @return The bus time in nanoseconds
+ */
+uint64_t USBD_SIM_Time_ns(USBD_SimBusType *bus)
+{
+    return sim_now(bus);
+}
+
+/**
+ * @brief Returns the transfer statistics of a host pipe.
+ * @param bus: simulated bus reference
+ * @param epAddr: endpoint address
+ * @return Reference to the pipe's statistics
+ */
+const USBD_SimEpStatsType* USBD_SIM_GetStats(USBD_SimBusType *bus, uint8_t epAddr)
+{
+    return &sim_pipeRef(bus, epAddr)->Stats;
+}
+
+/** @} */
+
+/** @ingroup USBD_SIM
+ * @defgroup USBD_SIM_PD_Functions Simulated Peripheral Driver Functions
+ * @brief The @ref USBD_PD_Interface implementation of the simulation.
+ * @{ */
+
+void USBD_PD_Init(USBD_HandleType *dev, const USBD_ConfigurationType *conf)
+{
+    uint8_t i;
+
+    (void)conf;
+    for (i = 0; i < USBD_MAX_EP_COUNT; i++)
+    {
+        dev->EP.IN [i].Armed  = 0;
+        dev->EP.IN [i].Halted = 0;
+        dev->EP.OUT[i].Armed  = 0;
+        dev->EP.OUT[i].Halted = 0;
+    }
+    dev->Address = 0;
+    dev->LinkState = USB_LINK_STATE_OFF;
+}
+
+void USBD_PD_Deinit(USBD_HandleType *dev)
+{
+    USBD_PD_Stop(dev);
+}
+
+void USBD_PD_Start(USBD_HandleType *dev)
+{
+    dev->Bus->Attached = 1;
+    dev->LinkState = USB_LINK_STATE_ACTIVE;
+}
+
+void USBD_PD_Stop(USBD_HandleType *dev)
+{
+    dev->Bus->Attached = 0;
+    dev->LinkState = USB_LINK_STATE_OFF;
+}
+
+void USBD_PD_SetRemoteWakeup(USBD_HandleType *dev)
+{
+    dev->Bus->RemoteWakeup = 1;
+}
+
+void USBD_PD_ClearRemoteWakeup(USBD_HandleType *dev)
+{
+    dev->Bus->RemoteWakeup = 0;
+    dev->LinkState = USB_LINK_STATE_ACTIVE;
+}
+
+void USBD_PD_SetAddress(USBD_HandleType *dev, uint8_t addr)
+{
+    dev->Address = addr;
+}
+
+void USBD_PD_CtrlEpOpen(USBD_HandleType *dev)
+{
+    dev->EP.IN [0].Type   = USB_EP_TYPE_CONTROL;
+    dev->EP.IN [0].Armed  = 0;
+    dev->EP.IN [0].Halted = 0;
+    dev->EP.OUT[0].Type   = USB_EP_TYPE_CONTROL;
+    dev->EP.OUT[0].Armed  = 0;
+    dev->EP.OUT[0].Halted = 0;
+}
+
+void USBD_PD_EpOpen(USBD_HandleType *dev, uint8_t addr,
+        USB_EndPointType type, uint16_t mps)
+{
+    USBD_EpHandleType *ep = sim_epRef(dev, addr);
+
+    ep->Type          = type;
+    ep->MaxPacketSize = mps;
+    ep->Armed         = 0;
+    ep->Halted        = 0;
+}
+
+void USBD_PD_EpClose(USBD_HandleType *dev, uint8_t addr)
+{
+    sim_epRef(dev, addr)->Armed = 0;
+}
+
+void USBD_PD_EpSend(USBD_HandleType *dev, uint8_t addr,
+        const uint8_t *data, USBD_LengthType len)
+{
+    USBD_EpHandleType *ep = sim_epRef(dev, addr);
+
+    ep->Transfer.Data     = (uint8_t*)data;
+    ep->Transfer.Length   = len;
+    ep->Transfer.Progress = 0;
+    ep->Segment           = NULL;
+    ep->SegLeft           = len;
+    ep->Armed             = 1;
+}
+
+void USBD_PD_EpReceive(USBD_HandleType *dev, uint8_t addr,
+        uint8_t *data, USBD_LengthType len)
+{
+    USBD_EpHandleType *ep = sim_epRef(dev, addr);
+
+    ep->Transfer.Data     = data;
+    ep->Transfer.Length   = len;
+    ep->Transfer.Progress = 0;
+    ep->Segment           = NULL;
+    ep->SegLeft           = len;
+    ep->Armed             = 1;
+}
+
+void USBD_PD_EpSendv(USBD_HandleType *dev, uint8_t addr,
+        const USBD_EpSegmentType *segs, uint8_t count)
+{
+    USBD_PD_EpReceivev(dev, addr, segs, count);
+}
+
+void USBD_PD_EpReceivev(USBD_HandleType *dev, uint8_t addr,
+        const USBD_EpSegmentType *segs, uint8_t count)
+{
+    USBD_EpHandleType *ep = sim_epRef(dev, addr);
+    uint32_t len = 0;
+    uint8_t i;
+
+    for (i = 0; i < count; i++)
+    {
+        len += segs[i].Length;
+    }
+
+    ep->Transfer.Data     = segs[0].Data;
+    ep->Transfer.Length   = len;
+    ep->Transfer.Progress = 0;
+    ep->Segment           = segs;
+    ep->SegLeft           = segs[0].Length;
+    ep->Armed             = 1;
+}
+
+void USBD_PD_EpSetStall(USBD_HandleType *dev, uint8_t addr)
+{
+    sim_epRef(dev, addr)->Halted = 1;
+}
+
+void USBD_PD_EpClearStall(USBD_HandleType *dev, uint8_t addr)
+{
+    sim_epRef(dev, addr)->Halted = 0;
+}
+
+void USBD_PD_EpFlush(USBD_HandleType *dev, uint8_t addr)
+{
+    sim_epRef(dev, addr)->Armed = 0;
+}
+
+/** @} */
@@ -0,0 +1,189 @@
+/**
+  ******************************************************************************
+  * @file    usbd_sim.h
+  * @author  Benedek Kupper
+  * @version 0.1
+  * @date    2018-12-30
+  * @brief   Universal Serial Bus Device Driver
+  *          Simulated USB 2.0 bus and scripted host model
+  *
+  * @details
+  * The simulated Peripheral Driver lets the complete device stack run
+  * as a host-native process. A scripted host model drives the device
+  * through the regular PD callbacks, while the bus is scheduled
+  * in 1 ms frames (Full-Speed) or 125 us microframes (High-Speed).
+  * Every transaction is charged with the bus time given by
+  * the USB 2.0 specification (5.11.3), so the achievable throughput
+  * of the mounted classes can be predicted:
+  *     @code
+  *     USBD_SimBusType bus;
+  *     USBD_HandleType dev;
+  *     USBD_SIM_Init(&bus, &dev);
+  *     USBD_Init(&dev, &dev_desc);
+  *     ...mount interfaces...
+  *     USBD_Connect(&dev);
+  *     USBD_SIM_Enumerate(&bus, USB_SPEED_HIGH);
+  *     @endcode
+  *
+  * Copyright (c) 2018 Benedek Kupper
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+#ifndef __USBD_SIM_H_
+#define __USBD_SIM_H_
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <usbd_types.h>
+
+/** @ingroup USBD
+ * @defgroup USBD_SIM Simulated Peripheral Driver
+ * @{ */
+
+/** @defgroup USBD_SIM_Exported_Macros Simulation Exported Macros
+ * @{ */
+
+#ifndef USBD_SIM_HOST_DELAY_NS
+/** @brief Host controller turnaround time added to each transaction */
+#define USBD_SIM_HOST_DELAY_NS          0
+#endif
+
+#ifndef USBD_SIM_CTRL_TIMEOUT
+/** @brief Number of (micro)frames after which a control transfer is abandoned */
+#define USBD_SIM_CTRL_TIMEOUT           5000
+#endif
+
+#ifndef USBD_SIM_DESC_SIZE
+/** @brief Size of the host's configuration descriptor buffer */
+#define USBD_SIM_DESC_SIZE              1024
+#endif
+
+/** @} */
+
+/** @defgroup USBD_SIM_Exported_Types Simulation Exported Types
+ * @{ */
+
+/** @brief Host transfer request states */
+typedef enum
+{
+    USBD_SIM_PENDING = 0,   /*!< The transfer is in progress */
+    USBD_SIM_DONE,          /*!< The transfer has completed */
+    USBD_SIM_STALLED,       /*!< The device has halted the endpoint */
+    USBD_SIM_NO_RESPONSE,   /*!< The device didn't respond on its address */
+}USBD_SimStatusType;
+
+
+/** @brief Host transfer request (the host model's view of an URB) */
+typedef struct
+{
+    uint8_t *Data;              /*!< Host data buffer */
+    uint32_t Length;            /*!< Requested transfer length */
+    uint32_t Actual;            /*!< Transferred length */
+    USBD_SimStatusType Status;  /*!< Transfer state */
+    uint64_t Submitted_ns;      /*!< Bus time at submission */
+    uint64_t Completed_ns;      /*!< Bus time at completion */
+}USBD_SimUrbType;
+
+
+/** @brief Host endpoint statistics */
+typedef struct
+{
+    uint32_t Transactions;      /*!< Number of completed data transactions */
+    uint32_t Naks;              /*!< Number of NAKed transactions */
+    uint64_t Bytes;             /*!< Number of transferred data bytes */
+    uint64_t BusTime_ns;        /*!< Bus time used by the endpoint */
+}USBD_SimEpStatsType;
+
+
+/** @brief Host endpoint context */
+typedef struct
+{
+    USBD_SimUrbType *Urb;       /*!< Current transfer request */
+    uint16_t Interval;          /*!< Polling interval in (micro)frames, 0 for non-periodic */
+    uint32_t NextFrame;         /*!< The next (micro)frame when the endpoint is polled */
+    USBD_SimEpStatsType Stats;  /*!< Transfer statistics */
+}USBD_SimEpType;
+
+
+/** @brief Simulated bus and host structure */
+typedef struct _USBD_SimBusType
+{
+    USBD_HandleType *Device;    /*!< The attached device */
+    uint64_t Time_ns;           /*!< Bus time at the start of the current (micro)frame */
+    uint32_t FrameTime_ns;      /*!< Bus time used within the current (micro)frame */
+    uint32_t Frame;             /*!< (Micro)frame counter */
+    USB_SpeedType Speed;        /*!< Bus speed selected at reset */
+    uint8_t Attached;           /*!< The device pull-up is active */
+    uint8_t Address;            /*!< The address used by the host */
+    uint8_t RemoteWakeup;       /*!< Remote wakeup signaling is active */
+    uint8_t RoundRobin;         /*!< Non-periodic scheduling start index */
+
+    struct {
+        USB_SetupRequestType Setup; /*!< Current setup request */
+        USBD_SimUrbType Urb;        /*!< Current control transfer */
+        uint8_t Stage;              /*!< Current control stage */
+    }Ctrl;                          /*!< Default control pipe */
+
+    USBD_SimEpType IN [USBD_MAX_EP_COUNT];  /*!< Host IN pipes */
+    USBD_SimEpType OUT[USBD_MAX_EP_COUNT];  /*!< Host OUT pipes */
+}USBD_SimBusType;
+
+/** @} */
+
+/** @addtogroup USBD_SIM_Exported_Functions
+ * @{ */
+void            USBD_SIM_Init           (USBD_SimBusType *bus,
+                                         USBD_HandleType *dev);
+
+void            USBD_SIM_Reset          (USBD_SimBusType *bus,
+                                         USB_SpeedType speed);
+
+USBD_ReturnType USBD_SIM_Enumerate      (USBD_SimBusType *bus,
+                                         USB_SpeedType speed);
+
+USBD_ReturnType USBD_SIM_Control        (USBD_SimBusType *bus,
+                                         const USB_SetupRequestType *setup,
+                                         void *data,
+                                         uint16_t *actual);
+
+USBD_ReturnType USBD_SIM_Submit         (USBD_SimBusType *bus,
+                                         uint8_t epAddr,
+                                         USBD_SimUrbType *urb);
+
+void            USBD_SIM_SetInterval    (USBD_SimBusType *bus,
+                                         uint8_t epAddr,
+                                         uint16_t interval);
+
+void            USBD_SIM_Run            (USBD_SimBusType *bus,
+                                         uint32_t frames);
+
+USBD_SimStatusType USBD_SIM_Wait        (USBD_SimBusType *bus,
+                                         USBD_SimUrbType *urb,
+                                         uint32_t maxFrames);
+
+uint64_t        USBD_SIM_Time_ns        (USBD_SimBusType *bus);
+
+const USBD_SimEpStatsType* USBD_SIM_GetStats(USBD_SimBusType *bus,
+                                         uint8_t epAddr);
+/** @} */
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __USBD_SIM_H_ */
@@ -0,0 +1,951 @@
+/**
+  ******************************************************************************
+  * @file    usbd_usbip.c
+  * @author  Benedek Kupper
+  * @version 0.1
+  * @date    2019-01-06
+  * @brief   Universal Serial Bus Device Driver
+  *          USB/IP server Peripheral Driver
+  *
+  * Copyright (c) 2019 Benedek Kupper
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+#include <usbd.h>
+#include <usbd_usbip.h>
+#include <usbd_pd_if.h>
+
+#include <errno.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+/** @ingroup USBD_USBIP
+ * @defgroup USBD_USBIP_Private_Functions USB/IP Private Functions
+ * @{ */
+
+/* USB/IP protocol constants */
+#define USBIP_VERSION               0x0111
+#define USBIP_OP_REQ_DEVLIST        0x8005
+#define USBIP_OP_REP_DEVLIST        0x0005
+#define USBIP_OP_REQ_IMPORT         0x8003
+#define USBIP_OP_REP_IMPORT         0x0003
+
+#define USBIP_CMD_SUBMIT            1
+#define USBIP_CMD_UNLINK            2
+#define USBIP_RET_SUBMIT            3
+#define USBIP_RET_UNLINK            4
+
+#define USBIP_HEADER_SIZE           48
+#define USBIP_DEVICE_SIZE           312
+#define USBIP_ISO_DESC_SIZE         16
+
+#define USBIP_URB_ZERO_PACKET       0x0040
+
+/* Linux usb_device_speed values */
+#define USBIP_SPEED_FULL            2
+#define USBIP_SPEED_HIGH            3
+
+/* Control transfer stages */
+enum
+{
+    USBIP_CTRL_SETUP = 0,
+    USBIP_CTRL_DATA_IN,
+    USBIP_CTRL_DATA_OUT,
+    USBIP_CTRL_STATUS_IN,
+    USBIP_CTRL_STATUS_OUT,
+};
+
+static void usbip_put16(uint8_t *dest, uint16_t value)
+{
+    dest[0] = value >> 8;
+    dest[1] = value;
+}
+
+static void usbip_put32(uint8_t *dest, uint32_t value)
+{
+    dest[0] = value >> 24;
+    dest[1] = value >> 16;
+    dest[2] = value >> 8;
+    dest[3] = value;
+}
+
+static uint32_t usbip_get32(const uint8_t *src)
+{
+    return ((uint32_t)src[0] << 24) | ((uint32_t)src[1] << 16) |
+           ((uint32_t)src[2] << 8)  |  (uint32_t)src[3];
+}
+
+static int usbip_read(int fd, void *data, size_t len)
+{
+    uint8_t *ptr = data;
+
+    while (len > 0)
+    {
+        ssize_t n = read(fd, ptr, len);
+        if (n <= 0)
+        {
+            if ((n < 0) && (errno == EINTR))
+            {
+                continue;
+            }
+            return -1;
+        }
+        ptr += n;
+        len -= n;
+    }
+    return 0;
+}
+
+static int usbip_write(int fd, const void *data, size_t len)
+{
+    const uint8_t *ptr = data;
+
+    while (len > 0)
+    {
+        ssize_t n = write(fd, ptr, len);
+        if (n <= 0)
+        {
+            if ((n < 0) && (errno == EINTR))
+            {
+                continue;
+            }
+            return -1;
+        }
+        ptr += n;
+        len -= n;
+    }
+    return 0;
+}
+
+static USBD_EpHandleType* usbip_epRef(USBD_HandleType *dev, uint8_t epAddr)
+{
+    return (epAddr > 0x7F) ? &dev->EP.IN[epAddr & 0xF] : &dev->EP.OUT[epAddr];
+}
+
+/* Control requests are queued on the OUT pipe of EP0 regardless of direction */
+static USBD_UsbipUrbType** usbip_queueRef(USBD_UsbipServerType *srv, uint8_t epAddr)
+{
+    if ((epAddr & 0xF) == 0)
+    {
+        return &srv->OUT[0];
+    }
+    return (epAddr > 0x7F) ? &srv->IN[epAddr & 0xF] : &srv->OUT[epAddr];
+}
+
+static void usbip_free(USBD_UsbipUrbType *urb)
+{
+    free(urb->Data);
+    free(urb);
+}
+
+/**
+ * @brief Moves the data between the transfer request and the armed device endpoint
+ *        and notifies the device when its transfer is completed.
+ * @param dev: USB Device handle reference
+ * @param epAddr: endpoint address
+ * @param urb: the transfer request
+ * @param done: set to 1 when the transfer request is completed
+ * @param status: set to the completion status
+ * @return 1 if any progress was made, 0 if the endpoint isn't ready
+ */
+static int usbip_transfer(USBD_HandleType *dev, uint8_t epAddr,
+        USBD_UsbipUrbType *urb, int *done, int *status)
+{
+    USBD_EpHandleType *ep = usbip_epRef(dev, epAddr);
+    uint32_t devRem, urbRem, n, mps = ep->MaxPacketSize;
+    int devDone;
+
+    *done = 0;
+    *status = 0;
+
+    if (ep->Halted != 0)
+    {
+        *done = 1;
+        *status = -EPIPE;
+        return 1;
+    }
+    if (ep->Armed == 0)
+    {
+        return 0;
+    }
+
+    devRem = ep->Transfer.Length - ep->Transfer.Progress;
+    urbRem = urb->Length - urb->Actual;
+    n = (devRem < urbRem) ? devRem : urbRem;
+
+    if (n > 0)
+    {
+        if (epAddr > 0x7F)
+        {
+            memcpy(&urb->Data[urb->Actual], ep->Transfer.Data, n);
+        }
+        else
+        {
+            memcpy(ep->Transfer.Data, &urb->Data[urb->Actual], n);
+        }
+    }
+    ep->Transfer.Data     += n;
+    ep->Transfer.Progress += n;
+    urb->Actual           += n;
+
+    if (epAddr > 0x7F)
+    {
+        /* A short (or zero length) last packet terminates the request */
+        devDone = ep->Transfer.Progress >= ep->Transfer.Length;
+        *done = (urb->Actual >= urb->Length) ||
+                (devDone && ((ep->Transfer.Length == 0) ||
+                             ((ep->Transfer.Length % mps) != 0)));
+    }
+    else
+    {
+        /* The host's short last packet terminates the device transfer */
+        *done = urb->Actual >= urb->Length;
+        devDone = (ep->Transfer.Progress >= ep->Transfer.Length) ||
+                  (*done && ((urb->Length == 0) || ((urb->Length % mps) != 0) ||
+                             ((urb->Flags & USBIP_URB_ZERO_PACKET) != 0)));
+    }
+
+    if (devDone)
+    {
+        ep->Armed = 0;
+        ep->Transfer.Length = ep->Transfer.Progress;
+
+        if (epAddr > 0x7F)
+        {
+            USBD_EpInCallback(dev, ep);
+        }
+        else
+        {
+            USBD_EpOutCallback(dev, ep);
+        }
+    }
+    return 1;
+}
+
+/**
+ * @brief Advances a control transfer request through its stages.
+ * @param dev: USB Device handle reference
+ * @param urb: the control transfer request
+ * @param done: set to 1 when the transfer request is completed
+ * @param status: set to the completion status
+ * @return 1 if any progress was made, 0 if the device isn't ready
+ */
+static int usbip_control(USBD_HandleType *dev, USBD_UsbipUrbType *urb,
+        int *done, int *status)
+{
+    USBD_UsbipUrbType zlp;
+    int progress = 0;
+
+    *done = 0;
+    *status = 0;
+
+    switch (urb->Stage)
+    {
+        case USBIP_CTRL_SETUP:
+        {
+            uint16_t wLength = urb->Setup[6] | (urb->Setup[7] << 8);
+
+            /* SETUP is always accepted, and it cancels the previous transfer */
+            dev->EP.IN [0].Armed  = 0;
+            dev->EP.IN [0].Halted = 0;
+            dev->EP.OUT[0].Armed  = 0;
+            dev->EP.OUT[0].Halted = 0;
+
+            if (urb->Length > wLength)
+            {
+                urb->Length = wLength;
+            }
+            if (wLength == 0)
+            {
+                urb->Stage = USBIP_CTRL_STATUS_IN;
+            }
+            else if ((urb->Setup[0] & 0x80) != 0)
+            {
+                urb->Stage = USBIP_CTRL_DATA_IN;
+            }
+            else
+            {
+                urb->Stage = USBIP_CTRL_DATA_OUT;
+            }
+
+            /* The wire format is decoded field by field,
+             * as the structure's layout depends on the enum size */
+            dev->Setup.RequestType.b = urb->Setup[0];
+            dev->Setup.Request       = urb->Setup[1];
+            dev->Setup.Value         = urb->Setup[2] | (urb->Setup[3] << 8);
+            dev->Setup.Index         = urb->Setup[4] | (urb->Setup[5] << 8);
+            dev->Setup.Length        = wLength;
+            USBD_SetupCallback(dev);
+            progress = 1;
+            break;
+        }
+
+        case USBIP_CTRL_DATA_IN:
+        case USBIP_CTRL_DATA_OUT:
+        {
+            uint8_t epAddr = (urb->Stage == USBIP_CTRL_DATA_IN) ? 0x80 : 0x00;
+
+            progress = usbip_transfer(dev, epAddr, urb, done, status);
+            if ((*done != 0) && (*status == 0))
+            {
+                /* The status stage is in the opposite direction */
+                *done = 0;
+                urb->Stage = (epAddr > 0x7F) ?
+                        USBIP_CTRL_STATUS_OUT : USBIP_CTRL_STATUS_IN;
+            }
+            break;
+        }
+
+        case USBIP_CTRL_STATUS_IN:
+        case USBIP_CTRL_STATUS_OUT:
+        {
+            uint8_t epAddr = (urb->Stage == USBIP_CTRL_STATUS_IN) ? 0x80 : 0x00;
+
+            memset(&zlp, 0, sizeof(zlp));
+            progress = usbip_transfer(dev, epAddr, &zlp, done, status);
+            break;
+        }
+
+        default:
+            break;
+    }
+    return progress;
+}
+
+/**
+ * @brief Reports the completion of the first request of a queue to the client.
+ * @param srv: USB/IP server reference
+ * @param queue: the request queue
+ * @param status: the completion status
+ * @return 0 if successful, -1 if the connection is broken
+ */
+static int usbip_complete(USBD_UsbipServerType *srv, USBD_UsbipUrbType **queue,
+        int status)
+{
+    USBD_UsbipUrbType *urb = *queue;
+    uint8_t header[USBIP_HEADER_SIZE];
+    int retval;
+
+    *queue = urb->Next;
+
+    memset(header, 0, sizeof(header));
+    usbip_put32(&header[0],  USBIP_RET_SUBMIT);
+    usbip_put32(&header[4],  urb->SeqNum);
+    usbip_put32(&header[20], (uint32_t)status);
+    usbip_put32(&header[24], urb->Actual);
+
+    retval = usbip_write(srv->ConnFd, header, sizeof(header));
+    if ((retval == 0) && ((urb->EpAddr & 0x80) != 0) && (urb->Actual > 0))
+    {
+        retval = usbip_write(srv->ConnFd, urb->Data, urb->Actual);
+    }
+
+    usbip_free(urb);
+    return retval;
+}
+
+/**
+ * @brief Processes the pending requests of all endpoints
+ *        until no more progress can be made.
+ * @param srv: USB/IP server reference
+ * @return 0 if successful, -1 if the connection is broken
+ */
+static int usbip_process(USBD_UsbipServerType *srv)
+{
+    USBD_HandleType *dev = srv->Device;
+    int progress = 1;
+
+    while ((progress != 0) && (srv->Imported != 0))
+    {
+        int done, status;
+        uint8_t i;
+
+        progress = 0;
+#if (USBD_DEFERRED_EVENTS == 1)
+        progress |= (USBD_Process(dev) > 0);
+#endif
+
+        if (srv->OUT[0] != NULL)
+        {
+            progress |= usbip_control(dev, srv->OUT[0], &done, &status);
+            if ((done != 0) && (usbip_complete(srv, &srv->OUT[0], status) < 0))
+            {
+                return -1;
+            }
+        }
+
+        for (i = 1; i < USBD_MAX_EP_COUNT; i++)
+        {
+            if (srv->IN[i] != NULL)
+            {
+                progress |= usbip_transfer(dev, 0x80 | i, srv->IN[i], &done, &status);
+                if ((done != 0) && (usbip_complete(srv, &srv->IN[i], status) < 0))
+                {
+                    return -1;
+                }
+            }
+            if (srv->OUT[i] != NULL)
+            {
+                progress |= usbip_transfer(dev, i, srv->OUT[i], &done, &status);
+                if ((done != 0) && (usbip_complete(srv, &srv->OUT[i], status) < 0))
+                {
+                    return -1;
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Performs a control transfer on the device without a client,
+ *        used to read the descriptors for the device listing.
+ * @return The length of the data stage, or -1 if the request failed
+ */
+static int usbip_localControl(USBD_UsbipServerType *srv, uint8_t bmRequestType,
+        uint8_t bRequest, uint16_t wValue, uint8_t *data, uint16_t wLength)
+{
+    USBD_UsbipUrbType urb;
+    int done = 0, status = 0;
+
+    memset(&urb, 0, sizeof(urb));
+    urb.Setup[0] = bmRequestType;
+    urb.Setup[1] = bRequest;
+    urb.Setup[2] = wValue;
+    urb.Setup[3] = wValue >> 8;
+    urb.Setup[6] = wLength;
+    urb.Setup[7] = wLength >> 8;
+    urb.Data     = data;
+    urb.Length   = wLength;
+
+    while (done == 0)
+    {
+        int progress = usbip_control(srv->Device, &urb, &done, &status);
+#if (USBD_DEFERRED_EVENTS == 1)
+        progress |= (USBD_Process(srv->Device) > 0);
+#endif
+        if (progress == 0)
+        {
+            break;
+        }
+    }
+    return ((done != 0) && (status == 0)) ? (int)urb.Actual : -1;
+}
+
+/**
+ * @brief Fills the USB/IP device description, with the interface list appended.
+ * @param srv: USB/IP server reference
+ * @param dest: the destination buffer
+ * @param withIfs: whether the interface list is needed
+ * @return The length of the description, or -1 if the descriptors cannot be read
+ */
+static int usbip_describe(USBD_UsbipServerType *srv, uint8_t *dest, int withIfs)
+{
+    uint8_t devDesc[sizeof(USB_DeviceDescType)];
+    uint8_t *cfgDesc = malloc(0x10000);
+    int len = USBIP_DEVICE_SIZE, cfgLen, i;
+
+    if ((cfgDesc == NULL) ||
+        (usbip_localControl(srv, 0x80, USB_REQ_GET_DESCRIPTOR,
+            USB_DESC_TYPE_DEVICE << 8, devDesc, sizeof(devDesc)) < (int)sizeof(devDesc)) ||
+        ((cfgLen = usbip_localControl(srv, 0x80, USB_REQ_GET_DESCRIPTOR,
+            USB_DESC_TYPE_CONFIGURATION << 8, cfgDesc, 0xFFFF)) < (int)sizeof(USB_ConfigDescType)))
+    {
+        free(cfgDesc);
+        return -1;
+    }
+
+    memset(dest, 0, USBIP_DEVICE_SIZE);
+    strncpy((char*)&dest[0], "/sys/devices/platform/usbd/" USBD_USBIP_BUSID, 255);
+    strncpy((char*)&dest[256], USBD_USBIP_BUSID, 31);
+    usbip_put32(&dest[288], 1);
+    usbip_put32(&dest[292], 1);
+    usbip_put32(&dest[296], (srv->Speed == USB_SPEED_HIGH) ?
+            USBIP_SPEED_HIGH : USBIP_SPEED_FULL);
+    usbip_put16(&dest[300], devDesc[8]  | (devDesc[9]  << 8));
+    usbip_put16(&dest[302], devDesc[10] | (devDesc[11] << 8));
+    usbip_put16(&dest[304], devDesc[12] | (devDesc[13] << 8));
+    dest[306] = devDesc[4];
+    dest[307] = devDesc[5];
+    dest[308] = devDesc[6];
+    dest[309] = srv->Device->ConfigSelector;
+    dest[310] = devDesc[17];
+    dest[311] = cfgDesc[4];
+
+    /* The class triplet of each interface's default setting */
+    for (i = 0; withIfs && ((i + 2) <= cfgLen) && (cfgDesc[i] >= 2); i += cfgDesc[i])
+    {
+        if ((cfgDesc[i + 1] == USB_DESC_TYPE_INTERFACE) && (cfgDesc[i + 3] == 0))
+        {
+            dest[len++] = cfgDesc[i + 5];
+            dest[len++] = cfgDesc[i + 6];
+            dest[len++] = cfgDesc[i + 7];
+            dest[len++] = 0;
+        }
+    }
+
+    free(cfgDesc);
+    return len;
+}
+
+/**
+ * @brief Releases all pending requests and deconfigures the device.
+ * @param srv: USB/IP server reference
+ */
+static void usbip_disconnect(USBD_UsbipServerType *srv)
+{
+    uint8_t i;
+
+    for (i = 0; i < USBD_MAX_EP_COUNT; i++)
+    {
+        while (srv->IN[i] != NULL)
+        {
+            USBD_UsbipUrbType *urb = srv->IN[i];
+            srv->IN[i] = urb->Next;
+            usbip_free(urb);
+        }
+        while (srv->OUT[i] != NULL)
+        {
+            USBD_UsbipUrbType *urb = srv->OUT[i];
+            srv->OUT[i] = urb->Next;
+            usbip_free(urb);
+        }
+    }
+
+    close(srv->ConnFd);
+    srv->ConnFd = -1;
+
+    if (srv->Imported != 0)
+    {
+        srv->Imported = 0;
+        USBD_ResetCallback(srv->Device, srv->Speed);
+    }
+}
+
+/**
+ * @brief Handles the operation requests before the device is imported.
+ * @param srv: USB/IP server reference
+ * @return 0 if successful, -1 if the connection shall be closed
+ */
+static int usbip_operation(USBD_UsbipServerType *srv)
+{
+    uint8_t req[8 + 32], rep[8 + 4 + USBIP_DEVICE_SIZE + 4 * 32];
+    uint16_t code;
+    int len;
+
+    if (usbip_read(srv->ConnFd, req, 8) < 0)
+    {
+        return -1;
+    }
+    code = (req[2] << 8) | req[3];
+
+    memset(rep, 0, sizeof(rep));
+    usbip_put16(&rep[0], USBIP_VERSION);
+
+    if (code == USBIP_OP_REQ_DEVLIST)
+    {
+        usbip_put16(&rep[2], USBIP_OP_REP_DEVLIST);
+
+        /* Always a single device is exported */
+        USBD_ResetCallback(srv->Device, srv->Speed);
+        len = (srv->Attached != 0) ? usbip_describe(srv, &rep[12], 1) : -1;
+        if (len > 0)
+        {
+            usbip_put32(&rep[8], 1);
+            (void) usbip_write(srv->ConnFd, rep, 12 + len);
+        }
+        else
+        {
+            (void) usbip_write(srv->ConnFd, rep, 12);
+        }
+        /* The listing connection is closed after the reply */
+        return -1;
+    }
+    else if (code == USBIP_OP_REQ_IMPORT)
+    {
+        usbip_put16(&rep[2], USBIP_OP_REP_IMPORT);
+
+        if (usbip_read(srv->ConnFd, &req[8], 32) < 0)
+        {
+            return -1;
+        }
+        req[8 + 31] = '\0';
+
+        USBD_ResetCallback(srv->Device, srv->Speed);
+        len = ((srv->Attached != 0) &&
+               (strcmp((const char*)&req[8], USBD_USBIP_BUSID) == 0)) ?
+                usbip_describe(srv, &rep[8], 0) : -1;
+        if (len > 0)
+        {
+            srv->Imported = 1;
+            return usbip_write(srv->ConnFd, rep, 8 + len);
+        }
+        else
+        {
+            usbip_put32(&rep[4], 1);
+            (void) usbip_write(srv->ConnFd, rep, 8);
+            return -1;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Handles the URB commands of the client after the import.
+ * @param srv: USB/IP server reference
+ * @return 0 if successful, -1 if the connection shall be closed
+ */
+static int usbip_command(USBD_UsbipServerType *srv)
+{
+    uint8_t header[USBIP_HEADER_SIZE];
+    uint32_t command, seqNum;
+
+    if (usbip_read(srv->ConnFd, header, sizeof(header)) < 0)
+    {
+        return -1;
+    }
+    command = usbip_get32(&header[0]);
+    seqNum  = usbip_get32(&header[4]);
+
+    if (command == USBIP_CMD_SUBMIT)
+    {
+        uint32_t dir = usbip_get32(&header[12]), epNum = usbip_get32(&header[16]);
+        uint32_t isoCount = usbip_get32(&header[32]);
+        USBD_UsbipUrbType *urb, **queue;
+
+        urb = calloc(1, sizeof(*urb));
+        if (urb == NULL)
+        {
+            return -1;
+        }
+        urb->SeqNum = seqNum;
+        urb->Flags  = usbip_get32(&header[20]);
+        urb->Length = usbip_get32(&header[24]);
+        urb->EpAddr = (epNum & 0xF) | ((dir != 0) ? 0x80 : 0);
+        urb->Stage  = USBIP_CTRL_SETUP;
+        memcpy(urb->Setup, &header[40], sizeof(urb->Setup));
+        urb->Data = malloc(urb->Length + 1);
+
+        if ((urb->Data == NULL) || (epNum >= USBD_MAX_EP_COUNT) ||
+            ((dir == 0) && (usbip_read(srv->ConnFd, urb->Data, urb->Length) < 0)))
+        {
+            usbip_free(urb);
+            return -1;
+        }
+
+        /* Isochronous transfers are not supported */
+        if ((isoCount != 0) && (isoCount != 0xFFFFFFFF))
+        {
+            uint8_t isoDesc[USBIP_ISO_DESC_SIZE];
+
+            while (isoCount-- > 0)
+            {
+                if (usbip_read(srv->ConnFd, isoDesc, sizeof(isoDesc)) < 0)
+                {
+                    usbip_free(urb);
+                    return -1;
+                }
+            }
+            urb->Next = NULL;
+            queue = &urb;
+            return usbip_complete(srv, queue, -EINVAL);
+        }
+
+        /* Append to the endpoint's queue */
+        for (queue = usbip_queueRef(srv, urb->EpAddr); *queue != NULL;
+             queue = &(*queue)->Next)
+        {
+        }
+        *queue = urb;
+    }
+    else if (command == USBIP_CMD_UNLINK)
+    {
+        uint32_t unlinkNum = usbip_get32(&header[20]);
+        int status = 0;
+        uint8_t i;
+
+        /* Remove the request if it's still pending */
+        for (i = 0; (i < 2 * USBD_MAX_EP_COUNT) && (status == 0); i++)
+        {
+            USBD_UsbipUrbType **queue = (i < USBD_MAX_EP_COUNT) ?
+                    &srv->IN[i] : &srv->OUT[i - USBD_MAX_EP_COUNT];
+
+            for (; *queue != NULL; queue = &(*queue)->Next)
+            {
+                if ((*queue)->SeqNum == unlinkNum)
+                {
+                    USBD_UsbipUrbType *urb = *queue;
+                    *queue = urb->Next;
+                    usbip_free(urb);
+                    status = -ECONNRESET;
+                    break;
+                }
+            }
+        }
+
+        memset(header, 0, sizeof(header));
+        usbip_put32(&header[0],  USBIP_RET_UNLINK);
+        usbip_put32(&header[4],  seqNum);
+        usbip_put32(&header[20], (uint32_t)status);
+        return usbip_write(srv->ConnFd, header, sizeof(header));
+    }
+    else
+    {
+        return -1;
+    }
+    return 0;
+}
+
+/** @} */
+
+/** @defgroup USBD_USBIP_Exported_Functions USB/IP Exported Functions
+ * @{ */
+
+/**
+ * @brief Creates the USB/IP server listening on the loopback interface.
+ * @param srv: USB/IP server reference
+ * @param dev: USB Device handle reference
+ * @param port: TCP port to listen on (@ref USBD_USBIP_PORT by default)
+ * @param speed: the speed reported to the host
+ * @return OK if the server is listening, ERROR otherwise
+ */
+USBD_ReturnType USBD_USBIP_Init(USBD_UsbipServerType *srv, USBD_HandleType *dev,
+        uint16_t port, USB_SpeedType speed)
+{
+    struct sockaddr_in addr;
+    int opt = 1;
+
+    memset(srv, 0, sizeof(*srv));
+    srv->Device = dev;
+    srv->Speed  = speed;
+    srv->ConnFd = -1;
+    dev->Server = srv;
+
+    srv->ListenFd = socket(AF_INET, SOCK_STREAM, 0);
+    if (srv->ListenFd < 0)
+    {
+        return USBD_E_ERROR;
+    }
+    (void) setsockopt(srv->ListenFd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family      = AF_INET;
+    addr.sin_port        = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if ((bind(srv->ListenFd, (struct sockaddr*)&addr, sizeof(addr)) < 0) ||
+        (listen(srv->ListenFd, 1) < 0))
+    {
+        close(srv->ListenFd);
+        srv->ListenFd = -1;
+        return USBD_E_ERROR;
+    }
+    return USBD_E_OK;
+}
+
+/**
+ * @brief Closes the USB/IP server and its client connection.
+ * @param srv: USB/IP server reference
+ */
+void USBD_USBIP_Deinit(USBD_UsbipServerType *srv)
+{
+    if (srv->ConnFd >= 0)
+    {
+        usbip_disconnect(srv);
+    }
+    if (srv->ListenFd >= 0)
+    {
+        close(srv->ListenFd);
+        srv->ListenFd = -1;
+    }
+}
+
+/**
+ * @brief Serves the client and the device: accepts a connection,
+ *        processes the received commands and the endpoint transfers.
+ *        The device callbacks are made from this context.
+ * @param srv: USB/IP server reference
+ * @param timeout_ms: maximal time to wait for network activity
+ * @return OK if successful, ERROR if the server cannot operate
+ */
+USBD_ReturnType USBD_USBIP_Poll(USBD_UsbipServerType *srv, int timeout_ms)
+{
+    struct pollfd pfd;
+    int n;
+
+    /* Transfers armed by the application since the last call */
+    if (usbip_process(srv) < 0)
+    {
+        usbip_disconnect(srv);
+    }
+
+    pfd.fd      = (srv->ConnFd >= 0) ? srv->ConnFd : srv->ListenFd;
+    pfd.events  = POLLIN;
+    pfd.revents = 0;
+
+    n = poll(&pfd, 1, timeout_ms);
+    if (n < 0)
+    {
+        return (errno == EINTR) ? USBD_E_OK : USBD_E_ERROR;
+    }
+    else if (n == 0)
+    {
+    }
+    else if (srv->ConnFd < 0)
+    {
+        int opt = 1;
+
+        srv->ConnFd = accept(srv->ListenFd, NULL, NULL);
+        if (srv->ConnFd >= 0)
+        {
+            (void) setsockopt(srv->ConnFd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+        }
+    }
+    else if (((srv->Imported == 0) ? usbip_operation(srv) : usbip_command(srv)) < 0)
+    {
+        usbip_disconnect(srv);
+    }
+
+    if (usbip_process(srv) < 0)
+    {
+        usbip_disconnect(srv);
+    }
+    return USBD_E_OK;
+}
+
+/** @} */
+
+/** @ingroup USBD_USBIP
+ * @defgroup USBD_USBIP_PD_Functions USB/IP Peripheral Driver Functions
+ * @brief The @ref USBD_PD_Interface implementation of the USB/IP server.
+ * @{ */
+
+void USBD_PD_Init(USBD_HandleType *dev, const USBD_ConfigurationType *conf)
+{
+    uint8_t i;
+
+    (void)conf;
+    for (i = 0; i < USBD_MAX_EP_COUNT; i++)
+    {
+        dev->EP.IN [i].Armed  = 0;
+        dev->EP.IN [i].Halted = 0;
+        dev->EP.OUT[i].Armed  = 0;
+        dev->EP.OUT[i].Halted = 0;
+    }
+    dev->LinkState = USB_LINK_STATE_OFF;
+}
+
+void USBD_PD_Deinit(USBD_HandleType *dev)
+{
+    USBD_PD_Stop(dev);
+}
+
+void USBD_PD_Start(USBD_HandleType *dev)
+{
+    dev->Server->Attached = 1;
+    dev->LinkState = USB_LINK_STATE_ACTIVE;
+}
+
+void USBD_PD_Stop(USBD_HandleType *dev)
+{
+    dev->Server->Attached = 0;
+    dev->LinkState = USB_LINK_STATE_OFF;
+}
+
+void USBD_PD_SetRemoteWakeup(USBD_HandleType *dev)
+{
+    (void)dev;
+}
+
+void USBD_PD_ClearRemoteWakeup(USBD_HandleType *dev)
+{
+    (void)dev;
+}
+
+void USBD_PD_SetAddress(USBD_HandleType *dev, uint8_t addr)
+{
+    /* The address is assigned by the virtual host controller */
+    (void)dev;
+    (void)addr;
+}
+
+void USBD_PD_CtrlEpOpen(USBD_HandleType *dev)
+{
+    dev->EP.IN [0].Type   = USB_EP_TYPE_CONTROL;
+    dev->EP.IN [0].Armed  = 0;
+    dev->EP.IN [0].Halted = 0;
+    dev->EP.OUT[0].Type   = USB_EP_TYPE_CONTROL;
+    dev->EP.OUT[0].Armed  = 0;
+    dev->EP.OUT[0].Halted = 0;
+}
+
+void USBD_PD_EpOpen(USBD_HandleType *dev, uint8_t addr,
+        USB_EndPointType type, uint16_t mps)
+{
+    USBD_EpHandleType *ep = usbip_epRef(dev, addr);
+
+    ep->Type          = type;
+    ep->MaxPacketSize = mps;
+    ep->Armed         = 0;
+    ep->Halted        = 0;
+}
+
+void USBD_PD_EpClose(USBD_HandleType *dev, uint8_t addr)
+{
+    usbip_epRef(dev, addr)->Armed = 0;
+}
+
+void USBD_PD_EpSend(USBD_HandleType *dev, uint8_t addr,
+        const uint8_t *data, USBD_LengthType len)
+{
+    USBD_EpHandleType *ep = usbip_epRef(dev, addr);
+
+    ep->Transfer.Data     = (uint8_t*)data;
+    ep->Transfer.Length   = len;
+    ep->Transfer.Progress = 0;
+    ep->Armed             = 1;
+}
+
+void USBD_PD_EpReceive(USBD_HandleType *dev, uint8_t addr,
+        uint8_t *data, USBD_LengthType len)
+{
+    USBD_EpHandleType *ep = usbip_epRef(dev, addr);
+
+    ep->Transfer.Data     = data;
+    ep->Transfer.Length   = len;
+    ep->Transfer.Progress = 0;
+    ep->Armed             = 1;
+}
+
+void USBD_PD_EpSetStall(USBD_HandleType *dev, uint8_t addr)
+{
+    usbip_epRef(dev, addr)->Halted = 1;
+}
+
+void USBD_PD_EpClearStall(USBD_HandleType *dev, uint8_t addr)
+{
+    usbip_epRef(dev, addr)->Halted = 0;
+}
+
+void USBD_PD_EpFlush(USBD_HandleType *dev, uint8_t addr)
+{
+    usbip_epRef(dev, addr)->Armed = 0;
+}
+
+/** @} */
@@ -0,0 +1,116 @@
+/**
+  ******************************************************************************
+  * @file    usbd_usbip.h
+  * @author  Benedek Kupper
+  * @version 0.1
+  * @date    2019-01-06
+  * @brief   Universal Serial Bus Device Driver
+  *          USB/IP server exporting the device
+  *
+  * @details
+  * This Peripheral Driver exports the USB device as a USB/IP device
+  * over a local TCP port, so the host's own class drivers can bind to it
+  * through the vhci_hcd virtual host controller:
+  *     @code
+  *     # modprobe vhci-hcd
+  *     # usbip attach -r 127.0.0.1 -b 1-1
+  *     @endcode
+  * The server is single-threaded, all device callbacks are made
+  * from the context of @ref USBD_USBIP_Poll.
+  *
+  * Copyright (c) 2019 Benedek Kupper
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+#ifndef __USBD_USBIP_H_
+#define __USBD_USBIP_H_
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <usbd_types.h>
+
+/** @ingroup USBD
+ * @defgroup USBD_USBIP USB/IP Peripheral Driver
+ * @{ */
+
+/** @defgroup USBD_USBIP_Exported_Macros USB/IP Exported Macros
+ * @{ */
+
+#ifndef USBD_USBIP_PORT
+/** @brief The default TCP port of USB/IP */
+#define USBD_USBIP_PORT                 3240
+#endif
+
+#ifndef USBD_USBIP_BUSID
+/** @brief The bus ID under which the device is exported */
+#define USBD_USBIP_BUSID                "1-1"
+#endif
+
+/** @} */
+
+/** @defgroup USBD_USBIP_Exported_Types USB/IP Exported Types
+ * @{ */
+
+/** @brief USB/IP transfer request */
+typedef struct _USBD_UsbipUrbType
+{
+    struct _USBD_UsbipUrbType *Next;    /*!< Next request on the same endpoint */
+    uint32_t SeqNum;                    /*!< Sequence number assigned by the host */
+    uint32_t Flags;                     /*!< URB transfer flags */
+    uint32_t Length;                    /*!< Transfer buffer length */
+    uint32_t Actual;                    /*!< Transferred length */
+    uint8_t *Data;                      /*!< Transfer buffer */
+    uint8_t  EpAddr;                    /*!< Endpoint address */
+    uint8_t  Stage;                     /*!< Control transfer stage */
+    uint8_t  Setup[8];                  /*!< Setup packet of control transfers */
+}USBD_UsbipUrbType;
+
+
+/** @brief USB/IP server structure */
+typedef struct _USBD_UsbipServerType
+{
+    USBD_HandleType *Device;            /*!< The exported device */
+    int ListenFd;                       /*!< Listening socket */
+    int ConnFd;                         /*!< Connected client socket */
+    USB_SpeedType Speed;                /*!< The reported device speed */
+    uint8_t Attached;                   /*!< The device is connected */
+    uint8_t Imported;                   /*!< A client has imported the device */
+    USBD_UsbipUrbType *IN [USBD_MAX_EP_COUNT]; /*!< Pending IN requests */
+    USBD_UsbipUrbType *OUT[USBD_MAX_EP_COUNT]; /*!< Pending OUT requests */
+}USBD_UsbipServerType;
+
+/** @} */
+
+/** @addtogroup USBD_USBIP_Exported_Functions
+ * @{ */
+USBD_ReturnType USBD_USBIP_Init         (USBD_UsbipServerType *srv,
+                                         USBD_HandleType *dev,
+                                         uint16_t port,
+                                         USB_SpeedType speed);
+
+void            USBD_USBIP_Deinit       (USBD_UsbipServerType *srv);
+
+USBD_ReturnType USBD_USBIP_Poll         (USBD_UsbipServerType *srv,
+                                         int timeout_ms);
+/** @} */
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __USBD_USBIP_H_ */
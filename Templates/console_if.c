@@ -15,11 +15,35 @@
   *     @endcode
   * After configuring it's endpoint numbers it can be mounted on a USB device.
   * Define STDOUT_BUFFER_SIZE with an appropriate buffer size to enable output,
-  * STDIN_BUFFER_SIZE to enable input functionality. (Twice the max packet size
-  * is recommended.)
+  * STDIN_BUFFER_SIZE to enable input functionality. (Both are powers of 2,
+  * at least twice the max packet size is recommended.)
   * The interface becomes operational after the serial port's line coding is set
   * (with any standard baudrate value).
   *
+  * Define CONSOLE_COUNT to create further consoles in the _console_if array,
+  * which are accessed with console_if_write() and console_if_read(),
+  * or as the file descriptors following stderr.
+  *
+  * The buffers are single producer, single consumer rings between the
+  * application and the USB interrupt. By default _write() returns the number
+  * of bytes that fit, and _read() the number of bytes available.
+  * When the RTOS semaphore hooks are defined, these calls block instead
+  * until all data is written, or at least one byte is read, e.g. with FreeRTOS:
+  *     @code
+  *     #define CONSOLE_SEM_TYPE            SemaphoreHandle_t
+  *     #define CONSOLE_SEM_INIT(SEM)       ((SEM) = xSemaphoreCreateBinary())
+  *     #define CONSOLE_SEM_WAIT(SEM)       xSemaphoreTake((SEM), portMAX_DELAY)
+  *     #define CONSOLE_SEM_POST(SEM)       xSemaphoreGiveFromISR((SEM), NULL)
+  *     @endcode
+  * If multiple tasks use the same console, the mutex hooks serialize their calls:
+  *     @code
+  *     #define CONSOLE_MUTEX_TYPE          SemaphoreHandle_t
+  *     #define CONSOLE_MUTEX_INIT(MTX)     ((MTX) = xSemaphoreCreateMutex())
+  *     #define CONSOLE_MUTEX_LOCK(MTX)     xSemaphoreTake((MTX), portMAX_DELAY)
+  *     #define CONSOLE_MUTEX_UNLOCK(MTX)   xSemaphoreGive(MTX)
+  *     @endcode
+  * The RTOS objects are created by console_if_init(), before the first I/O call.
+  *
   *
   * Copyright (c) 2018 Benedek Kupper
   *
@@ -50,40 +74,98 @@ extern int32_t errno;
  * @defgroup console_if USB serial console interface
  * @{ */
 
-static void console_if_open         (void* itf, USBD_CDC_LineCodingType * lc);
-
-#if (STDOUT_BUFFER_SIZE > 0)
+#ifndef CONSOLE_COUNT
+#define CONSOLE_COUNT           1
+#endif
 
-static const uint16_t console_in_size = STDOUT_BUFFER_SIZE;
+#if ((STDOUT_BUFFER_SIZE & (STDOUT_BUFFER_SIZE - 1)) != 0) || (STDOUT_BUFFER_SIZE > 0x8000)
+#error "STDOUT_BUFFER_SIZE must be a power of 2, and at most 32 kB!"
+#endif
+#if ((STDIN_BUFFER_SIZE & (STDIN_BUFFER_SIZE - 1)) != 0) || (STDIN_BUFFER_SIZE > 0x8000)
+#error "STDIN_BUFFER_SIZE must be a power of 2, and at most 32 kB!"
+#endif
 
-static struct {
-    uint16_t head;
-    uint16_t tail;
-    uint8_t buffer[STDOUT_BUFFER_SIZE + 1];
-}console_if_IN;
+#if (USBD_HS_SUPPORT == 1)
+#define CONSOLE_PACKET_SIZE     USB_EP_BULK_HS_MPS
+#else
+#define CONSOLE_PACKET_SIZE     USB_EP_BULK_FS_MPS
+#endif
+#if (STDIN_BUFFER_SIZE > 0) && (STDIN_BUFFER_SIZE < CONSOLE_PACKET_SIZE)
+#error "STDIN_BUFFER_SIZE must fit at least a bulk packet!"
+#endif
 
-static void console_if_in_cmplt     (void* itf, uint8_t * pbuf, uint16_t length);
-static void console_if_send         (void);
+/* The ring indexes and flags are exchanged between the application and
+ * the USB interrupt with sequentially consistent atomics, so the data
+ * is visible before the index is */
+#define CONSOLE_LOAD(VAR)           __atomic_load_n(&(VAR), __ATOMIC_SEQ_CST)
+#define CONSOLE_STORE(VAR, VALUE)   __atomic_store_n(&(VAR), (VALUE), __ATOMIC_SEQ_CST)
+#define CONSOLE_CLAIM(FLAG)         (__atomic_exchange_n(&(FLAG), 1, __ATOMIC_SEQ_CST) == 0)
+
+#ifdef CONSOLE_MUTEX_TYPE
+#define CONSOLE_LOCK(MTX)           CONSOLE_MUTEX_LOCK(MTX)
+#define CONSOLE_UNLOCK(MTX)         CONSOLE_MUTEX_UNLOCK(MTX)
+#else
+#define CONSOLE_LOCK(MTX)           ((void)0)
+#define CONSOLE_UNLOCK(MTX)         ((void)0)
 #endif
 
+typedef struct
+{
+#if (STDOUT_BUFFER_SIZE > 0)
+    struct {
+        uint8_t buffer[STDOUT_BUFFER_SIZE] __align(USBD_DATA_ALIGNMENT);
+        uint16_t head;          /* free-running write index (application) */
+        uint16_t tail;          /* free-running send index (USB) */
+        uint8_t busy;           /* set while the IN endpoint is used by the ring */
+#ifdef CONSOLE_SEM_TYPE
+        CONSOLE_SEM_TYPE space; /* posted when the ring is freed up */
+#endif
+#ifdef CONSOLE_MUTEX_TYPE
+        CONSOLE_MUTEX_TYPE lock;
+#endif
+    }IN;
+#endif
 #if (STDIN_BUFFER_SIZE > 0)
+    struct {
+        /* the packet received past the end of the ring is moved to its start */
+        uint8_t buffer[STDIN_BUFFER_SIZE + CONSOLE_PACKET_SIZE] __align(USBD_DATA_ALIGNMENT);
+        uint16_t head;          /* free-running receive index (USB) */
+        uint16_t tail;          /* free-running read index (application) */
+        uint8_t armed;          /* set while the OUT endpoint is used by the ring */
+#ifdef CONSOLE_SEM_TYPE
+        CONSOLE_SEM_TYPE data;  /* posted when data is received */
+#endif
+#ifdef CONSOLE_MUTEX_TYPE
+        CONSOLE_MUTEX_TYPE lock;
+#endif
+    }OUT;
+#endif
+    uint8_t open;               /* set while the serial port is open */
+}console_type;
 
-static const uint16_t console_out_size = STDIN_BUFFER_SIZE;
+static console_type console[CONSOLE_COUNT];
 
-static struct {
-    uint16_t head;
-    uint16_t tail;
-    uint8_t buffer[STDIN_BUFFER_SIZE + 1];
-}console_if_OUT;
+/* The console state of the CDC interface */
+#define CONSOLE(ITF)    (&console[(USBD_CDC_IfHandleType*)(ITF) - _console_if])
+
+static void console_if_open         (void* itf, USBD_CDC_LineCodingType * lc);
+static void console_if_close        (void* itf);
+
+#if (STDOUT_BUFFER_SIZE > 0)
+static void console_if_in_cmplt     (void* itf, uint8_t * pbuf, uint16_t length);
+static void console_if_send         (USBD_CDC_IfHandleType *itf);
+#endif
 
+#if (STDIN_BUFFER_SIZE > 0)
 static void console_if_out_cmplt    (void* itf, uint8_t * pbuf, uint16_t length);
-static void console_if_recv         (void);
+static void console_if_recv         (USBD_CDC_IfHandleType *itf);
 #endif
 
 static const USBD_CDC_AppType console_app =
 {
     .Name           = "Serial port as standard I/O",
     .Open           = console_if_open,
+    .Close          = console_if_close,
 #if (STDIN_BUFFER_SIZE > 0)
     .Received       = console_if_out_cmplt,
 #endif
@@ -92,201 +174,346 @@ static const USBD_CDC_AppType console_app =
 #endif
 };
 
-USBD_CDC_IfHandleType _console_if = {
-    .App = &console_app,
-    .Base.AltCount = 1,
-}, *const console_if = &_console_if;
+USBD_CDC_IfHandleType _console_if[CONSOLE_COUNT] = {
+    [0 ... (CONSOLE_COUNT - 1)] = {
+        .App = &console_app,
+        .Base.AltCount = 1,
+    }
+}, *const console_if = &_console_if[0];
 
-static void console_if_open(void* itf, USBD_CDC_LineCodingType * lc)
+#if defined(CONSOLE_SEM_TYPE) || defined(CONSOLE_MUTEX_TYPE)
+/**
+ * @brief Creates the RTOS objects of the consoles.
+ */
+void console_if_init(void)
 {
+    console_type *con;
+
+    for (con = &console[0]; con < &console[CONSOLE_COUNT]; con++)
+    {
 #if (STDOUT_BUFFER_SIZE > 0)
-    console_if_IN.head = console_if_IN.tail = 0;
+#ifdef CONSOLE_SEM_TYPE
+        CONSOLE_SEM_INIT(con->IN.space);
+#endif
+#ifdef CONSOLE_MUTEX_TYPE
+        CONSOLE_MUTEX_INIT(con->IN.lock);
+#endif
 #endif
 #if (STDIN_BUFFER_SIZE > 0)
-    console_if_OUT.head = console_if_OUT.tail = 0;
-    console_if_recv();
+#ifdef CONSOLE_SEM_TYPE
+        CONSOLE_SEM_INIT(con->OUT.data);
+#endif
+#ifdef CONSOLE_MUTEX_TYPE
+        CONSOLE_MUTEX_INIT(con->OUT.lock);
+#endif
 #endif
+    }
 }
+#endif
 
+static void console_if_open(void* itf, USBD_CDC_LineCodingType * lc)
+{
+    console_type *con = CONSOLE(itf);
+
+    /* the data of the previous session is discarded */
 #if (STDOUT_BUFFER_SIZE > 0)
-static void console_if_in_cmplt(void* itf, uint8_t * pbuf, uint16_t length)
+    CONSOLE_STORE(con->IN.tail, CONSOLE_LOAD(con->IN.head));
+    CONSOLE_STORE(con->IN.busy, 0);
+#endif
+#if (STDIN_BUFFER_SIZE > 0)
+    CONSOLE_STORE(con->OUT.head, CONSOLE_LOAD(con->OUT.tail));
+    CONSOLE_STORE(con->OUT.armed, 0);
+    console_if_recv(itf);
+#endif
+    CONSOLE_STORE(con->open, 1);
+}
+
+static void console_if_close(void* itf)
 {
-    if (console_if_IN.tail < console_in_size)
-        console_if_IN.tail += length;
-    else
-        console_if_IN.tail = length - 1;
-    console_if_send();
+    console_type *con = CONSOLE(itf);
+
+    CONSOLE_STORE(con->open, 0);
+
+    /* the blocked calls return */
+#ifdef CONSOLE_SEM_TYPE
+#if (STDOUT_BUFFER_SIZE > 0)
+    CONSOLE_SEM_POST(con->IN.space);
+#endif
+#if (STDIN_BUFFER_SIZE > 0)
+    CONSOLE_SEM_POST(con->OUT.data);
+#endif
+#endif
 }
 
-static void console_if_send(void)
+/**
+ * @brief Selects the console of a standard I/O file descriptor.
+ * @param file: the file descriptor
+ * @return The CDC interface of the console, or NULL if it doesn't exist
+ */
+static USBD_CDC_IfHandleType *console_if_file(int32_t file)
 {
-    uint16_t head = console_if_IN.head, tail = console_if_IN.tail;
-    uint16_t start = tail + 1, length;
+    USBD_CDC_IfHandleType *itf = NULL;
 
-    if (tail <= head)
+    /* stdin, stdout and stderr use the first console */
+    if (file <= 2)
     {
-        length = head - tail;
+        itf = &_console_if[0];
     }
-    else if (tail < console_in_size)
+    else if ((file - 2) < CONSOLE_COUNT)
     {
-        length = console_in_size - tail;
+        itf = &_console_if[file - 2];
     }
     else
     {
-        length = head + 1;
-        start = 0;
+        errno = -EBADF;
     }
+    return itf;
+}
 
-    if (length > 0)
-    {
-        USBD_CDC_Transmit(console_if,
-                &console_if_IN.buffer[start], length);
-    }
+#if (STDOUT_BUFFER_SIZE > 0)
+static void console_if_in_cmplt(void* itf, uint8_t * pbuf, uint16_t length)
+{
+    console_type *con = CONSOLE(itf);
+
+    CONSOLE_STORE(con->IN.tail, con->IN.tail + length);
+    CONSOLE_STORE(con->IN.busy, 0);
+    console_if_send(itf);
+
+#ifdef CONSOLE_SEM_TYPE
+    CONSOLE_SEM_POST(con->IN.space);
+#endif
 }
 
-int _write(int32_t file, uint8_t *ptr, int32_t len)
+static void console_if_send(USBD_CDC_IfHandleType *itf)
 {
-    int retval = -1;
-    uint16_t head = console_if_IN.head, tail = console_if_IN.tail;
+    console_type *con = CONSOLE(itf);
 
-    if (console_if->LineCoding.DataBits == 0)
+    while (CONSOLE_CLAIM(con->IN.busy))
     {
-        errno = -EIO;
-    }
-    else if (((tail > head) ?
-            (tail - head - 1) : (console_in_size - (head - tail))) < len)
-    {
-        errno = -ENOMEM;
+        uint16_t head = CONSOLE_LOAD(con->IN.head), tail = con->IN.tail;
+        uint16_t start = tail & (STDOUT_BUFFER_SIZE - 1);
+        uint16_t length = STDOUT_BUFFER_SIZE - start;
+
+        /* the wrapped part is sent by the next transfer */
+        if (length > (uint16_t)(head - tail))
+        {
+            length = head - tail;
+        }
+
+        if (length > 0)
+        {
+            if (USBD_CDC_Transmit(itf, &con->IN.buffer[start], length) != USBD_E_OK)
+            {
+                CONSOLE_STORE(con->IN.busy, 0);
+            }
+            break;
+        }
+
+        /* the data written after the check is sent by this context */
+        CONSOLE_STORE(con->IN.busy, 0);
+        if (CONSOLE_LOAD(con->IN.head) == head)
+        {
+            break;
+        }
     }
-    else
+}
+
+/**
+ * @brief Writes data to a console's output ring, which is sent to the host
+ *        in the background. In blocking mode it waits until all data is written.
+ * @param itf: the CDC interface of the console
+ * @param ptr: pointer to the data to send
+ * @param len: length of the data
+ * @return The number of bytes written, or -1 if none could be written
+ */
+int console_if_write(USBD_CDC_IfHandleType *itf, const uint8_t *ptr, int32_t len)
+{
+    console_type *con = CONSOLE(itf);
+    int32_t count = 0;
+
+    CONSOLE_LOCK(con->IN.lock);
+
+    while ((count < len) && CONSOLE_LOAD(con->open))
     {
-        uint16_t len1, len2 = 0;
+        uint16_t head = con->IN.head;
+        uint16_t start = head & (STDOUT_BUFFER_SIZE - 1);
+        uint16_t length = STDOUT_BUFFER_SIZE - (uint16_t)(head - CONSOLE_LOAD(con->IN.tail));
+        uint16_t len1;
 
-        if (tail > head)
+        if (length > (len - count))
         {
-            /* continuous */
-            len1 = tail - head - 1;
-            if (len < len1)
-                len1 = len;
+            length = len - count;
         }
-        else
+        if (length == 0)
         {
-            /* two chunks */
-            len1 = console_in_size - head;
-
-            if (len <= len1)
-                len1 = len;
-            else if (len < (len1 + tail))
-                len2 = len - len1;
-            else
-                len2 = tail;
+#ifdef CONSOLE_SEM_TYPE
+            CONSOLE_SEM_WAIT(con->IN.space);
+            continue;
+#else
+            break;
+#endif
         }
 
-        /* first chunk is copied starting from current head */
-        memcpy(&console_if_IN.buffer[head + 1], ptr, len1);
-        console_if_IN.head += len1;
-        ptr += len1;
-
-        /* the remaining chunk is copied from the buffer start */
-        if (len2 > 0)
+        /* the data is copied in two chunks when it wraps around */
+        len1 = STDOUT_BUFFER_SIZE - start;
+        if (len1 > length)
         {
-            memcpy(&console_if_IN.buffer[0], ptr, len2);
-            console_if_IN.head = len2 - 1;
+            len1 = length;
         }
+        memcpy(&con->IN.buffer[start], &ptr[count], len1);
+        memcpy(&con->IN.buffer[0], &ptr[count + len1], length - len1);
 
-        retval = len1 + len2;
-        console_if_send();
+        CONSOLE_STORE(con->IN.head, head + length);
+        count += length;
+        console_if_send(itf);
     }
-    return retval;
+
+    CONSOLE_UNLOCK(con->IN.lock);
+
+    if ((count == 0) && (len > 0))
+    {
+        errno = CONSOLE_LOAD(con->open) ? -ENOMEM : -EIO;
+        count = -1;
+    }
+    return count;
 }
-#endif
 
-#if (STDIN_BUFFER_SIZE > 0)
-static void console_if_out_cmplt(void* itf, uint8_t * pbuf, uint16_t length)
+int _write(int32_t file, uint8_t *ptr, int32_t len)
 {
-    if (console_if_OUT.head < console_out_size)
-        console_if_OUT.head += length;
-    else
-        console_if_OUT.head = length - 1;
-    console_if_recv();
+    USBD_CDC_IfHandleType *itf = console_if_file(file);
+
+    return (itf != NULL) ? console_if_write(itf, ptr, len) : -1;
 }
+#endif
 
-static void console_if_recv(void)
+#if (STDIN_BUFFER_SIZE > 0)
+static void console_if_out_cmplt(void* itf, uint8_t * pbuf, uint16_t length)
 {
-    uint16_t tail = console_if_OUT.tail, head = console_if_OUT.head;
-    uint16_t start = head + 1, length;
+    console_type *con = CONSOLE(itf);
+    uint16_t head = con->OUT.head;
+    uint16_t start = head & (STDIN_BUFFER_SIZE - 1);
 
-    if (tail > head)
-    {
-        length = tail - head - 1;
-    }
-    else if (head < console_out_size)
+    /* the ring's start is free, as the transfer only used free space */
+    if ((start + length) > STDIN_BUFFER_SIZE)
     {
-        length = console_out_size - head;
-    }
-    else
-    {
-        length = tail;
-        start = 0;
+        memcpy(&con->OUT.buffer[0], &con->OUT.buffer[STDIN_BUFFER_SIZE],
+                start + length - STDIN_BUFFER_SIZE);
     }
+    CONSOLE_STORE(con->OUT.head, head + length);
+    CONSOLE_STORE(con->OUT.armed, 0);
+    console_if_recv(itf);
 
+#ifdef CONSOLE_SEM_TYPE
     if (length > 0)
     {
-        USBD_CDC_Receive(console_if,
-                &console_if_OUT.buffer[start], length);
+        CONSOLE_SEM_POST(con->OUT.data);
     }
+#endif
 }
 
-int _read(int32_t file, uint8_t *ptr, int32_t len)
+static void console_if_recv(USBD_CDC_IfHandleType *itf)
 {
-    int retval = -1;
-    uint16_t tail = console_if_OUT.tail, head = console_if_OUT.head;
+    console_type *con = CONSOLE(itf);
 
-    if (console_if->LineCoding.DataBits == 0)
+    while (CONSOLE_CLAIM(con->OUT.armed))
     {
-        errno = -EIO;
+        uint16_t tail = CONSOLE_LOAD(con->OUT.tail), head = con->OUT.head;
+        uint16_t start = head & (STDIN_BUFFER_SIZE - 1);
+
+        /* full packets are received in the free space, until the end of the ring */
+        uint16_t length = (STDIN_BUFFER_SIZE - (uint16_t)(head - tail))
+                & ~(CONSOLE_PACKET_SIZE - 1);
+        uint16_t end = (STDIN_BUFFER_SIZE - start + CONSOLE_PACKET_SIZE - 1)
+                & ~(CONSOLE_PACKET_SIZE - 1);
+
+        if (length > end)
+        {
+            length = end;
+        }
+
+        if (length > 0)
+        {
+            if (USBD_CDC_Receive(itf, &con->OUT.buffer[start], length) != USBD_E_OK)
+            {
+                CONSOLE_STORE(con->OUT.armed, 0);
+            }
+            break;
+        }
+
+        /* the data read after the check is handled by this context */
+        CONSOLE_STORE(con->OUT.armed, 0);
+        if (CONSOLE_LOAD(con->OUT.tail) == tail)
+        {
+            break;
+        }
     }
-    else
+}
+
+/**
+ * @brief Reads the received data of a console.
+ *        In blocking mode it waits until at least one byte is available.
+ * @param itf: the CDC interface of the console
+ * @param ptr: the destination buffer
+ * @param len: maximum length to read
+ * @return The number of bytes read, or -1 if the port isn't open
+ */
+int console_if_read(USBD_CDC_IfHandleType *itf, uint8_t *ptr, int32_t len)
+{
+    console_type *con = CONSOLE(itf);
+    int32_t count = 0;
+
+    CONSOLE_LOCK(con->OUT.lock);
+
+    while ((count == 0) && (len > 0) && CONSOLE_LOAD(con->open))
     {
-        uint16_t len1, len2 = 0;
+        uint16_t tail = con->OUT.tail;
+        uint16_t start = tail & (STDIN_BUFFER_SIZE - 1);
+        uint16_t length = CONSOLE_LOAD(con->OUT.head) - tail;
+        uint16_t len1;
 
-        if (tail <= head)
+        if (length > len)
         {
-            /* continuous */
-            len1 = head - tail;
-            if (len < len1)
-                len1 = len;
+            length = len;
         }
-        else
+        if (length == 0)
         {
-            /* two chunks */
-            len1 = console_out_size - tail;
-
-            if (len <= len1)
-                len1 = len;
-            else if (len < (len1 + head + 1))
-                len2 = len - len1;
-            else
-                len2 = head + 1;
+#ifdef CONSOLE_SEM_TYPE
+            CONSOLE_SEM_WAIT(con->OUT.data);
+            continue;
+#else
+            break;
+#endif
         }
 
-        /* first chunk is copied starting from current tail */
-        memcpy(ptr, &console_if_OUT.buffer[tail + 1], len1);
-        console_if_OUT.tail += len1;
-        ptr += len1;
-
-        /* the remaining chunk is copied from the buffer start */
-        if (len2 > 0)
+        /* the data is copied in two chunks when it wraps around */
+        len1 = STDIN_BUFFER_SIZE - start;
+        if (len1 > length)
         {
-            memcpy(ptr, &console_if_OUT.buffer[0], len2);
-            console_if_OUT.tail = len2 - 1;
+            len1 = length;
         }
+        memcpy(ptr, &con->OUT.buffer[start], len1);
+        memcpy(&ptr[len1], &con->OUT.buffer[0], length - len1);
 
-        retval = len1 + len2;
-        if (retval > 0)
-            console_if_recv();
+        CONSOLE_STORE(con->OUT.tail, tail + length);
+        count = length;
+        console_if_recv(itf);
     }
-    return retval;
+
+    CONSOLE_UNLOCK(con->OUT.lock);
+
+    if ((count == 0) && !CONSOLE_LOAD(con->open))
+    {
+        errno = -EIO;
+        count = -1;
+    }
+    return count;
+}
+
+int _read(int32_t file, uint8_t *ptr, int32_t len)
+{
+    USBD_CDC_IfHandleType *itf = console_if_file(file);
+
+    return (itf != NULL) ? console_if_read(itf, ptr, len) : -1;
 }
 #endif
 
@@ -50,6 +50,152 @@
  * Unless the device is required to operate on earlier Windows OS versions, use version 2. */
 #define USBD_MS_OS_DESC_VERSION     0
 
+/** @brief Set to 1 to enable transfer request queues on the non-control endpoints.
+ * The queued requests are started by the core as soon as the previous one completes,
+ * so that the endpoint doesn't NAK the host while the completion is processed. */
+#define USBD_EP_QUEUE_SUPPORT       0
+
+/** @brief Set to 1 to allow binding completion handlers directly to the endpoints
+ * with USBD_EpSetHandler(), which are then called instead of the interface class. */
+#define USBD_EP_HANDLERS            0
+
+/** @brief Set to 1 to schedule the non-isochronous IN transfers of the endpoints,
+ * instead of passing them to the peripheral in the order of submission.
+ * The pending transfers are started by priority class (set by USBD_SetEpPriority(),
+ * interrupt endpoints are served before bulk ones by default),
+ * then by the earliest deadline, while the bulk endpoints without a deadline
+ * take turns of USBD_EP_SCHED_BUDGET bytes. The waiting times are read by
+ * USBD_GetEpWaitStats(). Transfers of peripherals with native segmented transfer
+ * support (USBD_EP_SG_SUPPORT) bypass the scheduler when sent with USBD_EpSendv(). */
+#define USBD_EP_SCHEDULER           0
+
+/** @brief The number of scheduled IN transfers which are handed to the peripheral
+ * at the same time. A single slot gives the scheduler full control of the order,
+ * more slots keep the peripheral's TX FIFOs busy. */
+#define USBD_EP_SCHED_SLOTS         1
+
+/** @brief The number of bytes a bulk endpoint may send in its turn
+ * while other bulk endpoints of the same priority are waiting.
+ * An endpoint can only keep its turn if its next transfer is already queued
+ * (USBD_EP_QUEUE_SUPPORT) when the previous one completes. */
+#define USBD_EP_SCHED_BUDGET        2048
+
+/** @brief The time source of the scheduler deadlines and waiting times,
+ * a free-running 32 bit counter. Without it the time is measured
+ * in the number of scheduled transfer submissions. */
+/* #define USBD_EP_SCHED_TIMESTAMP()   (DWT->CYCCNT) */
+
+/** @brief Set to 1 to claim the endpoints atomically when a transfer is submitted,
+ * so that different threads can submit transfers while the completions are handled
+ * in the interrupt (or another thread), without locking the whole driver call.
+ * The endpoint state is changed by the compiler's __atomic compare-and-swap builtin,
+ * unless USBD_CRITICAL_ENTER() and USBD_CRITICAL_EXIT() are defined to protect it
+ * (these are also required to protect the endpoint queues and the scheduler). */
+#define USBD_EP_ATOMIC_CLAIM        0
+
+/** @brief The critical section of the endpoint state changes, in case the core
+ * doesn't support atomic compare-and-swap (e.g. ARMv6-M).
+ * The two macros are expanded in the same block. */
+/* #define USBD_CRITICAL_ENTER()       uint32_t primask = __get_PRIMASK(); __disable_irq() */
+/* #define USBD_CRITICAL_EXIT()        __set_PRIMASK(primask) */
+
+/** @brief The width of the endpoint transfer lengths, either 16 or 32 bits.
+ * With 32 bits a single transfer can move more than 64 kB, e.g. a MSC block buffer
+ * of this size, if the peripheral driver supports such transfers. */
+#define USBD_TRANSFER_LENGTH_BITS   16
+
+/** @brief When set, the assembled configuration descriptors (one per supported speed)
+ * are stored in buffers of this size, and the subsequent requests are served from them.
+ * The cache is invalidated when an interface is mounted or removed,
+ * or the device speed changes. */
+#define USBD_CONFIG_DESC_CACHE_SIZE 0
+
+/** @brief When set, the string descriptors are converted from the UTF-8 strings only once
+ * after the interfaces are mounted, and stored in a table of this size
+ * (each descriptor takes its length + 1 bytes, aligned to USBD_DATA_ALIGNMENT).
+ * The subsequent requests are served from the table without conversion. */
+#define USBD_STRING_TABLE_SIZE      0
+
+/** @brief Set to 1 to serve string descriptors from the constant table
+ * referenced by USBD_DescriptionType::StringTable, before converting them.
+ * Such tables can be generated by the Tools/usbd_strgen.c host tool. */
+#define USBD_CONST_STRING_TABLE     0
+
+/** @brief Set to 1 to generate the configuration, string and Microsoft OS descriptors
+ * in EP0 buffer sized chunks as the control IN data stage advances.
+ * This way USBD_EP0_BUFFER_SIZE only has to fit the EP0 max packet size
+ * and the longest class-specific control request. */
+#define USBD_CTRL_STREAMING         0
+
+/** @brief When USBD_CTRL_STREAMING is set, the descriptor of each function
+ * (an interface together with its associated interfaces) is assembled
+ * in a temporary stack buffer of this size.
+ * The mounting of a function with longer descriptors fails. */
+#define USBD_MAX_IF_DESC_SIZE       128
+
+/** @brief Set to 1 to bind the interfaces to the device at compile time.
+ * The interfaces are listed in the application's usbd_interfaces.h header
+ * (see Templates/usbd_interfaces.h), and their class functions are called directly
+ * instead of through the USBD_ClassType references of the interface handles.
+ * The configuration descriptors can also be provided as constant data
+ * by USBD_DescriptionType::ConfigDesc. */
+#define USBD_STATIC_INTERFACES      0
+
+/** @brief Set to 1 to complete the status stage of SET_CONFIGURATION before
+ * the interfaces are (de)initialized, so slow class initialization (e.g. MSC media)
+ * doesn't delay the host's request. The endpoints NAK until the classes open and arm them.
+ * Combined with USBD_DEFERRED_EVENTS the initialization runs in the processing thread. */
+#define USBD_ASYNC_CONFIG           0
+
+/** @brief Set to 1 to handle the USB events in thread context.
+ * The Peripheral Driver callbacks only queue the events,
+ * and @ref USBD_Process has to be called to execute the class handlers.
+ * The application can override @ref USBD_EventCallback to wake up the processing thread. */
+#define USBD_DEFERRED_EVENTS        0
+
+/** @brief Size of the deferred event queue. Each endpoint can have
+ * a single pending transfer completion, and the bus resets and setup requests
+ * can be received while the previous events are still pending. */
+#define USBD_EVENT_QUEUE_SIZE       (2 * USBD_MAX_EP_COUNT + 4)
+
+/** @brief Size of the buffer used for segmented endpoint transfers
+ * (@ref USBD_EpSendv, @ref USBD_EpReceivev) when the peripheral driver
+ * can't transfer the segments directly. The buffer is shared by the endpoints,
+ * and it must fit the longest segmented transfer. */
+#define USBD_EP_SG_BUFFER_SIZE      0
+
+/** @brief Set to 1 to count the transferred bytes, completed and zero length transfers,
+ * busy rejections and stalls of each endpoint, which are read by @ref USBD_GetEpStats. */
+#define USBD_EP_STATS               0
+
+/** @brief When USBD_EP_STATS is set, this free-running 32 bit counter is sampled
+ * at the start and completion of the transfers, and the elapsed times
+ * are collected in a log2 histogram of USBD_EP_STATS_BINS bins per endpoint.
+ * The histogram is omitted when no timestamp source is defined. */
+/* #define USBD_EP_STATS_TIMESTAMP()   (DWT->CYCCNT) */
+
+/** @brief Number of latency histogram bins, the last one counts all the longer transfers. */
+#define USBD_EP_STATS_BINS          16
+
+/** @brief When set, the setup requests, endpoint transfers, stalls, bus resets
+ * and link state changes are recorded in a ring of this many entries (preferably a power of 2).
+ * The ring (dev->Trace) can be dumped from the target's memory,
+ * and converted to a Wireshark readable pcap file by Tools/usbd_trace2pcap.c.
+ * The events have to be recorded from a single context, as the ring isn't locked. */
+#define USBD_TRACE_SIZE             0
+
+/** @brief The number of captured data bytes of each non-control transfer
+ * (a multiple of 4). The control transfers are captured entirely. */
+#define USBD_TRACE_DATA_SIZE        8
+
+/** @brief The free-running 32 bit counter which timestamps the trace entries,
+ * its frequency is passed to the trace decoder. */
+/* #define USBD_TRACE_TIMESTAMP()      (DWT->CYCCNT) */
+
+/** @brief Set to 1 to pass every handled peripheral event with its data
+ * to USBD_RecordCallback(), so the session can be replayed by the Replay PD. */
+#define USBD_EVENT_RECORDING        0
+
 
 /** @brief Set to 1 if notifications are sent by a CDC-ACM interface.
  * In this case notification EP will be allocated and opened if its address is valid. */
@@ -61,6 +207,34 @@
 /** @brief Set to 1 if SEND_BREAK request is used by a CDC-ACM interface. */
 #define USBD_CDC_BREAK_SUPPORT      0
 
+/** @brief Set to 1 to let the CDC-ACM interfaces manage their transfer buffers.
+ * The application writes and reads the data with USBD_CDC_Write() and USBD_CDC_Read(),
+ * while the interface chains the IN transfers from a ring of USBD_CDC_TX_BUFFER_SIZE,
+ * and keeps receiving into the free space of a ring of USBD_CDC_RX_BUFFER_SIZE.
+ * The data can also be formatted in place with USBD_CDC_TxReserve() and USBD_CDC_TxCommit().
+ * When the application discards data (e.g. its UART receiver overflows),
+ * USBD_CDC_ReportOverrun() sets the OverRun bit of a SerialState notification. */
+#define USBD_CDC_STREAMING          0
+
+/** @brief In streaming mode the reception is paused (the host's data is NAKed)
+ * when this much unread data is in the receive ring. */
+#define USBD_CDC_RX_HIGH_WATERMARK  (USBD_CDC_RX_BUFFER_SIZE * 3 / 4)
+
+/** @brief The paused reception is resumed when the application reads
+ * the receive ring down to this level. */
+#define USBD_CDC_RX_LOW_WATERMARK   (USBD_CDC_RX_BUFFER_SIZE / 4)
+
+/** @brief When set in streaming mode, the written data is only sent in full packets,
+ * the last partial packet is held back for this many USBD_CDC_TX_TIMESTAMP() ticks
+ * to coalesce it with the following writes. The held data is also sent
+ * by USBD_CDC_Flush(), or by USBD_CDC_Poll() when the time is up,
+ * which should be called periodically (e.g. by the SOF interrupt). */
+#define USBD_CDC_TX_HOLD_TIME       0
+
+/** @brief The free-running 32 bit counter of the CDC transmit hold time,
+ * e.g. a microsecond timer, or a counter of the SOF interrupts. */
+/* #define USBD_CDC_TX_TIMESTAMP()     (TIM2->CNT) */
+
 
 
 /** @brief Set to 1 if a DFU interface holds more than one applications as alternate settings. */
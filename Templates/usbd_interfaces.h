@@ -0,0 +1,60 @@
+/**
+  ******************************************************************************
+  * @file    usbd_interfaces.h
+  * @author  Benedek Kupper
+  * @version 0.1
+  * @date    2019-01-26
+  * @brief   Universal Serial Bus Device Driver
+  *          Static interface list template
+  *
+  * @details
+  * When USBD_STATIC_INTERFACES is set, this header lists the interfaces
+  * of the device's single configuration. Each interface number has an entry
+  * X(IFNUM, CLASS, ITF), where CLASS is the @ref USBD_ClassType object
+  * of the interface handle ITF. Functions with multiple interfaces
+  * (e.g. CDC) have an entry for each of their interface numbers.
+  * The interfaces still have to be mounted in the listed order,
+  * so that their endpoints and interface numbers are assigned,
+  * the mount functions reject an interface out of order with INVALID.
+  *
+  * The class functions are called directly through the constant class objects,
+  * which the compiler can only resolve (and inline) when the class objects
+  * are visible to it, i.e. with link-time optimization. Without it the
+  * calls go through the constant class objects, without reading itf->Class.
+  * The handles have to be listed as objects (not through pointers),
+  * as their addresses form a constant table.
+  * Interfaces which change their class at runtime (e.g. DFU) are listed
+  * with the class reference of their handle: (*dfu_if.Base.Class).
+  *
+  * Copyright (c) 2019 Benedek Kupper
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+#ifndef __USBD_INTERFACES_H_
+#define __USBD_INTERFACES_H_
+
+#include <usbd_cdc.h>
+
+/** @addtogroup USBD_Exported_Macros
+ * @{ */
+
+extern USBD_CDC_IfHandleType _console_if[];
+
+/** @brief The interfaces of the device, in interface number order. */
+#define USBD_STATIC_IF_LIST(X)                      \
+    X(0, USBD_CDC_Class, _console_if[0])            \
+    X(1, USBD_CDC_Class, _console_if[0])
+
+/** @} */
+
+#endif /* __USBD_INTERFACES_H_ */
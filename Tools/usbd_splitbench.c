@@ -0,0 +1,340 @@
+/**
+  ******************************************************************************
+  * @file    usbd_splitbench.c
+  * @author  Benedek Kupper
+  * @version 0.1
+  * @date    2019-01-29
+  * @brief   Universal Serial Bus Device Driver
+  *          Host benchmark of the dual-core split
+  *
+  * @details
+  * The benchmark runs the device on the simulated bus in the main (USB core)
+  * thread, and a CDC echo application in a second (application core) thread.
+  * The two threads are connected by a mailbox pair: the received buffers
+  * are posted to the application, which posts them back for transmission,
+  * and the transmitted buffers are posted back once more to be re-armed
+  * for reception. The host model sends a counting byte pattern,
+  * and validates the echoed stream:
+  *     @code
+  *     $ cc -O2 -pthread -I Templates -I Include -I PDs/Sim -o usbd_splitbench \
+  *          Tools/usbd_splitbench.c Device/usbd*.c Class/CDC/usbd_cdc.c PDs/Sim/usbd_sim.c
+  *     $ ./usbd_splitbench [kbytes]
+  *     @endcode
+  *
+  * Copyright (c) 2019 Benedek Kupper
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+#include <usbd.h>
+#include <usbd_cdc.h>
+#include <usbd_mailbox.h>
+#include <usbd_sim.h>
+
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* Number of buffers circulating between the cores */
+#define BUFFER_COUNT        4
+
+/* Size of each buffer, a Full-Speed bulk packet */
+#define BUFFER_SIZE         64
+
+/* Size of the host transfers */
+#define HOST_TRANSFER_SIZE  256
+
+/* The benchmark is aborted when the echo stalls for this long */
+#define STALL_TIMEOUT_NS    1000000000
+
+static uint8_t buffers[BUFFER_COUNT][BUFFER_SIZE];
+
+static USBD_MailboxType to_app, to_usb;
+static sem_t app_wakeup;
+static volatile int app_running = 1;
+
+/* USB core state, only accessed by the main thread */
+static struct {
+    uint8_t *Free[BUFFER_COUNT];    /* Buffers waiting to be armed for reception */
+    uint8_t FreeCount;
+    struct {
+        uint8_t *Data;
+        USBD_LengthType Length;
+    }Tx[BUFFER_COUNT];              /* Buffers waiting for transmission */
+    uint8_t TxHead, TxCount;
+}usb;
+
+/* Number of times a mailbox was found full */
+static uint32_t mailbox_full;
+
+/* Application core statistics */
+static struct {
+    uint64_t Bytes;
+    uint32_t Messages;
+}app;
+
+static USBD_CDC_IfHandleType cdc_if;
+
+/**
+ * @brief Returns the monotonic time.
+ * @return The current time in nanoseconds
+ */
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    (void) clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * @brief Posts a message, waiting for the receiver to make space if needed.
+ */
+static void post(USBD_MailboxType *mbx, USBD_MessageCbkType handler,
+        void *context, void *data, USBD_LengthType length)
+{
+    while (USBD_MBX_Post(mbx, handler, context, data, length) != USBD_E_OK)
+    {
+        (void) __atomic_fetch_add(&mailbox_full, 1, __ATOMIC_RELAXED);
+        USBD_MailboxCallback(mbx);
+        sched_yield();
+    }
+}
+
+/**
+ * @brief Wakes up the application thread when a message is posted to it.
+ */
+void USBD_MailboxCallback(USBD_MailboxType *mbx)
+{
+    if (mbx == &to_app)
+    {
+        (void) sem_post(&app_wakeup);
+    }
+}
+
+/* --- USB core: message handlers and CDC callbacks --- */
+
+/* Arms the next free buffer for reception if the endpoint is idle */
+static void usb_arm(void)
+{
+    if ((usb.FreeCount > 0) &&
+        (USBD_CDC_Receive(&cdc_if, usb.Free[usb.FreeCount - 1], BUFFER_SIZE) == USBD_E_OK))
+    {
+        usb.FreeCount--;
+    }
+}
+
+/* Starts the next queued transmission if the endpoint is idle */
+static void usb_send(void)
+{
+    if ((usb.TxCount > 0) &&
+        (USBD_CDC_Transmit(&cdc_if, usb.Tx[usb.TxHead].Data, usb.Tx[usb.TxHead].Length) == USBD_E_OK))
+    {
+        usb.TxHead = (usb.TxHead + 1) % BUFFER_COUNT;
+        usb.TxCount--;
+    }
+}
+
+/* A processed buffer is handed back for transmission */
+static void usb_transmit(void *itf, void *data, USBD_LengthType length)
+{
+    uint8_t tail = (usb.TxHead + usb.TxCount) % BUFFER_COUNT;
+
+    (void)itf;
+    usb.Tx[tail].Data   = data;
+    usb.Tx[tail].Length = length;
+    usb.TxCount++;
+    usb_send();
+}
+
+/* A transmitted buffer is handed back for reception */
+static void usb_receive(void *itf, void *data, USBD_LengthType length)
+{
+    (void)itf;
+    (void)length;
+    usb.Free[usb.FreeCount++] = data;
+    usb_arm();
+}
+
+/* --- Application core: message handlers --- */
+
+static void app_received(void *itf, void *data, USBD_LengthType length)
+{
+    app.Bytes += length;
+    app.Messages++;
+    post(&to_usb, usb_transmit, itf, data, length);
+}
+
+static void app_transmitted(void *itf, void *data, USBD_LengthType length)
+{
+    (void)length;
+    app.Messages++;
+    post(&to_usb, usb_receive, itf, data, BUFFER_SIZE);
+}
+
+static void app_stop(void *itf, void *data, USBD_LengthType length)
+{
+    (void)itf;
+    (void)data;
+    (void)length;
+    app_running = 0;
+}
+
+static void *app_thread(void *arg)
+{
+    (void)arg;
+    while (app_running)
+    {
+        (void) sem_wait(&app_wakeup);
+        (void) USBD_MBX_Dispatch(&to_app);
+    }
+    return NULL;
+}
+
+/* --- CDC application callbacks, executed on the USB core --- */
+
+static void cdc_open(void *itf, USBD_CDC_LineCodingType *coding)
+{
+    (void)coding;
+    (void)itf;
+    usb_arm();
+}
+
+static void cdc_received(void *itf, uint8_t *data, uint16_t length)
+{
+    post(&to_app, app_received, itf, data, length);
+    usb_arm();
+}
+
+static void cdc_transmitted(void *itf, uint8_t *data, uint16_t length)
+{
+    post(&to_app, app_transmitted, itf, data, length);
+    usb_send();
+}
+
+static const USBD_CDC_AppType cdc_app = {
+    .Name           = "Split echo",
+    .Open           = cdc_open,
+    .Received       = cdc_received,
+    .Transmitted    = cdc_transmitted,
+};
+
+static USBD_CDC_IfHandleType cdc_if = {
+    .App    = &cdc_app,
+    .Base.AltCount = 1,
+    .Config = { .InEpNum = 0x81, .OutEpNum = 0x01, .NotEpNum = 0x82 },
+};
+
+static const USBD_DescriptionType dev_desc = {
+    .Vendor  = { .Name = "IntergatedCircuits", .ID = 0xFFFF },
+    .Product = { .Name = "Split benchmark", .ID = 0xFFFF, .Version.bcd = 0x0100 },
+    .Config  = { .Name = "Split config", .MaxCurrent_mA = 100, .SelfPowered = 1 },
+};
+
+int main(int argc, char *argv[])
+{
+    static USBD_HandleType dev;
+    static USBD_SimBusType bus;
+    static uint8_t hostOut[HOST_TRANSFER_SIZE], hostIn[HOST_TRANSFER_SIZE];
+    USBD_SimUrbType out = { .Data = hostOut }, in = { .Data = hostIn, .Length = HOST_TRANSFER_SIZE };
+    USBD_CDC_LineCodingType coding = { 115200, 0, 0, 8 };
+    USB_SetupRequestType setLineCoding = {
+        .RequestType.b = 0x21, .Request = CDC_REQ_SET_LINE_CODING, .Length = sizeof(coding) };
+    uint64_t total = 256 * 1024, sent = 0, echoed = 0, start, elapsed, progress;
+    uint32_t errors = 0, i;
+    uint8_t txSeq = 0, rxSeq = 0;
+    pthread_t thread;
+    uint16_t len;
+
+    if (argc > 1)
+    {
+        total = strtoull(argv[1], NULL, 0) * 1024;
+    }
+
+    for (i = 0; i < BUFFER_COUNT; i++)
+    {
+        usb.Free[usb.FreeCount++] = buffers[i];
+    }
+    USBD_MBX_Init(&to_app);
+    USBD_MBX_Init(&to_usb);
+    (void) sem_init(&app_wakeup, 0, 0);
+    (void) pthread_create(&thread, NULL, app_thread, NULL);
+
+    USBD_SIM_Init(&bus, &dev);
+    USBD_Init(&dev, &dev_desc);
+    USBD_CDC_MountInterface(&cdc_if, &dev);
+    USBD_Connect(&dev);
+
+    if ((USBD_SIM_Enumerate(&bus, USB_SPEED_FULL) != USBD_E_OK) ||
+        (USBD_SIM_Control(&bus, &setLineCoding, &coding, &len) != USBD_E_OK))
+    {
+        printf("Enumeration failed\n");
+        return 1;
+    }
+
+    start = progress = now_ns();
+    out.Status = USBD_SIM_DONE;
+    (void) USBD_SIM_Submit(&bus, 0x81, &in);
+
+    while ((echoed < total) && ((now_ns() - progress) < STALL_TIMEOUT_NS))
+    {
+        /* Host: counting pattern out, validated echo in */
+        if ((out.Status == USBD_SIM_DONE) && (sent < total))
+        {
+            out.Length = (total - sent < HOST_TRANSFER_SIZE) ? total - sent : HOST_TRANSFER_SIZE;
+            for (i = 0; i < out.Length; i++)
+            {
+                hostOut[i] = txSeq++;
+            }
+            sent += out.Length;
+            (void) USBD_SIM_Submit(&bus, 0x01, &out);
+        }
+        if (in.Status == USBD_SIM_DONE)
+        {
+            for (i = 0; i < in.Actual; i++)
+            {
+                if (hostIn[i] != rxSeq++)
+                {
+                    errors++;
+                }
+            }
+            echoed += in.Actual;
+            progress = now_ns();
+            (void) USBD_SIM_Submit(&bus, 0x81, &in);
+        }
+
+        /* USB core: bus frame, then the application's requests */
+        USBD_SIM_Run(&bus, 1);
+        if ((USBD_MBX_Dispatch(&to_usb) == 0) && (USBD_MBX_Pending(&to_app) > 0))
+        {
+            /* Let the application core catch up */
+            sched_yield();
+        }
+    }
+    elapsed = now_ns() - start;
+
+    post(&to_app, app_stop, NULL, NULL, 0);
+    (void) pthread_join(thread, NULL);
+
+    printf("Echoed %llu / %llu bytes, %u pattern errors\n",
+            (unsigned long long)echoed, (unsigned long long)total, errors);
+    printf("Application: %llu bytes in %u messages\n",
+            (unsigned long long)app.Bytes, app.Messages);
+    printf("Wall time %.3f ms (%.2f MB/s), bus time %.3f ms, mailbox full %u times\n",
+            elapsed / 1e6, (elapsed > 0) ? (echoed * 1e3) / elapsed : 0.0,
+            USBD_SIM_Time_ns(&bus) / 1e6, mailbox_full);
+
+    return ((echoed == total) && (errors == 0)) ? 0 : 1;
+}
@@ -0,0 +1,228 @@
+/**
+  ******************************************************************************
+  * @file    usbd_strgen.c
+  * @author  Benedek Kupper
+  * @version 0.1
+  * @date    2019-01-12
+  * @brief   Universal Serial Bus Device Driver
+  *          Host tool generating constant string descriptor tables
+  *
+  * @details
+  * The tool converts UTF-8 strings into ready-to-send USB string descriptors,
+  * and prints them as a constant @ref USBD_StringTableEntryType table,
+  * which can be referenced by @ref USBD_DescriptionType::StringTable
+  * when USBD_CONST_STRING_TABLE is set. The strings are given as
+  * INDEX=TEXT arguments, where INDEX is either a number, or one of
+  * vendor, product, config, if<ifNum>[.<intNum>]:
+  *     @code
+  *     $ cc -o usbd_strgen usbd_strgen.c
+  *     $ ./usbd_strgen -n dev_strings vendor="Ünnepi Kft." product="Gadget" if0="Serial port" > dev_strings.c
+  *     @endcode
+  *
+  * Copyright (c) 2019 Benedek Kupper
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Must match USBD_iStringType */
+#define ISTR_INTERFACES     0x01
+#define ISTR_VENDOR         0x10
+#define ISTR_PRODUCT        0x20
+#define ISTR_CONFIG         0x40
+
+/* The descriptor length is limited to 8 bits */
+#define MAX_UNITS           ((0xFF - 2) / 2)
+
+/**
+ * @brief Converts the symbolic or numeric string index.
+ * @param name: the index text
+ * @param index: the string descriptor index output
+ * @return 0 if successful, -1 if the index is invalid
+ */
+static int parseIndex(const char *name, unsigned *index)
+{
+    char *end;
+    unsigned ifNum, intNum = 0;
+
+    if (strcmp(name, "vendor") == 0)
+    {
+        *index = ISTR_VENDOR;
+    }
+    else if (strcmp(name, "product") == 0)
+    {
+        *index = ISTR_PRODUCT;
+    }
+    else if (strcmp(name, "config") == 0)
+    {
+        *index = ISTR_CONFIG;
+    }
+    else if (strncmp(name, "if", 2) == 0)
+    {
+        /* Same as USBD_IIF_INDEX() */
+        ifNum = strtoul(&name[2], &end, 10);
+        if (*end == '.')
+        {
+            intNum = strtoul(end + 1, &end, 10);
+        }
+        if ((*end != 0) || (ifNum > 0xE) || (intNum > 0xF))
+        {
+            return -1;
+        }
+        *index = ISTR_INTERFACES + ifNum + (intNum << 4);
+    }
+    else
+    {
+        *index = strtoul(name, &end, 0);
+        if ((*end != 0) || (*index == 0) || (*index > 0xFF))
+        {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Converts a UTF-8 string to UTF-16 code units.
+ * @param src: the input UTF-8 string
+ * @param utf16: the output code units
+ * @return The number of code units, -1 if the input is invalid
+ */
+static int utf8ToUtf16(const uint8_t *src, uint16_t *utf16)
+{
+    int count = 0;
+
+    while (*src != 0)
+    {
+        uint32_t code = *src++;
+        int ext;
+
+        if      (code >= 0xF8) { return -1; }
+        else if (code >= 0xF0) { code &= 0x07; ext = 3; }
+        else if (code >= 0xE0) { code &= 0x0F; ext = 2; }
+        else if (code >= 0xC0) { code &= 0x1F; ext = 1; }
+        else if (code >= 0x80) { return -1; }
+        else                   { ext = 0; }
+
+        for (; ext > 0; ext--)
+        {
+            if ((*src & 0xC0) != 0x80)
+            {
+                return -1;
+            }
+            code = (code << 6) | (*src++ & 0x3F);
+        }
+
+        if ((code > 0x10FFFF) || ((code >= 0xD800) && (code <= 0xDFFF)) ||
+            ((count + (code >= 0x10000 ? 2 : 1)) > MAX_UNITS))
+        {
+            return -1;
+        }
+        else if (code >= 0x10000)
+        {
+            /* Encode as surrogate pair */
+            code -= 0x10000;
+            utf16[count++] = 0xD800 | (code >> 10);
+            utf16[count++] = 0xDC00 | (code & 0x3FF);
+        }
+        else
+        {
+            utf16[count++] = (uint16_t)code;
+        }
+    }
+    return count;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *table = "usbd_strings";
+    unsigned indexes[argc];
+    int i, first = 1, count = 0;
+
+    if ((argc > 2) && (strcmp(argv[1], "-n") == 0))
+    {
+        table = argv[2];
+        first = 3;
+    }
+    if (first >= argc)
+    {
+        fprintf(stderr, "usage: %s [-n table_name] INDEX=TEXT...\n"
+                "  INDEX: vendor, product, config, if<ifNum>[.<intNum>] or a number\n",
+                argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    printf("/* Generated by usbd_strgen, do not edit. */\n"
+           "#include <usbd_types.h>\n");
+
+    for (i = first; i < argc; i++)
+    {
+        uint16_t utf16[MAX_UNITS];
+        char *text = strchr(argv[i], '=');
+        int units, j;
+
+        if (text == NULL)
+        {
+            fprintf(stderr, "%s: missing '=' in \"%s\"\n", argv[0], argv[i]);
+            return EXIT_FAILURE;
+        }
+        *text++ = 0;
+
+        if (parseIndex(argv[i], &indexes[count]) != 0)
+        {
+            fprintf(stderr, "%s: invalid index \"%s\"\n", argv[0], argv[i]);
+            return EXIT_FAILURE;
+        }
+        for (j = 0; j < count; j++)
+        {
+            if (indexes[j] == indexes[count])
+            {
+                fprintf(stderr, "%s: duplicate index \"%s\"\n", argv[0], argv[i]);
+                return EXIT_FAILURE;
+            }
+        }
+        units = utf8ToUtf16((const uint8_t*)text, utf16);
+        if (units < 0)
+        {
+            fprintf(stderr, "%s: invalid or too long UTF-8 text \"%s\"\n", argv[0], text);
+            return EXIT_FAILURE;
+        }
+
+        printf("\n/* %s */\n"
+               "__alignment(USBD_DATA_ALIGNMENT)\n"
+               "static const uint8_t %s_%02x[] __align(USBD_DATA_ALIGNMENT) = {\n"
+               "    %d, 0x03,",
+               (strstr(text, "*/") == NULL) ? text : argv[i],
+               table, indexes[count], 2 + units * 2);
+        for (j = 0; j < units; j++)
+        {
+            printf("%s 0x%02x, 0x%02x,", ((j % 8) == 0) ? "\n   " : "",
+                    utf16[j] & 0xFF, utf16[j] >> 8);
+        }
+        printf("\n};\n");
+        count++;
+    }
+
+    printf("\nconst USBD_StringTableEntryType %s[] = {\n", table);
+    for (i = 0; i < count; i++)
+    {
+        printf("    { .Index = 0x%02x, .Desc = %s_%02x },\n",
+                indexes[i], table, indexes[i]);
+    }
+    printf("    { .Index = 0, .Desc = NULL },\n};\n");
+
+    return EXIT_SUCCESS;
+}
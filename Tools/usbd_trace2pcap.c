@@ -0,0 +1,607 @@
+/**
+  ******************************************************************************
+  * @file    usbd_trace2pcap.c
+  * @author  Benedek Kupper
+  * @version 0.1
+  * @date    2019-01-20
+  * @brief   Universal Serial Bus Device Driver
+  *          Host tool converting device traces to pcap files
+  *
+  * @details
+  * The tool decodes the binary event trace of the device (dev->Trace,
+  * enabled by USBD_TRACE_SIZE), and writes the transfers as Linux usbmon
+  * records into a pcap file, so Wireshark can dissect the standard and
+  * class specific traffic. The trace is dumped from the target's memory
+  * as it is, e.g. with GDB:
+  *     @code
+  *     (gdb) dump binary value trace.bin dev.Trace
+  *     $ cc -o usbd_trace2pcap usbd_trace2pcap.c
+  *     $ ./usbd_trace2pcap -f 72000000 trace.bin trace.pcap
+  *     @endcode
+  * The -f option sets the frequency of USBD_TRACE_TIMESTAMP() in Hz,
+  * the -l option lists the recorded events as text instead.
+  *
+  * Copyright (c) 2019 Benedek Kupper
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Must match USBD_TraceEventType */
+enum
+{
+    TRACE_SETUP = 1,
+    TRACE_SUBMIT,
+    TRACE_COMPLETE,
+    TRACE_DATA,
+    TRACE_STALL,
+    TRACE_EP_OPEN,
+    TRACE_RESET,
+    TRACE_LINK,
+    TRACE_CAPTURED = 0x80,
+};
+
+/* Trace ring header and entry header sizes (little endian target) */
+#define TRACE_HEADER_SIZE   8
+#define ENTRY_HEADER_SIZE   8
+
+/* pcap link type of Linux usbmon with the 48 byte header */
+#define LINKTYPE_USB_LINUX  189
+#define USBMON_HEADER_SIZE  48
+
+/* usbmon transfer types, indexed by the USB endpoint type */
+static const uint8_t usbmonXferType[4] = { 2, 0, 3, 1 };
+
+#define STATUS_OK           0
+#define STATUS_EPIPE        (-32)
+#define STATUS_EPROTO       (-71)
+#define STATUS_ESHUTDOWN    (-108)
+#define STATUS_EINPROGRESS  (-115)
+
+/** @brief Decoded trace entry */
+typedef struct
+{
+    uint64_t Time;
+    uint8_t  Event;
+    uint8_t  Param;
+    uint16_t Length;
+    const uint8_t *Data;                /* NULL if no data was captured */
+}EntryType;
+
+/** @brief Pending transfer of an endpoint */
+typedef struct
+{
+    int      Active;
+    uint64_t Id;
+    uint64_t Time;
+    uint32_t Length;
+    uint32_t Captured;
+    uint8_t  Setup[8];
+    uint8_t  Data[0x10000];
+}TransferType;
+
+static FILE *pcap;
+static uint64_t tickHz = 1000000;
+static uint16_t busNum = 1;
+static uint16_t dataSize;
+static uint8_t devNum;
+static uint64_t lastId;
+static uint8_t epType[32];
+static TransferType ctrl;
+static TransferType *pending[32];
+static int ctrlAppend;
+
+static uint16_t get16(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+static uint32_t get32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void put16(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void put32(uint8_t *p, uint32_t v)
+{
+    put16(&p[0], (uint16_t)v);
+    put16(&p[2], (uint16_t)(v >> 16));
+}
+
+static void put64(uint8_t *p, uint64_t v)
+{
+    put32(&p[0], (uint32_t)v);
+    put32(&p[4], (uint32_t)(v >> 32));
+}
+
+/**
+ * @brief Converts the endpoint address to an index of the endpoint tables.
+ */
+static unsigned epIndex(uint8_t epAddr)
+{
+    return (epAddr & 0xF) + ((epAddr & 0x80) ? 16 : 0);
+}
+
+/**
+ * @brief Writes a usbmon record into the pcap file.
+ * @param type: 'S' for submission, 'C' for completion
+ * @param t: the transfer
+ * @param time: timestamp in ticks
+ * @param epAddr: endpoint address
+ * @param status: URB status
+ * @param length: URB length
+ * @param data: captured data (optional)
+ * @param capLen: length of the captured data
+ */
+static void writeRecord(char type, const TransferType *t, uint64_t time, uint8_t epAddr,
+        int32_t status, uint32_t length, const uint8_t *data, uint32_t capLen)
+{
+    uint8_t hdr[16 + USBMON_HEADER_SIZE] = { 0 }, *mon = &hdr[16];
+    uint32_t sec  = (uint32_t)(time / tickHz);
+    uint32_t usec = (uint32_t)(((time % tickHz) * 1000000) / tickHz);
+    uint8_t xfer  = ((epAddr & 0xF) == 0) ? 2 : usbmonXferType[epType[epIndex(epAddr)] & 3];
+
+    if (data == NULL)
+    {
+        capLen = 0;
+    }
+
+    /* pcap record header */
+    put32(&hdr[0],  sec);
+    put32(&hdr[4],  usec);
+    put32(&hdr[8],  USBMON_HEADER_SIZE + capLen);
+    put32(&hdr[12], USBMON_HEADER_SIZE + capLen);
+
+    /* usbmon header */
+    put64(&mon[0], t->Id);
+    mon[8]  = (uint8_t)type;
+    mon[9]  = xfer;
+    mon[10] = epAddr;
+    mon[11] = devNum;
+    put16(&mon[12], busNum);
+    mon[14] = ((type == 'S') && (xfer == 2)) ? 0 : '-';
+    mon[15] = (capLen > 0) ? 0 : ((type == 'S') ? '<' : '>');
+    put64(&mon[16], sec);
+    put32(&mon[24], usec);
+    put32(&mon[28], (uint32_t)status);
+    put32(&mon[32], length);
+    put32(&mon[36], capLen);
+    if (mon[14] == 0)
+    {
+        memcpy(&mon[40], t->Setup, 8);
+    }
+
+    fwrite(hdr, 1, sizeof(hdr), pcap);
+    if (capLen > 0)
+    {
+        fwrite(data, 1, capLen, pcap);
+    }
+}
+
+/**
+ * @brief Writes the complete control transfer, and applies the new address.
+ */
+static void ctrlFinish(uint64_t time, int32_t status)
+{
+    uint8_t dirIn = ctrl.Setup[0] & 0x80;
+    uint16_t wLength = get16(&ctrl.Setup[6]);
+
+    if (ctrl.Active)
+    {
+        if (dirIn)
+        {
+            writeRecord('S', &ctrl, ctrl.Time, 0x80, STATUS_EINPROGRESS, wLength, NULL, 0);
+            writeRecord('C', &ctrl, time, 0x80, status, ctrl.Length,
+                    ctrl.Data, (ctrl.Captured < ctrl.Length) ? ctrl.Captured : ctrl.Length);
+        }
+        else
+        {
+            writeRecord('S', &ctrl, ctrl.Time, 0x00, STATUS_EINPROGRESS, wLength,
+                    ctrl.Data, ctrl.Captured);
+            writeRecord('C', &ctrl, time, 0x00, status, ctrl.Length, NULL, 0);
+        }
+
+        if ((status == STATUS_OK) && (ctrl.Setup[0] == 0x00) && (ctrl.Setup[1] == 0x05))
+        {
+            devNum = ctrl.Setup[2] & 0x7F;
+        }
+        ctrl.Active = 0;
+    }
+}
+
+/**
+ * @brief Appends the captured control data to the transfer.
+ */
+static void ctrlCapture(const EntryType *e)
+{
+    uint32_t n = (e->Length < dataSize) ? e->Length : dataSize;
+
+    if (e->Data == NULL)
+    {
+        return;
+    }
+    if ((ctrl.Captured + n) > sizeof(ctrl.Data))
+    {
+        n = sizeof(ctrl.Data) - ctrl.Captured;
+    }
+    memcpy(&ctrl.Data[ctrl.Captured], e->Data, n);
+    ctrl.Captured += n;
+}
+
+/**
+ * @brief Translates the control endpoint's events.
+ */
+static void ctrlEvent(const EntryType *e)
+{
+    uint8_t dirIn = ctrl.Setup[0] & 0x80;
+    uint16_t wLength = get16(&ctrl.Setup[6]);
+
+    switch (e->Event)
+    {
+        case TRACE_SETUP:
+            /* An unfinished transfer is aborted by the new request */
+            ctrlFinish(e->Time, STATUS_EPROTO);
+            memset(&ctrl, 0, offsetof(TransferType, Data));
+            ctrl.Active = 1;
+            ctrl.Id     = ++lastId;
+            ctrl.Time   = e->Time;
+            if (e->Data != NULL)
+            {
+                memcpy(ctrl.Setup, e->Data, 8);
+            }
+            break;
+
+        case TRACE_SUBMIT:
+            /* The IN data stage is captured when it's sent */
+            if (ctrl.Active && dirIn && (e->Param == 0x80))
+            {
+                ctrlCapture(e);
+                ctrlAppend = 1;
+            }
+            break;
+
+        case TRACE_COMPLETE:
+            if (!ctrl.Active)
+            {
+            }
+            else if ((e->Param == 0x80) ? (dirIn != 0) : ((dirIn == 0) && (wLength > 0)))
+            {
+                /* Data stage */
+                ctrl.Length += e->Length;
+                if (!dirIn)
+                {
+                    ctrlCapture(e);
+                    ctrlAppend = 1;
+                }
+            }
+            else
+            {
+                /* Status stage is in the opposite direction,
+                 * or IN for requests without data stage */
+                ctrlFinish(e->Time, STATUS_OK);
+            }
+            break;
+
+        case TRACE_STALL:
+            ctrlFinish(e->Time, STATUS_EPIPE);
+            break;
+
+        default:
+            break;
+    }
+}
+
+/**
+ * @brief Translates the non-control endpoints' events.
+ */
+static void epEvent(const EntryType *e)
+{
+    TransferType *t = pending[epIndex(e->Param)];
+    uint32_t n = (e->Length < dataSize) ? e->Length : dataSize;
+
+    switch (e->Event)
+    {
+        case TRACE_SUBMIT:
+            /* The host receives the IN data at completion */
+            if (e->Param & 0x80)
+            {
+                t->Active   = 1;
+                t->Id       = ++lastId;
+                t->Time     = e->Time;
+                t->Length   = e->Length;
+                t->Captured = 0;
+                if (e->Data != NULL)
+                {
+                    t->Captured = n;
+                    memcpy(t->Data, e->Data, n);
+                }
+                writeRecord('S', t, e->Time, e->Param, STATUS_EINPROGRESS, e->Length, NULL, 0);
+            }
+            break;
+
+        case TRACE_COMPLETE:
+            if (e->Param & 0x80)
+            {
+                if (!t->Active)
+                {
+                    /* The submission was overwritten in the ring */
+                    t->Id       = ++lastId;
+                    t->Captured = 0;
+                }
+                writeRecord('C', t, e->Time, e->Param, STATUS_OK, e->Length,
+                        t->Data, (t->Captured < e->Length) ? t->Captured : e->Length);
+                t->Active = 0;
+            }
+            else
+            {
+                /* The host's OUT transfer is only known at completion */
+                t->Id = ++lastId;
+                writeRecord('S', t, e->Time, e->Param, STATUS_EINPROGRESS, e->Length, e->Data, n);
+                writeRecord('C', t, e->Time, e->Param, STATUS_OK, e->Length, NULL, 0);
+            }
+            break;
+
+        case TRACE_STALL:
+            if (t->Active)
+            {
+                writeRecord('C', t, e->Time, e->Param, STATUS_EPIPE, 0, NULL, 0);
+                t->Active = 0;
+            }
+            break;
+
+        case TRACE_EP_OPEN:
+            epType[epIndex(e->Param)] = (uint8_t)e->Length;
+            break;
+
+        default:
+            break;
+    }
+}
+
+/**
+ * @brief Translates a trace event to usbmon records.
+ */
+static void convertEvent(const EntryType *e)
+{
+    unsigned i;
+
+    if (e->Event == TRACE_DATA)
+    {
+        /* Control data continuation */
+        if (ctrlAppend && ctrl.Active)
+        {
+            ctrlCapture(e);
+        }
+        return;
+    }
+    ctrlAppend = 0;
+
+    switch (e->Event)
+    {
+        case TRACE_RESET:
+            ctrlFinish(e->Time, STATUS_ESHUTDOWN);
+            for (i = 0; i < 32; i++)
+            {
+                if (pending[i]->Active)
+                {
+                    writeRecord('C', pending[i], e->Time, (i & 0xF) | ((i & 16) << 3),
+                            STATUS_ESHUTDOWN, 0, NULL, 0);
+                    pending[i]->Active = 0;
+                }
+            }
+            memset(epType, 0, sizeof(epType));
+            devNum = 0;
+            break;
+
+        case TRACE_LINK:
+            break;
+
+        case TRACE_SETUP:
+            ctrlEvent(e);
+            break;
+
+        default:
+            if ((e->Param & 0xF) == 0)
+            {
+                ctrlEvent(e);
+            }
+            else
+            {
+                epEvent(e);
+            }
+            break;
+    }
+}
+
+/**
+ * @brief Prints a trace event as text.
+ */
+static void listEvent(const EntryType *e)
+{
+    static const char *names[] = { "?", "SETUP", "SUBMIT", "COMPLETE", "DATA",
+            "STALL", "EP_OPEN", "RESET", "LINK" };
+    uint32_t n = (e->Length < dataSize) ? e->Length : dataSize, i;
+
+    printf("%10u.%06u %-8s %02x %5u",
+            (unsigned)(e->Time / tickHz),
+            (unsigned)(((e->Time % tickHz) * 1000000) / tickHz),
+            names[(e->Event <= TRACE_LINK) ? e->Event : 0], e->Param, e->Length);
+
+    if (e->Data == NULL)
+    {
+        n = 0;
+    }
+    for (i = 0; i < n; i++)
+    {
+        printf(" %02x", e->Data[i]);
+    }
+    printf("\n");
+}
+
+int main(int argc, char *argv[])
+{
+    const char *input = NULL, *output = NULL;
+    int i, list = 0;
+    FILE *f;
+    long size;
+    uint8_t *trace;
+    uint32_t count, entryCount, entrySize, first, n;
+    uint32_t lastTick = 0;
+    uint64_t time = 0;
+
+    for (i = 1; i < argc; i++)
+    {
+        if ((strcmp(argv[i], "-f") == 0) && ((i + 1) < argc))
+        {
+            tickHz = strtoull(argv[++i], NULL, 0);
+        }
+        else if ((strcmp(argv[i], "-b") == 0) && ((i + 1) < argc))
+        {
+            busNum = (uint16_t)strtoul(argv[++i], NULL, 0);
+        }
+        else if (strcmp(argv[i], "-l") == 0)
+        {
+            list = 1;
+        }
+        else if (input == NULL)
+        {
+            input = argv[i];
+        }
+        else
+        {
+            output = argv[i];
+        }
+    }
+    if ((input == NULL) || ((output == NULL) && !list) || (tickHz == 0))
+    {
+        fprintf(stderr, "usage: %s [-f tick_hz] [-b bus] trace.bin out.pcap\n"
+                "       %s [-f tick_hz] -l trace.bin\n", argv[0], argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    /* Load the trace dump */
+    f = fopen(input, "rb");
+    if (f == NULL)
+    {
+        perror(input);
+        return EXIT_FAILURE;
+    }
+    fseek(f, 0, SEEK_END);
+    size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    trace = malloc((size > 0) ? size : 1);
+    if ((trace == NULL) || (size < TRACE_HEADER_SIZE) ||
+        (fread(trace, 1, size, f) != (size_t)size))
+    {
+        fprintf(stderr, "%s: failed to read \"%s\"\n", argv[0], input);
+        return EXIT_FAILURE;
+    }
+    fclose(f);
+
+    count      = get32(&trace[0]);
+    entryCount = get16(&trace[4]);
+    dataSize   = get16(&trace[6]);
+    entrySize  = ENTRY_HEADER_SIZE + dataSize;
+    if ((entryCount == 0) || (dataSize < 8) ||
+        (size < (long)(TRACE_HEADER_SIZE + entryCount * entrySize)))
+    {
+        fprintf(stderr, "%s: invalid trace dump \"%s\"\n", argv[0], input);
+        return EXIT_FAILURE;
+    }
+
+    if (!list)
+    {
+        uint8_t hdr[24];
+
+        pcap = fopen(output, "wb");
+        if (pcap == NULL)
+        {
+            perror(output);
+            return EXIT_FAILURE;
+        }
+        put32(&hdr[0],  0xA1B2C3D4);
+        put16(&hdr[4],  2);
+        put16(&hdr[6],  4);
+        put32(&hdr[8],  0);
+        put32(&hdr[12], 0);
+        put32(&hdr[16], 0x10000 + USBMON_HEADER_SIZE);
+        put32(&hdr[20], LINKTYPE_USB_LINUX);
+        fwrite(hdr, 1, sizeof(hdr), pcap);
+
+        for (i = 0; i < 32; i++)
+        {
+            pending[i] = calloc(1, sizeof(TransferType));
+            if (pending[i] == NULL)
+            {
+                return EXIT_FAILURE;
+            }
+        }
+    }
+
+    /* The oldest entries are overwritten when the ring is full */
+    if (count > entryCount)
+    {
+        first = count % entryCount;
+        n = entryCount;
+    }
+    else
+    {
+        first = 0;
+        n = count;
+    }
+
+    for (i = 0; i < (int)n; i++)
+    {
+        const uint8_t *raw = &trace[TRACE_HEADER_SIZE + ((first + i) % entryCount) * entrySize];
+        EntryType e;
+
+        /* The 32 bit timestamps are extended, assuming less than one overflow between events */
+        if (i > 0)
+        {
+            time += (uint32_t)(get32(&raw[0]) - lastTick);
+        }
+        lastTick = get32(&raw[0]);
+
+        e.Time   = time;
+        e.Event  = raw[4] & ~TRACE_CAPTURED;
+        e.Param  = raw[5];
+        e.Length = get16(&raw[6]);
+        e.Data   = (raw[4] & TRACE_CAPTURED) ? &raw[ENTRY_HEADER_SIZE] : NULL;
+
+        if (list)
+        {
+            listEvent(&e);
+        }
+        else
+        {
+            convertEvent(&e);
+        }
+    }
+
+    if (!list)
+    {
+        fclose(pcap);
+    }
+    free(trace);
+
+    return EXIT_SUCCESS;
+}
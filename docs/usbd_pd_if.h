@@ -109,7 +109,7 @@ extern void USBD_PD_EpClose     (USBD_HandleType * dev, uint8_t addr);
  * @param len: total length of the data
  */
 extern void USBD_PD_EpSend      (USBD_HandleType * dev, uint8_t addr,
-                                 const uint8_t* data, uint16_t len);
+                                 const uint8_t* data, USBD_LengthType len);
 
 /**
  * @brief Receives data through a device endpoint.
@@ -119,7 +119,35 @@ extern void USBD_PD_EpSend      (USBD_HandleType * dev, uint8_t addr,
  * @param len: maximum length of the data
  */
 extern void USBD_PD_EpReceive   (USBD_HandleType * dev, uint8_t addr,
-                                 uint8_t* data, uint16_t len);
+                                 uint8_t* data, USBD_LengthType len);
+
+#if (USBD_EP_SG_SUPPORT == 1)
+/**
+ * @brief Sends the data segments through a device endpoint as a single transfer.
+ *        The segment boundaries aren't aligned to the packet boundaries.
+ * @note  Only required if the peripheral driver defines USBD_EP_SG_SUPPORT as 1,
+ *        otherwise the core linearizes the segments.
+ * @param dev: USB Device handle reference
+ * @param addr: endpoint address
+ * @param segs: the data segments
+ * @param count: number of segments
+ */
+extern void USBD_PD_EpSendv     (USBD_HandleType * dev, uint8_t addr,
+                                 const USBD_EpSegmentType* segs, uint8_t count);
+
+/**
+ * @brief Receives a single transfer through a device endpoint into the data segments.
+ *        The segment boundaries aren't aligned to the packet boundaries.
+ * @note  Only required if the peripheral driver defines USBD_EP_SG_SUPPORT as 1,
+ *        otherwise the core linearizes the segments.
+ * @param dev: USB Device handle reference
+ * @param addr: endpoint address
+ * @param segs: the data segments
+ * @param count: number of segments
+ */
+extern void USBD_PD_EpReceivev  (USBD_HandleType * dev, uint8_t addr,
+                                 const USBD_EpSegmentType* segs, uint8_t count);
+#endif /* (USBD_EP_SG_SUPPORT == 1) */
 
 /**
  * @brief Sets a device endpoint to STALL transfers.